@@ -0,0 +1,210 @@
+#ifndef WAVESHARE_LORA_SPI_H
+#define WAVESHARE_LORA_SPI_H
+
+#include <string.h>
+#include "driver/gpio.h"
+#include "driver/spi_master.h"    
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "lr11xx_bootloader.h"
+#include "lr11xx_hal.h"
+#include "lr11xx_system.h"
+#include "lr11xx_radio.h"
+#include "lr11xx_regmem.h"
+#include "lr11xx_lr_fhss.h"
+#include "lr11xx_driver_version.h"
+
+
+#include "lr1121_modem_helper.h"
+#include "lr1121_modem_system_types.h"
+
+#include "lr1121_modem_common.h"
+#include "lr1121_modem_modem.h"
+#include "lr1121_modem_hal.h"
+#include "lr1121_modem_system.h"
+#include "lr1121_modem_bsp.h"
+#include "lr1121_modem_radio.h"
+
+#include "lr11xx_bootloader_types_str.h"
+#include "lr11xx_crypto_engine_types_str.h"
+#include "lr11xx_lr_fhss_types_str.h"
+#include "lr11xx_radio_types_str.h"
+#include "lr11xx_rttof_types_str.h"
+#include "lr11xx_system_types_str.h"
+#include "lr11xx_types_str.h"
+#include "lr11xx_printf_info.h"
+#include "lr1121_modem_printf_info.h"
+
+#include "lr1121_common.h"
+
+// #define USE_LR11XX_CRC_OVER_SPI
+
+/*!
+ * @brief SPI backend of the lr11xx HAL
+ *
+ * USE_LR11XX_SPI_HW_CS: the SPI peripheral drives NSS, the device must be added
+ * with spics_io_num = cs. Every HAL phase is a single transaction, so no CS
+ * juggling is needed. lr1121_modem_hal.c still bit-bangs NSS and is not usable
+ * in this mode.
+ *
+ * USE_LR11XX_SPI_POLLING: transfers up to LORA_SPI_POLLING_MAX_LENGTH bytes
+ * (every command, status and short read) are busy-polled, skipping the queue,
+ * the completion interrupt and the context switch. Longer buffer transfers stay
+ * queued, the calling task blocks on the DMA completion and the CPU is free.
+ */
+#define USE_LR11XX_SPI_HW_CS
+#define USE_LR11XX_SPI_POLLING
+#define LORA_SPI_POLLING_MAX_LENGTH 16
+
+/*!
+ * @brief Largest single SPI transfer staged by the HAL: 2 byte opcode, 255 byte
+ * WriteBuffer8 payload and the CRC byte. Longer frames fall back to one
+ * transaction per part.
+ */
+#define LORA_SPI_BUFFER_SIZE 260
+
+typedef struct lora_spi_stats_s
+{
+    uint32_t hal_calls;     // lr11xx_hal_write/read/direct_read calls
+    uint32_t transactions;  // spi_device_transmit calls
+    uint32_t bytes;
+} lora_spi_stats_t;
+
+/*!
+ * @brief BUSY wait: spin this long for the common short command, then sleep on
+ * the BUSY falling edge interrupt
+ */
+#define LORA_BUSY_SPIN_US 50
+#define LORA_BUSY_STATS_SIZE 32
+#define LORA_BUSY_OPCODE_NONE 0xFFFF
+
+/*!
+ * @brief Time spent waiting on BUSY, charged to the opcode that raised it
+ */
+typedef struct lora_busy_stats_s
+{
+    uint16_t opcode;
+    uint32_t count;
+    uint32_t sleeps;    // waits that outlasted the spin
+    uint32_t total_us;
+    uint32_t max_us;
+} lora_busy_stats_t;
+
+/*!
+ * @brief Optional SPI tracer: every HAL call is logged into a per-context ring of
+ * LORA_TRACE_SIZE records (power of two). Single writer (the HAL), readers copy
+ * out with lora_trace_read and drop anything overwritten meanwhile, no locks.
+ * lora_trace_dump prints LRTRACE lines for tools/lr11xx_trace.py.
+ */
+// #define USE_LR11XX_SPI_TRACE
+#define LORA_TRACE_SIZE 256
+
+typedef enum lora_trace_kind_e
+{
+    LORA_TRACE_WRITE       = 'W',
+    LORA_TRACE_READ        = 'R',
+    LORA_TRACE_DIRECT_READ = 'D',
+} lora_trace_kind_t;
+
+typedef struct lora_trace_record_s
+{
+    uint32_t timestamp_us;      // esp_timer at call entry, low 32 bits
+    uint16_t opcode;            // LORA_BUSY_OPCODE_NONE for direct reads
+    uint8_t  kind;              // lora_trace_kind_t
+    uint8_t  status;            // lr11xx_hal_status_t
+    uint16_t command_length;
+    uint16_t data_length;
+    uint32_t busy_us;           // waiting on BUSY
+    uint32_t transfer_us;       // rest of the call: SPI transfers and copies
+} lora_trace_record_t;
+
+typedef struct lr1121_s
+{
+    uint8_t     cs;
+    uint8_t     reset;
+    uint8_t     busy;
+    uint8_t     irq;
+    uint8_t     led;
+    spi_device_handle_t spi;
+    WORD_ALIGNED_ATTR uint8_t spi_buffer[LORA_SPI_BUFFER_SIZE];  // DMA-capable as long as the context is in internal RAM
+    lora_spi_stats_t spi_stats;
+    SemaphoreHandle_t busy_done;  // given by the BUSY falling edge
+    uint16_t busy_opcode;         // last command sent, owner of the next BUSY period
+    lora_busy_stats_t busy_stats[LORA_BUSY_STATS_SIZE];
+    uint8_t busy_stats_count;
+#if defined(USE_LR11XX_SPI_TRACE)
+    lora_trace_record_t trace[LORA_TRACE_SIZE];
+    uint32_t trace_head;          // records ever written
+    uint32_t trace_busy_us;       // BUSY wait of the call in progress
+#endif
+} lr1121_t;
+
+/**
+ * @brief Initializes the radio I/Os pins context
+ *
+ * @param [in] context Radio abstraction
+ */
+void lora_init_io_context(const void *context,uint8_t cs,uint8_t reset,uint8_t busy,uint8_t irq);
+/**
+ * @brief Initializes the radio I/Os pins interface
+ *
+ * @param [in] context Radio abstraction
+ */
+void lora_init_io( const void* context );
+
+void lora_init_irq(const void *context, gpio_isr_t handler);
+
+void lora_spi_init(const void* context, spi_device_handle_t spi);
+void lora_spi_write_bytes(const void* context,const uint8_t *wirte,const uint16_t wirte_length);
+void lora_spi_read_bytes(const void* context, uint8_t *read,const uint16_t read_length);
+
+/*!
+ * @brief One full-duplex transaction over the device, either buffer may be NULL
+ */
+void lora_spi_transfer(const void* context, const uint8_t *write, uint8_t *read, const uint16_t length);
+
+void lora_spi_get_stats(const void* context, lora_spi_stats_t *stats);
+void lora_spi_reset_stats(const void* context);
+
+/*!
+ * @brief Copy out the per-opcode BUSY statistics
+ *
+ * @returns number of entries written, at most max_count
+ */
+uint8_t lora_busy_get_stats(const void* context, lora_busy_stats_t *stats, uint8_t max_count);
+void lora_busy_reset_stats(const void* context);
+
+/*!
+ * @brief Append a record to the trace ring, called by the HAL
+ */
+void lora_trace_push(const void* context, const lora_trace_record_t *record);
+
+/*!
+ * @brief Copy trace records from *cursor (records ever read) onwards
+ *
+ * @param [in,out] cursor start at 0, advanced past the records returned
+ * @param [out] dropped records lost to overwriting since the last call, may be NULL
+ *
+ * @returns number of records copied, 0 when tracing is compiled out
+ */
+uint16_t lora_trace_read(const void* context, lora_trace_record_t *records, uint16_t max_count,
+                         uint32_t *cursor, uint32_t *dropped);
+
+/*!
+ * @brief Print the records added since the previous dump as LRTRACE lines
+ */
+void lora_trace_dump(const void* context);
+/**
+ * @brief Flush the modem event queue
+ *
+ * @param [in] context Radio abstraction
+ *
+ * @returns Modem-E response code
+ */
+lr1121_modem_response_code_t lr1121_modem_board_event_flush( const void* context );
+
+#endif
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "esp_lora_1121.h"
+#include <stdio.h>
+
+
+void lora_init_io_context(const void *context,uint8_t cs,uint8_t reset,uint8_t busy,uint8_t irq)
+{
+    ((lr1121_t *)context)->cs    = cs;
+    ((lr1121_t *)context)->reset = reset;
+    ((lr1121_t *)context)->irq   = irq;
+    ((lr1121_t *)context)->busy  = busy;
+}
+
+// BUSY and DIO share the GPIO ISR service; installing it twice fails with
+// ESP_ERR_INVALID_STATE and logs an error, so only the first caller installs it
+static void lora_install_isr_service(void)
+{
+    static bool installed = false;
+
+    if (!installed) {
+        esp_err_t err = gpio_install_isr_service(0);
+        installed = (err == ESP_OK || err == ESP_ERR_INVALID_STATE);
+    }
+}
+
+static void IRAM_ATTR lora_busy_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+
+    gpio_intr_disable(((lr1121_t *)arg)->busy);
+    xSemaphoreGiveFromISR(((lr1121_t *)arg)->busy_done, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void lora_init_io(const void *context)
+{
+    //Set the output pin
+    gpio_config_t io_conf = {};
+    io_conf.intr_type = GPIO_INTR_DISABLE; // Disable interrupts for this pin
+#if defined(USE_LR11XX_SPI_HW_CS)
+    io_conf.pin_bit_mask = 1ULL << ((lr1121_t *)context)->reset;    // NSS belongs to the SPI peripheral
+#else
+    io_conf.pin_bit_mask = 1ULL << ((lr1121_t *)context)->cs | \
+                           1ULL << ((lr1121_t *)context)->reset;    // Select the GPIO pin using a bitmask
+#endif
+    io_conf.mode = GPIO_MODE_INPUT_OUTPUT;          // Set pin as input
+    io_conf.pull_up_en = GPIO_PULLUP_DISABLE; // Enable internal pull-up resistor
+    gpio_config(&io_conf); // Apply the configuration
+
+    //Set the input pin
+    io_conf.pin_bit_mask = 1ULL << ((lr1121_t *)context)->busy | \
+                           1ULL << ((lr1121_t *)context)->irq;    // Select the GPIO pin using a bitmask
+    io_conf.mode = GPIO_MODE_INPUT;          // Set pin as input
+    io_conf.pull_up_en = GPIO_PULLUP_ENABLE; // Enable internal pull-up resistor
+    gpio_config(&io_conf); // Apply the configuration
+
+#if !defined(USE_LR11XX_SPI_HW_CS)
+    gpio_set_level(((lr1121_t *)context)->cs, 1); // Set the GPIO pin level
+#endif
+    gpio_set_level(((lr1121_t *)context)->reset, 1); // Set the GPIO pin level
+
+    // BUSY falling edge wakes lr11xx_hal_wait_on_unbusy, armed only while waiting
+    ((lr1121_t *)context)->busy_done   = xSemaphoreCreateBinary();
+    ((lr1121_t *)context)->busy_opcode = LORA_BUSY_OPCODE_NONE;
+    lora_install_isr_service();
+    gpio_set_intr_type(((lr1121_t *)context)->busy, GPIO_INTR_NEGEDGE);
+    gpio_intr_disable(((lr1121_t *)context)->busy);
+    gpio_isr_handler_add(((lr1121_t *)context)->busy, lora_busy_isr, (void *)context);
+}
+
+void lora_init_irq(const void *context, gpio_isr_t handler)
+{
+    // Zero-initialize the GPIO configuration structure
+    gpio_config_t io_conf = {};
+    io_conf.intr_type = GPIO_INTR_POSEDGE;        // Trigger on negative edge (falling edge)
+    io_conf.mode = GPIO_MODE_INPUT;               // Set pin as input mode
+    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE; // Disable pull-down
+    io_conf.pull_up_en = GPIO_PULLUP_ENABLE;      // Enable pull-up resistor
+    io_conf.pin_bit_mask = 1ULL << ((lr1121_t *)context)->irq;           // Select the GPIO pin using a bitmask
+
+    gpio_config(&io_conf); // Apply the configuration
+
+    // Install the GPIO interrupt service if not already installed
+    lora_install_isr_service();
+
+    // Register the interrupt handler for the specified pin
+    gpio_isr_handler_add(((lr1121_t *)context)->irq, handler, (void *)((lr1121_t *)context)->irq);
+}
+
+void lora_spi_init(const void* context, spi_device_handle_t spi)
+{
+    ((lr1121_t *)context)->spi = spi;
+}
+
+void lora_spi_write_bytes(const void* context,const uint8_t *wirte,const uint16_t wirte_length)
+{
+    lora_spi_transfer(context, wirte, NULL, wirte_length);
+}
+
+void lora_spi_read_bytes(const void* context, uint8_t *read,const uint16_t read_length)
+{
+    lora_spi_transfer(context, NULL, read, read_length);
+}
+
+void lora_spi_transfer(const void* context, const uint8_t *write, uint8_t *read, const uint16_t length)
+{
+    spi_transaction_t t = {
+        .length    = length * 8,       // Length is in bits
+        .tx_buffer = write,
+        .rx_buffer = read,
+    };
+
+#if defined(USE_LR11XX_SPI_POLLING)
+    if (length <= LORA_SPI_POLLING_MAX_LENGTH)
+    {
+        ESP_ERROR_CHECK(spi_device_polling_transmit(((lr1121_t *)context)->spi, &t));
+    }
+    else
+#endif
+    {
+        // queued: the task sleeps until the DMA completion interrupt
+        ESP_ERROR_CHECK(spi_device_transmit(((lr1121_t *)context)->spi, &t));
+    }
+
+    ((lr1121_t *)context)->spi_stats.transactions++;
+    ((lr1121_t *)context)->spi_stats.bytes += length;
+}
+
+void lora_spi_get_stats(const void* context, lora_spi_stats_t *stats)
+{
+    *stats = ((lr1121_t *)context)->spi_stats;
+}
+
+void lora_spi_reset_stats(const void* context)
+{
+    memset(&((lr1121_t *)context)->spi_stats, 0, sizeof(lora_spi_stats_t));
+}
+
+uint8_t lora_busy_get_stats(const void* context, lora_busy_stats_t *stats, uint8_t max_count)
+{
+    uint8_t count = ((lr1121_t *)context)->busy_stats_count;
+
+    if (count > max_count)
+    {
+        count = max_count;
+    }
+    memcpy(stats, ((lr1121_t *)context)->busy_stats, count * sizeof(lora_busy_stats_t));
+    return count;
+}
+
+void lora_busy_reset_stats(const void* context)
+{
+    ((lr1121_t *)context)->busy_stats_count = 0;
+}
+
+void lora_trace_push(const void* context, const lora_trace_record_t *record)
+{
+#if defined(USE_LR11XX_SPI_TRACE)
+    lr1121_t *lr1121 = (lr1121_t *)context;
+    uint32_t  head   = lr1121->trace_head;
+
+    lr1121->trace[head % LORA_TRACE_SIZE] = *record;
+    __atomic_store_n(&lr1121->trace_head, head + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+uint16_t lora_trace_read(const void* context, lora_trace_record_t *records, uint16_t max_count,
+                         uint32_t *cursor, uint32_t *dropped)
+{
+    uint16_t count = 0;
+    uint32_t lost  = 0;
+
+#if defined(USE_LR11XX_SPI_TRACE)
+    lr1121_t *lr1121 = (lr1121_t *)context;
+    uint32_t  head   = __atomic_load_n(&lr1121->trace_head, __ATOMIC_ACQUIRE);
+    uint32_t  index  = *cursor;
+
+    // the slot after the newest may be mid-write, so at most SIZE - 1 are readable
+    if (head - index > LORA_TRACE_SIZE - 1)
+    {
+        lost  = head - index - (LORA_TRACE_SIZE - 1);
+        index = head - (LORA_TRACE_SIZE - 1);
+    }
+    while (index != head && count < max_count)
+    {
+        records[count++] = lr1121->trace[index % LORA_TRACE_SIZE];
+        index++;
+    }
+
+    // discard what the writer lapped while we copied
+    head = __atomic_load_n(&lr1121->trace_head, __ATOMIC_ACQUIRE);
+    if (head - (index - count) > LORA_TRACE_SIZE - 1)
+    {
+        uint32_t overwritten = head - (index - count) - (LORA_TRACE_SIZE - 1);
+
+        if (overwritten > count)
+        {
+            overwritten = count;
+        }
+        memmove(records, records + overwritten, (count - overwritten) * sizeof(lora_trace_record_t));
+        count -= overwritten;
+        lost  += overwritten;
+    }
+    *cursor = index;
+#endif
+
+    if (dropped != NULL)
+    {
+        *dropped = lost;
+    }
+    return count;
+}
+
+void lora_trace_dump(const void* context)
+{
+#if defined(USE_LR11XX_SPI_TRACE)
+    static uint32_t     cursor = 0;
+    lora_trace_record_t records[16];
+    uint32_t            dropped;
+    uint32_t            total_dropped = 0;
+    uint16_t            count;
+
+    do
+    {
+        count = lora_trace_read(context, records, sizeof(records) / sizeof(records[0]), &cursor, &dropped);
+        total_dropped += dropped;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            // LRTRACE <timestamp_us> <kind> <opcode> <command_length> <data_length> <busy_us> <transfer_us> <status>
+            printf("LRTRACE %lu %c %04x %u %u %lu %lu %u\n", (unsigned long)records[i].timestamp_us,
+                   records[i].kind, records[i].opcode, records[i].command_length, records[i].data_length,
+                   (unsigned long)records[i].busy_us, (unsigned long)records[i].transfer_us, records[i].status);
+        }
+    } while (count > 0);
+
+    if (total_dropped > 0)
+    {
+        printf("LRTRACE dropped %lu\n", (unsigned long)total_dropped);
+    }
+#endif
+}
+
+
+lr1121_modem_response_code_t lr1121_modem_board_event_flush( const void* context )
+{
+    lr1121_modem_response_code_t modem_response_code = LR1121_MODEM_RESPONSE_CODE_OK;
+    lr1121_modem_event_fields_t  event_fields;
+
+    do
+    {
+        modem_response_code = lr1121_modem_get_event( context, &event_fields );
+    } while( modem_response_code != LR1121_MODEM_RESPONSE_CODE_NO_EVENT );
+
+    return modem_response_code;
+}
+
@@ -0,0 +1,419 @@
+/*!
+ * @file      lr11xx_hal.c
+ *
+ * @brief     Hardware Abstraction Layer (HAL) implementation for lr1121
+ *
+ * The Clear BSD License
+ * Copyright Semtech Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Semtech corporation nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL SEMTECH CORPORATION BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "esp_lora_1121.h"
+
+#if defined(USE_LR11XX_SPI_HW_CS)
+#define LR11XX_HAL_NSS_LOW( context )
+#define LR11XX_HAL_NSS_HIGH( context )
+#else
+#define LR11XX_HAL_NSS_LOW( context ) gpio_set_level(((lr1121_t *)context)->cs, 0)
+#define LR11XX_HAL_NSS_HIGH( context ) gpio_set_level(((lr1121_t *)context)->cs, 1)
+#endif
+
+/*!
+ * @brief lr11xx_hal.h API implementation
+ */
+
+/*!
+ * @brief Function to wait the that lr1121 modem-e busy line raise to high
+ *
+ * Spins for LORA_BUSY_SPIN_US, then sleeps on the BUSY falling edge interrupt
+ * armed by lora_init_io.
+ *
+ * @param [in] context Chip implementation context
+ * @param [in] timeout_ms timeout in millisec before leave the function
+ *
+ * @returns lr1121_hal_status_t
+ */
+static lr11xx_hal_status_t lr11xx_hal_wait_on_unbusy(const void *context, uint32_t timeout_ms);
+
+/*!
+ * @brief Charge a BUSY wait to the opcode that caused it
+ *
+ * @param [in] context Chip implementation context
+ * @param [in] busy_us time spent waiting
+ * @param [in] slept the wait outlasted the spin and went through the BUSY interrupt
+ */
+static void lr11xx_hal_record_busy(const void *context, uint32_t busy_us, bool slept);
+
+#if defined(USE_LR11XX_SPI_TRACE)
+/*!
+ * @brief Log one HAL call into the trace ring
+ *
+ * @param [in] context Chip implementation context
+ * @param [in] kind lora_trace_kind_t
+ * @param [in] command opcode bytes, NULL for direct reads
+ * @param [in] start esp_timer_get_time() at call entry
+ * @param [in] status value returned to the driver
+ */
+static void lr11xx_hal_trace(const void *context, uint8_t kind, const uint8_t *command,
+                             uint16_t command_length, uint16_t data_length, int64_t start,
+                             lr11xx_hal_status_t status);
+
+#define LR11XX_HAL_TRACE_BEGIN( context )                    \
+    int64_t trace_start = esp_timer_get_time();              \
+    ((lr1121_t *)context)->trace_busy_us = 0
+#define LR11XX_HAL_TRACE_END( context, kind, command, command_length, data_length, status ) \
+    lr11xx_hal_trace(context, kind, command, command_length, data_length, trace_start, status)
+#else
+#define LR11XX_HAL_TRACE_BEGIN( context )
+#define LR11XX_HAL_TRACE_END( context, kind, command, command_length, data_length, status )
+#endif
+
+static lr11xx_hal_status_t lr11xx_hal_do_write(const void *context, const uint8_t *command,
+                                               const uint16_t command_length, const uint8_t *data,
+                                               const uint16_t data_length);
+
+static lr11xx_hal_status_t lr11xx_hal_do_read(const void *context, const uint8_t *command,
+                                              const uint16_t command_length, uint8_t *data,
+                                              const uint16_t data_length);
+
+static lr11xx_hal_status_t lr11xx_hal_do_direct_read(const void *context, uint8_t *data,
+                                                     const uint16_t data_length);
+
+lr11xx_hal_status_t lr11xx_hal_write(const void *context, const uint8_t *command,
+                                     const uint16_t command_length, const uint8_t *data,
+                                     const uint16_t data_length)
+{
+    LR11XX_HAL_TRACE_BEGIN(context);
+    lr11xx_hal_status_t status = lr11xx_hal_do_write(context, command, command_length, data, data_length);
+    LR11XX_HAL_TRACE_END(context, LORA_TRACE_WRITE, command, command_length, data_length, status);
+    return status;
+}
+
+lr11xx_hal_status_t lr11xx_hal_read(const void *context, const uint8_t *command,
+                                    const uint16_t command_length, uint8_t *data,
+                                    const uint16_t data_length)
+{
+    LR11XX_HAL_TRACE_BEGIN(context);
+    lr11xx_hal_status_t status = lr11xx_hal_do_read(context, command, command_length, data, data_length);
+    LR11XX_HAL_TRACE_END(context, LORA_TRACE_READ, command, command_length, data_length, status);
+    return status;
+}
+
+lr11xx_hal_status_t lr11xx_hal_direct_read(const void *context, uint8_t *data,
+                                           const uint16_t data_length)
+{
+    LR11XX_HAL_TRACE_BEGIN(context);
+    lr11xx_hal_status_t status = lr11xx_hal_do_direct_read(context, data, data_length);
+    LR11XX_HAL_TRACE_END(context, LORA_TRACE_DIRECT_READ, NULL, 0, data_length, status);
+    return status;
+}
+
+static lr11xx_hal_status_t lr11xx_hal_do_write(const void *context, const uint8_t *command,
+                                               const uint16_t command_length, const uint8_t *data,
+                                               const uint16_t data_length)
+{
+    uint8_t *buffer = ((lr1121_t *)context)->spi_buffer;
+    uint16_t length = command_length + data_length;
+
+#if defined(USE_LR11XX_CRC_OVER_SPI)
+    uint8_t cmd_crc = lr11xx_hal_compute_crc(0xFF, command, command_length);
+    if (data_length > 0){
+        cmd_crc = lr11xx_hal_compute_crc(cmd_crc, data, data_length);
+    }
+    length++;
+#endif
+
+    ((lr1121_t *)context)->spi_stats.hal_calls++;
+
+    if (lr11xx_hal_wait_on_unbusy(context, 10000) == LR11XX_HAL_STATUS_OK)
+    {
+        /* NSS low */
+        LR11XX_HAL_NSS_LOW(context);
+        if (length <= LORA_SPI_BUFFER_SIZE)
+        {
+            /* Send CMD, data and CRC in one transaction */
+            memcpy(buffer, command, command_length);
+            if (data_length > 0)
+            {
+                memcpy(buffer + command_length, data, data_length);
+            }
+#if defined(USE_LR11XX_CRC_OVER_SPI)
+            buffer[length - 1] = cmd_crc;
+#endif
+            lora_spi_write_bytes(context, buffer, length);
+        }
+        else
+        {
+#if defined(USE_LR11XX_SPI_HW_CS)
+            /* NSS would rise between the parts */
+            return LR11XX_HAL_STATUS_ERROR;
+#endif
+            /* Send CMD */
+            lora_spi_write_bytes(context, (uint8_t *)command, command_length);
+            /* Send Data */
+            lora_spi_write_bytes(context, (uint8_t *)data, data_length);
+#if defined(USE_LR11XX_CRC_OVER_SPI)
+            lora_spi_write_bytes(context, &cmd_crc, 1);
+#endif
+        }
+        /* NSS high */
+        LR11XX_HAL_NSS_HIGH(context);
+        ((lr1121_t *)context)->busy_opcode = ((uint16_t)command[0] << 8) | command[1];
+
+        return LR11XX_HAL_STATUS_OK;
+    }
+    return LR11XX_HAL_STATUS_ERROR;
+}
+
+static lr11xx_hal_status_t lr11xx_hal_do_read(const void *context, const uint8_t *command,
+                                              const uint16_t command_length, uint8_t *data,
+                                              const uint16_t data_length)
+{
+    uint8_t *buffer = ((lr1121_t *)context)->spi_buffer;
+    uint16_t length = 1 + data_length;  // dummy byte and response
+
+#if defined(USE_LR11XX_CRC_OVER_SPI)
+    const uint8_t cmd_crc = lr11xx_hal_compute_crc(0xFF, command, command_length);
+    length++;
+#endif
+
+    ((lr1121_t *)context)->spi_stats.hal_calls++;
+
+    if (length > LORA_SPI_BUFFER_SIZE || command_length + 1 > LORA_SPI_BUFFER_SIZE)
+    {
+        return LR11XX_HAL_STATUS_ERROR;
+    }
+
+    if (lr11xx_hal_wait_on_unbusy(context, 10000) == LR11XX_HAL_STATUS_OK)
+    {
+        /* NSS low */
+        LR11XX_HAL_NSS_LOW(context);
+        /* Send CMD and CRC in one transaction */
+        memcpy(buffer, command, command_length);
+#if defined(USE_LR11XX_CRC_OVER_SPI)
+        buffer[command_length] = cmd_crc;
+        lora_spi_write_bytes(context, buffer, command_length + 1);
+#else
+        lora_spi_write_bytes(context, buffer, command_length);
+#endif
+        /* NSS high */
+        LR11XX_HAL_NSS_HIGH(context);
+        ((lr1121_t *)context)->busy_opcode = ((uint16_t)command[0] << 8) | command[1];
+
+        /* Wait on busy pin up to 1000 ms */
+        if (lr11xx_hal_wait_on_unbusy(context, 1000) != LR11XX_HAL_STATUS_OK)
+        {
+            return LR11XX_HAL_STATUS_ERROR;
+        }
+
+        /* NSS low */
+        LR11XX_HAL_NSS_LOW(context);
+        /* dummy byte, response and CRC in one transaction */
+        lora_spi_read_bytes(context, buffer, length);
+        /* NSS high */
+        LR11XX_HAL_NSS_HIGH(context);
+
+        if (data_length > 0)
+        {
+            memcpy(data, buffer + 1, data_length);
+        }
+
+#if defined( USE_LR11XX_CRC_OVER_SPI )
+        if( buffer[length - 1] != lr11xx_hal_compute_crc( 0xFF, buffer, length - 1 ) )
+        {
+            return LR11XX_HAL_STATUS_ERROR;
+        }
+#endif
+        return LR11XX_HAL_STATUS_OK;
+    }
+    return LR11XX_HAL_STATUS_ERROR;
+}
+
+static lr11xx_hal_status_t lr11xx_hal_do_direct_read(const void *context, uint8_t *data,
+                                                     const uint16_t data_length)
+{
+    ((lr1121_t *)context)->spi_stats.hal_calls++;
+
+    if (lr11xx_hal_wait_on_unbusy(context, 10000) == LR11XX_HAL_STATUS_OK)
+    {
+        /* NSS low */
+        LR11XX_HAL_NSS_LOW(context);
+
+        lora_spi_read_bytes(context, data, data_length);
+
+        /* NSS high */
+        LR11XX_HAL_NSS_HIGH(context);
+
+        return LR11XX_HAL_STATUS_OK;
+    }
+    return LR11XX_HAL_STATUS_ERROR;
+}
+
+lr11xx_hal_status_t lr11xx_hal_reset(const void *context)
+{
+
+    gpio_set_level(((lr1121_t *)context)->reset, 0);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    gpio_set_level(((lr1121_t *)context)->reset, 1);
+
+    return LR11XX_HAL_STATUS_OK;
+}
+
+lr11xx_hal_status_t lr11xx_hal_wakeup(const void *context)
+{
+    /* Wakeup radio */
+#if defined(USE_LR11XX_SPI_HW_CS)
+    /* any transaction gives the NSS falling edge */
+    uint8_t nop = LR11XX_NOP;
+    lora_spi_write_bytes(context, &nop, 1);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+#else
+    gpio_set_level(((lr1121_t *)context)->cs, 0);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    gpio_set_level(((lr1121_t *)context)->cs, 1);
+#endif
+
+    /* Wait on busy pin for 1000 ms */
+    return LR11XX_HAL_STATUS_OK;
+}
+
+static void lr11xx_hal_record_busy(const void *context, uint32_t busy_us, bool slept)
+{
+    lr1121_t          *lr1121 = (lr1121_t *)context;
+    lora_busy_stats_t *entry  = NULL;
+
+#if defined(USE_LR11XX_SPI_TRACE)
+    lr1121->trace_busy_us += busy_us;
+#endif
+
+    for (uint8_t i = 0; i < lr1121->busy_stats_count; i++)
+    {
+        if (lr1121->busy_stats[i].opcode == lr1121->busy_opcode)
+        {
+            entry = &lr1121->busy_stats[i];
+            break;
+        }
+    }
+    if (entry == NULL)
+    {
+        if (lr1121->busy_stats_count == LORA_BUSY_STATS_SIZE)
+        {
+            return;
+        }
+        entry = &lr1121->busy_stats[lr1121->busy_stats_count++];
+        memset(entry, 0, sizeof(*entry));
+        entry->opcode = lr1121->busy_opcode;
+    }
+
+    entry->count++;
+    entry->total_us += busy_us;
+    if (busy_us > entry->max_us)
+    {
+        entry->max_us = busy_us;
+    }
+    if (slept)
+    {
+        entry->sleeps++;
+    }
+}
+
+#if defined(USE_LR11XX_SPI_TRACE)
+static void lr11xx_hal_trace(const void *context, uint8_t kind, const uint8_t *command,
+                             uint16_t command_length, uint16_t data_length, int64_t start,
+                             lr11xx_hal_status_t status)
+{
+    lr1121_t           *lr1121  = (lr1121_t *)context;
+    uint32_t            elapsed = esp_timer_get_time() - start;
+    lora_trace_record_t record  = {
+        .timestamp_us   = (uint32_t)start,
+        .opcode         = (command != NULL && command_length >= 2) ? ((uint16_t)command[0] << 8) | command[1]
+                                                                    : LORA_BUSY_OPCODE_NONE,
+        .kind           = kind,
+        .status         = status,
+        .command_length = command_length,
+        .data_length    = data_length,
+        .busy_us        = lr1121->trace_busy_us,
+        .transfer_us    = elapsed > lr1121->trace_busy_us ? elapsed - lr1121->trace_busy_us : 0,
+    };
+
+    lora_trace_push(context, &record);
+}
+#endif
+
+static lr11xx_hal_status_t lr11xx_hal_wait_on_unbusy(const void *context, uint32_t timeout_ms)
+{
+    lr1121_t *lr1121 = (lr1121_t *)context;
+    int64_t   start  = esp_timer_get_time();
+    int64_t   now    = start;
+
+    /* Most commands release BUSY within microseconds */
+    while (gpio_get_level(lr1121->busy) == 1)
+    {
+        now = esp_timer_get_time();
+        if (now - start >= LORA_BUSY_SPIN_US)
+        {
+            break;
+        }
+    }
+
+    if (gpio_get_level(lr1121->busy) == 1)
+    {
+        if (lr1121->busy_done != NULL)
+        {
+            /* Sleep until the falling edge, re-checking the level after arming */
+            xSemaphoreTake(lr1121->busy_done, 0);
+            gpio_intr_enable(lr1121->busy);
+            if (gpio_get_level(lr1121->busy) == 1)
+            {
+                xSemaphoreTake(lr1121->busy_done, pdMS_TO_TICKS(timeout_ms) + 1);
+            }
+            gpio_intr_disable(lr1121->busy);
+        }
+
+        /* No interrupt available, or a spurious wake: spin out the rest of the timeout */
+        while (gpio_get_level(lr1121->busy) == 1)
+        {
+            if (esp_timer_get_time() - start > (int64_t)timeout_ms * 1000)
+            {
+                lr11xx_hal_record_busy(context, esp_timer_get_time() - start, true);
+                return LR11XX_HAL_STATUS_ERROR;
+            }
+        }
+        lr11xx_hal_record_busy(context, esp_timer_get_time() - start, true);
+        return LR11XX_HAL_STATUS_OK;
+    }
+
+    lr11xx_hal_record_busy(context, now - start, false);
+    return LR11XX_HAL_STATUS_OK;
+}
@@ -0,0 +1,368 @@
+#include "lr11xx_channel.h"
+
+#include <string.h>
+
+#include "lr11xx_system_types.h"
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define CHANNEL_NEVER			UINT64_MAX
+#define PACKET_LATENCY_BIN_US		5000
+#define FRAME_LATENCY_BIN_US		20000
+#define THROUGHPUT_BIN_BPS		50
+
+static const lr11xx_channel_link_t default_link = {
+	.rssi_dbm = -80,
+	.snr_db = 8,
+};
+
+// xorshift32, deterministic per seed
+static uint32_t rng_next(lr11xx_channel_t* channel) {
+	uint32_t x = channel->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	channel->rng = x;
+	return x;
+}
+
+static bool rng_chance(lr11xx_channel_t* channel, float probability) {
+	return probability > 0 && (rng_next(channel) >> 8) < probability * (1 << 24);
+}
+
+static int node_index(const lr11xx_channel_t* channel, const lr11xx_sim_t* sim) {
+	for(uint8_t i = 0; i < channel->node_count; i++) {
+		if(channel->nodes[i] == sim) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool same_channel(const lr11xx_channel_transmission_t* a, const lr11xx_channel_transmission_t* b) {
+	return a->rf_freq_in_hz == b->rf_freq_in_hz && a->pkt_type == b->pkt_type &&
+		a->lora_mod.sf == b->lora_mod.sf && a->lora_mod.bw == b->lora_mod.bw;
+}
+
+static bool is_tuned_to(const lr11xx_sim_t* sim, const lr11xx_channel_transmission_t* tx) {
+	return sim->rf_freq_in_hz == tx->rf_freq_in_hz && sim->pkt_type == tx->pkt_type &&
+		sim->lora_mod.sf == tx->lora_mod.sf && sim->lora_mod.bw == tx->lora_mod.bw &&
+		sim->sync_word == tx->sync_word;
+}
+
+static void on_tx(lr11xx_sim_t* sim, void* user) {
+	lr11xx_channel_t* channel = user;
+	int from = node_index(channel, sim);
+	lr11xx_channel_transmission_t* tx;
+
+	if(from < 0) {
+		return;
+	}
+	if(channel->in_flight_count == LR11XX_CHANNEL_MAX_IN_FLIGHT) {
+		channel->in_flight_dropped++;
+		return;
+	}
+
+	tx = &channel->in_flight[channel->in_flight_count++];
+	tx->from = from;
+	tx->pending = 0;
+	tx->start_us = sim->now_us;
+	tx->end_us = sim->tx_end_us;
+	tx->rf_freq_in_hz = sim->rf_freq_in_hz;
+	tx->pkt_type = sim->pkt_type;
+	tx->lora_mod = sim->lora_mod;
+	tx->sync_word = sim->sync_word;
+	tx->length = sim->tx_length;
+	memcpy(tx->data, sim->tx_buffer, sim->tx_length);
+
+	for(uint8_t to = 0; to < channel->node_count; to++) {
+		const lr11xx_channel_link_t* link = &channel->links[from][to];
+
+		if(to == from) {
+			continue;
+		}
+		tx->pending |= 1 << to;
+		tx->deliver_at_us[to] = tx->end_us + link->delay_us +
+			(link->jitter_us ? rng_next(channel) % (link->jitter_us + 1) : 0);
+	}
+
+	channel->stats[from].tx_packets++;
+	channel->stats[from].tx_airtime_us += tx->end_us - tx->start_us;
+}
+
+// another transmission overlapping tx on air, not drowned out by it at node to
+static bool collides(const lr11xx_channel_t* channel, const lr11xx_channel_transmission_t* tx, uint8_t to) {
+	int8_t rssi_dbm = channel->links[tx->from][to].rssi_dbm;
+
+	for(uint8_t i = 0; i < channel->in_flight_count; i++) {
+		const lr11xx_channel_transmission_t* other = &channel->in_flight[i];
+
+		if(other == tx || other->from == to || !same_channel(tx, other)) {
+			continue;
+		}
+		if(other->start_us < tx->end_us && other->end_us > tx->start_us &&
+				rssi_dbm < channel->links[other->from][to].rssi_dbm + LR11XX_CHANNEL_CAPTURE_DB) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void deliver(lr11xx_channel_t* channel, lr11xx_channel_transmission_t* tx, uint8_t to) {
+	lr11xx_sim_t* sim = channel->nodes[to];
+	const lr11xx_channel_link_t* link = &channel->links[tx->from][to];
+	lr11xx_channel_node_stats_t* stats = &channel->stats[to];
+	uint32_t irq_flags = 0;
+	uint32_t* error_count = NULL;
+
+	tx->pending &= ~(1 << to);
+	lr11xx_sim_advance(sim, tx->deliver_at_us[to]);
+
+	if(!is_tuned_to(sim, tx)) {
+		return;
+	}
+	if(rng_chance(channel, link->loss)) {
+		stats->rx_lost++;
+		return;
+	}
+
+	if(collides(channel, tx, to)) {
+		irq_flags = LR11XX_SYSTEM_IRQ_CRC_ERROR;
+		error_count = &stats->rx_collisions;
+	}
+	else if(rng_chance(channel, link->header_error)) {
+		irq_flags = LR11XX_SYSTEM_IRQ_HEADER_ERROR;
+		error_count = &stats->rx_header_errors;
+	}
+	else if(rng_chance(channel, link->crc_error)) {
+		irq_flags = LR11XX_SYSTEM_IRQ_CRC_ERROR;
+		error_count = &stats->rx_crc_errors;
+	}
+
+	if(!lr11xx_sim_receive(sim, tx->data, tx->length, link->rssi_dbm, link->snr_db, irq_flags)) {
+		stats->rx_missed++;
+	}
+	else if(error_count) {
+		(*error_count)++;
+	}
+	else {
+		stats->rx_delivered++;
+		stats->rx_payload_bytes += tx->length;
+		channel->window_bytes += tx->length;
+		lr11xx_channel_histogram_add(&channel->packet_latency, sim->now_us - tx->start_us);
+	}
+}
+
+static void close_throughput_windows(lr11xx_channel_t* channel, uint64_t now_us) {
+	while(now_us >= channel->window_start_us + LR11XX_CHANNEL_THROUGHPUT_WINDOW_US) {
+		lr11xx_channel_histogram_add(&channel->throughput,
+			(uint64_t)channel->window_bytes * 1000000 / LR11XX_CHANNEL_THROUGHPUT_WINDOW_US);
+		channel->window_bytes = 0;
+		channel->window_start_us += LR11XX_CHANNEL_THROUGHPUT_WINDOW_US;
+	}
+}
+
+// drop transmissions that are delivered everywhere and can no longer overlap anything
+static void prune(lr11xx_channel_t* channel) {
+	uint64_t horizon = CHANNEL_NEVER;
+	uint8_t kept = 0;
+
+	for(uint8_t i = 0; i < channel->node_count; i++) {
+		if(channel->nodes[i]->now_us < horizon) {
+			horizon = channel->nodes[i]->now_us;
+		}
+	}
+	for(uint8_t i = 0; i < channel->in_flight_count; i++) {
+		if(channel->in_flight[i].pending && channel->in_flight[i].start_us < horizon) {
+			horizon = channel->in_flight[i].start_us;
+		}
+	}
+
+	for(uint8_t i = 0; i < channel->in_flight_count; i++) {
+		lr11xx_channel_transmission_t* tx = &channel->in_flight[i];
+
+		if(tx->pending || tx->end_us > horizon) {
+			if(kept != i) {
+				channel->in_flight[kept] = *tx;
+			}
+			kept++;
+		}
+	}
+	channel->in_flight_count = kept;
+}
+
+static void histogram_print(const lr11xx_channel_histogram_t* histogram, const char* name, const char* unit, FILE* out) {
+	fprintf(out, "%s: n=%u mean=%llu p50=%u p90=%u p99=%u max=%u %s\n", name, histogram->count,
+		histogram->count ? (unsigned long long)(histogram->sum / histogram->count) : 0,
+		lr11xx_channel_histogram_percentile(histogram, 0.5f),
+		lr11xx_channel_histogram_percentile(histogram, 0.9f),
+		lr11xx_channel_histogram_percentile(histogram, 0.99f),
+		histogram->max, unit);
+
+	for(uint8_t i = 0; i < LR11XX_CHANNEL_HISTOGRAM_BINS; i++) {
+		if(histogram->bins[i]) {
+			fprintf(out, "  <%8u %s %6u\n", (i + 1) * histogram->bin_width, unit, histogram->bins[i]);
+		}
+	}
+	if(histogram->overflow) {
+		fprintf(out, "  >=%7u %s %6u\n", LR11XX_CHANNEL_HISTOGRAM_BINS * histogram->bin_width, unit,
+			histogram->overflow);
+	}
+}
+
+// --- PUBLIC METHODS ---
+
+void lr11xx_channel_init(lr11xx_channel_t* channel, uint32_t seed) {
+	memset(channel, 0, sizeof(*channel));
+	channel->rng = seed ? seed : 1;
+	lr11xx_channel_histogram_init(&channel->packet_latency, PACKET_LATENCY_BIN_US);
+	lr11xx_channel_histogram_init(&channel->frame_latency, FRAME_LATENCY_BIN_US);
+	lr11xx_channel_histogram_init(&channel->throughput, THROUGHPUT_BIN_BPS);
+}
+
+int lr11xx_channel_add_node(lr11xx_channel_t* channel, lr11xx_sim_t* sim) {
+	uint8_t node = channel->node_count;
+
+	if(node == LR11XX_CHANNEL_MAX_NODES) {
+		return -1;
+	}
+
+	channel->nodes[node] = sim;
+	channel->node_count++;
+	for(uint8_t i = 0; i < channel->node_count; i++) {
+		channel->links[node][i] = default_link;
+		channel->links[i][node] = default_link;
+	}
+
+	sim->config.on_tx = on_tx;
+	sim->config.user = channel;
+	return node;
+}
+
+void lr11xx_channel_set_link(lr11xx_channel_t* channel, uint8_t from, uint8_t to, const lr11xx_channel_link_t* link) {
+	channel->links[from][to] = *link;
+}
+
+void lr11xx_channel_set_link_symmetric(lr11xx_channel_t* channel, uint8_t a, uint8_t b, const lr11xx_channel_link_t* link) {
+	channel->links[a][b] = *link;
+	channel->links[b][a] = *link;
+}
+
+uint64_t lr11xx_channel_next_event_us(const lr11xx_channel_t* channel) {
+	uint64_t at = CHANNEL_NEVER;
+
+	for(uint8_t i = 0; i < channel->node_count; i++) {
+		uint64_t node_at = lr11xx_sim_next_event_us(channel->nodes[i]);
+
+		if(node_at < at) {
+			at = node_at;
+		}
+	}
+
+	for(uint8_t i = 0; i < channel->in_flight_count; i++) {
+		const lr11xx_channel_transmission_t* tx = &channel->in_flight[i];
+
+		for(uint8_t to = 0; to < channel->node_count; to++) {
+			if((tx->pending & (1 << to)) && tx->deliver_at_us[to] < at) {
+				at = tx->deliver_at_us[to];
+			}
+		}
+	}
+	return at;
+}
+
+void lr11xx_channel_advance(lr11xx_channel_t* channel, uint64_t now_us) {
+	uint64_t at;
+
+	while((at = lr11xx_channel_next_event_us(channel)) <= now_us) {
+		for(uint8_t i = 0; i < channel->node_count; i++) {
+			lr11xx_sim_advance(channel->nodes[i], at);
+		}
+
+		// deliveries can start transmissions (auto tx/rx), so index rather than cache pointers
+		for(uint8_t i = 0; i < channel->in_flight_count; i++) {
+			for(uint8_t to = 0; to < channel->node_count; to++) {
+				if((channel->in_flight[i].pending & (1 << to)) && channel->in_flight[i].deliver_at_us[to] <= at) {
+					deliver(channel, &channel->in_flight[i], to);
+				}
+			}
+		}
+
+		close_throughput_windows(channel, at);
+		prune(channel);
+	}
+
+	for(uint8_t i = 0; i < channel->node_count; i++) {
+		lr11xx_sim_advance(channel->nodes[i], now_us);
+	}
+	close_throughput_windows(channel, now_us);
+	prune(channel);
+
+	if(now_us > channel->now_us) {
+		channel->now_us = now_us;
+	}
+}
+
+void lr11xx_channel_record_latency(lr11xx_channel_t* channel, uint32_t latency_us) {
+	lr11xx_channel_histogram_add(&channel->frame_latency, latency_us);
+}
+
+void lr11xx_channel_get_node_stats(const lr11xx_channel_t* channel, uint8_t node, lr11xx_channel_node_stats_t* stats) {
+	*stats = channel->stats[node];
+}
+
+void lr11xx_channel_print_report(lr11xx_channel_t* channel, FILE* out) {
+	fprintf(out, "node    tx  airtime_ms  delivered    bytes   lost  crc  hdr  coll  missed\n");
+	for(uint8_t i = 0; i < channel->node_count; i++) {
+		const lr11xx_channel_node_stats_t* stats = &channel->stats[i];
+
+		fprintf(out, "%4u %5u %11llu %10u %8u %6u %4u %4u %5u %7u\n", i, stats->tx_packets,
+			(unsigned long long)(stats->tx_airtime_us / 1000), stats->rx_delivered, stats->rx_payload_bytes,
+			stats->rx_lost, stats->rx_crc_errors, stats->rx_header_errors, stats->rx_collisions,
+			stats->rx_missed);
+	}
+	if(channel->in_flight_dropped) {
+		fprintf(out, "%u transmissions not modelled, in-flight table full\n", channel->in_flight_dropped);
+	}
+
+	histogram_print(&channel->packet_latency, "packet latency", "us", out);
+	histogram_print(&channel->frame_latency, "frame latency", "us", out);
+	histogram_print(&channel->throughput, "throughput", "B/s", out);
+}
+
+void lr11xx_channel_histogram_init(lr11xx_channel_histogram_t* histogram, uint32_t bin_width) {
+	memset(histogram, 0, sizeof(*histogram));
+	histogram->bin_width = bin_width ? bin_width : 1;
+}
+
+void lr11xx_channel_histogram_add(lr11xx_channel_histogram_t* histogram, uint32_t value) {
+	uint32_t bin = value / histogram->bin_width;
+
+	if(bin < LR11XX_CHANNEL_HISTOGRAM_BINS) {
+		histogram->bins[bin]++;
+	}
+	else {
+		histogram->overflow++;
+	}
+	histogram->count++;
+	histogram->sum += value;
+	if(value > histogram->max) {
+		histogram->max = value;
+	}
+}
+
+uint32_t lr11xx_channel_histogram_percentile(const lr11xx_channel_histogram_t* histogram, float fraction) {
+	uint32_t target = fraction * histogram->count;
+	uint32_t seen = 0;
+
+	for(uint8_t i = 0; i < LR11XX_CHANNEL_HISTOGRAM_BINS; i++) {
+		seen += histogram->bins[i];
+		if(seen > target) {
+			uint32_t edge = (i + 1) * histogram->bin_width;
+
+			return edge < histogram->max ? edge : histogram->max;
+		}
+	}
+	return histogram->max;
+}
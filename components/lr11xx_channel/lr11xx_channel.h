@@ -0,0 +1,151 @@
+#ifndef LR11XX_CHANNEL_H
+#define LR11XX_CHANNEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lr11xx_sim.h"
+
+/*
+ * virtual RF channel between lr11xx_sim radios, host builds only
+ *
+ * every transmission is heard by each node tuned to the same frequency, packet
+ * type, spreading factor, bandwidth and sync word, at its end of air time
+ * (time on air as computed by the sim from the driver's LoRa formula). per link
+ * the channel drops packets, flags CRC or header errors and adds delay.
+ * transmissions overlapping at a receiver collide unless one is at least
+ * LR11XX_CHANNEL_CAPTURE_DB stronger. a node that is transmitting or not in RX
+ * misses the packet, as on air.
+ *
+ * harness loop, one lr11xx_sim_t per drone/controller:
+ *
+ *   lr11xx_channel_advance(&channel, lr11xx_channel_next_event_us(&channel));
+ *   then run the link layer of every node whose lr11xx_sim_dio_level() is high
+ */
+
+// CHANNEL SETTINGS
+#define LR11XX_CHANNEL_MAX_NODES		17	// TDMA_MAX_DRONES plus the controller
+#define LR11XX_CHANNEL_MAX_IN_FLIGHT		32
+#define LR11XX_CHANNEL_CAPTURE_DB		6
+#define LR11XX_CHANNEL_HISTOGRAM_BINS		32
+#define LR11XX_CHANNEL_THROUGHPUT_WINDOW_US	1000000
+
+typedef struct lr11xx_channel_link_s {
+	int8_t rssi_dbm;
+	int8_t snr_db;
+	float loss;			// probability the receiver hears nothing
+	float crc_error;		// probability of RX_DONE with CRC_ERROR
+	float header_error;		// probability of HEADER_ERROR only
+	uint32_t delay_us;		// extra delivery delay, e.g. a repeater hop
+	uint32_t jitter_us;		// uniform 0..jitter_us added to delay_us
+} lr11xx_channel_link_t;
+
+typedef struct lr11xx_channel_histogram_s {
+	uint32_t bin_width;
+	uint32_t bins[LR11XX_CHANNEL_HISTOGRAM_BINS];
+	uint32_t overflow;		// samples beyond the last bin
+	uint32_t count;
+	uint64_t sum;
+	uint32_t max;
+} lr11xx_channel_histogram_t;
+
+typedef struct lr11xx_channel_node_stats_s {
+	uint32_t tx_packets;
+	uint64_t tx_airtime_us;
+	uint32_t rx_delivered;		// clean RX_DONE
+	uint32_t rx_payload_bytes;
+	uint32_t rx_lost;		// dropped by the link loss model
+	uint32_t rx_crc_errors;
+	uint32_t rx_header_errors;
+	uint32_t rx_collisions;
+	uint32_t rx_missed;		// arrived while not listening
+} lr11xx_channel_node_stats_t;
+
+typedef struct lr11xx_channel_transmission_s {
+	uint8_t from;
+	uint32_t pending;		// bit n: not yet delivered to node n
+	uint64_t deliver_at_us[LR11XX_CHANNEL_MAX_NODES];
+	uint64_t start_us;
+	uint64_t end_us;
+	uint32_t rf_freq_in_hz;
+	lr11xx_radio_pkt_type_t pkt_type;
+	lr11xx_radio_mod_params_lora_t lora_mod;
+	uint8_t sync_word;
+	uint8_t length;
+	uint8_t data[LR11XX_SIM_BUFFER_SIZE];
+} lr11xx_channel_transmission_t;
+
+typedef struct lr11xx_channel_s {
+	uint64_t now_us;
+	uint32_t rng;
+
+	uint8_t node_count;
+	lr11xx_sim_t* nodes[LR11XX_CHANNEL_MAX_NODES];
+	lr11xx_channel_link_t links[LR11XX_CHANNEL_MAX_NODES][LR11XX_CHANNEL_MAX_NODES];	// [from][to]
+	lr11xx_channel_node_stats_t stats[LR11XX_CHANNEL_MAX_NODES];
+
+	lr11xx_channel_transmission_t in_flight[LR11XX_CHANNEL_MAX_IN_FLIGHT];
+	uint8_t in_flight_count;
+	uint32_t in_flight_dropped;	// transmissions not modelled, raise LR11XX_CHANNEL_MAX_IN_FLIGHT
+
+	// packet latency: start of transmission to RX_DONE, clean deliveries only
+	lr11xx_channel_histogram_t packet_latency;
+	// link layer latency recorded by the harness with lr11xx_channel_record_latency()
+	lr11xx_channel_histogram_t frame_latency;
+	// delivered payload bytes per second, one sample per throughput window
+	lr11xx_channel_histogram_t throughput;
+	uint64_t window_start_us;
+	uint32_t window_bytes;
+} lr11xx_channel_t;
+
+/*!
+ * @brief empty channel, seed makes loss and error draws reproducible
+ */
+void lr11xx_channel_init(lr11xx_channel_t* channel, uint32_t seed);
+
+/*!
+ * @brief connect a radio, takes over its on_tx hook. links to and from the new
+ * node start lossless at -80 dBm / 8 dB SNR
+ *
+ * @returns node index, -1 if LR11XX_CHANNEL_MAX_NODES are connected
+ */
+int lr11xx_channel_add_node(lr11xx_channel_t* channel, lr11xx_sim_t* sim);
+
+void lr11xx_channel_set_link(lr11xx_channel_t* channel, uint8_t from, uint8_t to, const lr11xx_channel_link_t* link);
+
+/*!
+ * @brief same link model both ways
+ */
+void lr11xx_channel_set_link_symmetric(lr11xx_channel_t* channel, uint8_t a, uint8_t b, const lr11xx_channel_link_t* link);
+
+/*!
+ * @returns earliest pending delivery or radio event, UINT64_MAX if idle
+ */
+uint64_t lr11xx_channel_next_event_us(const lr11xx_channel_t* channel);
+
+/*!
+ * @brief run every radio and delivery due up to now_us, in time order
+ */
+void lr11xx_channel_advance(lr11xx_channel_t* channel, uint64_t now_us);
+
+void lr11xx_channel_record_latency(lr11xx_channel_t* channel, uint32_t latency_us);
+
+void lr11xx_channel_get_node_stats(const lr11xx_channel_t* channel, uint8_t node, lr11xx_channel_node_stats_t* stats);
+
+/*!
+ * @brief per-node counters and the three histograms
+ */
+void lr11xx_channel_print_report(lr11xx_channel_t* channel, FILE* out);
+
+void lr11xx_channel_histogram_init(lr11xx_channel_histogram_t* histogram, uint32_t bin_width);
+
+void lr11xx_channel_histogram_add(lr11xx_channel_histogram_t* histogram, uint32_t value);
+
+/*!
+ * @returns upper edge of the bin holding the given fraction (0..1) of samples,
+ * capped at the largest sample
+ */
+uint32_t lr11xx_channel_histogram_percentile(const lr11xx_channel_histogram_t* histogram, float fraction);
+
+#endif
@@ -0,0 +1,516 @@
+#include "lr11xx_sim.h"
+
+#include <string.h>
+
+#include "lr11xx_radio.h"
+#include "lr11xx_system_types.h"
+
+// --- PRIVATE DEFS AND METHODS ---
+
+// opcodes the driver sends, see the *_OC enums in the lr11xx_driver sources
+#define SIM_OC_GET_VERSION		0x0101
+#define SIM_OC_WRITE_REGMEM32		0x0105
+#define SIM_OC_READ_REGMEM32		0x0106
+#define SIM_OC_WRITE_BUFFER8		0x0109
+#define SIM_OC_READ_BUFFER8		0x010A
+#define SIM_OC_CLEAR_RXBUFFER		0x010B
+#define SIM_OC_WRITE_REGMEM32_MASK	0x010C
+#define SIM_OC_GET_ERRORS		0x010D
+#define SIM_OC_CLEAR_ERRORS		0x010E
+#define SIM_OC_CALIBRATE		0x010F
+#define SIM_OC_SET_REGMODE		0x0110
+#define SIM_OC_CALIBRATE_IMAGE		0x0111
+#define SIM_OC_SET_DIO_AS_RF_SWITCH	0x0112
+#define SIM_OC_SET_DIO_IRQ_PARAMS	0x0113
+#define SIM_OC_CLEAR_IRQ		0x0114
+#define SIM_OC_CONFIG_LF_CLOCK		0x0116
+#define SIM_OC_SET_TCXO_MODE		0x0117
+#define SIM_OC_REBOOT			0x0118
+#define SIM_OC_SET_SLEEP		0x011B
+#define SIM_OC_SET_STANDBY		0x011C
+#define SIM_OC_SET_FS			0x011D
+#define SIM_OC_ENABLE_SPI_CRC		0x0128
+
+#define SIM_OC_RESET_STATS		0x0200
+#define SIM_OC_GET_STATS		0x0201
+#define SIM_OC_GET_PKT_TYPE		0x0202
+#define SIM_OC_GET_RXBUFFER_STATUS	0x0203
+#define SIM_OC_GET_PKT_STATUS		0x0204
+#define SIM_OC_GET_RSSI_INST		0x0205
+#define SIM_OC_SET_GFSK_SYNC_WORD	0x0206
+#define SIM_OC_SET_RX			0x0209
+#define SIM_OC_SET_TX			0x020A
+#define SIM_OC_SET_RF_FREQUENCY		0x020B
+#define SIM_OC_AUTO_TX_RX		0x020C
+#define SIM_OC_SET_PKT_TYPE		0x020E
+#define SIM_OC_SET_MODULATION_PARAM	0x020F
+#define SIM_OC_SET_PKT_PARAM		0x0210
+#define SIM_OC_SET_TX_PARAMS		0x0211
+#define SIM_OC_SET_PKT_ADRS		0x0212
+#define SIM_OC_SET_RX_TX_FALLBACK_MODE	0x0213
+#define SIM_OC_SET_PA_CFG		0x0215
+#define SIM_OC_SET_GFSK_CRC_PARAMS	0x0224
+#define SIM_OC_SET_GFSK_WHITENING	0x0225
+#define SIM_OC_SET_RX_BOOSTED		0x0227
+#define SIM_OC_SET_RSSI_CALIBRATION	0x0229
+#define SIM_OC_SET_LORA_SYNC_WORD	0x022B
+
+#define SIM_RTC_STEP_HZ			32768
+#define SIM_RX_SINGLE			0x000000
+#define SIM_RX_CONTINUOUS		0xFFFFFF
+#define SIM_AUTO_TX_RX_DISABLED		0xFFFFFF
+#define SIM_NEVER			UINT64_MAX
+#define SIM_NOISE_FLOOR_DBM		-120
+
+static uint64_t rtc_step_to_us(uint32_t rtc_step) {
+	return ((uint64_t)rtc_step * 1000000 + SIM_RTC_STEP_HZ - 1) / SIM_RTC_STEP_HZ;
+}
+
+static uint32_t get_u24(const uint8_t* p) {
+	return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_u16(uint8_t* p, uint16_t value) {
+	p[0] = value >> 8;
+	p[1] = value;
+}
+
+// BUSY time after each command, rough figures from the datasheet
+static uint32_t busy_us(uint16_t opcode) {
+	switch(opcode) {
+		case SIM_OC_CALIBRATE:
+			return 5000;
+		case SIM_OC_CALIBRATE_IMAGE:
+			return 1500;
+		case SIM_OC_REBOOT:
+			return LR11XX_SIM_BOOT_US;
+		case SIM_OC_SET_TX:
+		case SIM_OC_SET_RX:
+		case SIM_OC_SET_FS:
+			return 100;
+		default:
+			return LR11XX_SIM_BUSY_US;
+	}
+}
+
+static void cancel_operation(lr11xx_sim_t* sim) {
+	sim->rx_timeout_us = 0;
+	sim->auto_chained = false;
+	sim->auto_tx_at_us = SIM_NEVER;
+	sim->auto_rx_at_us = SIM_NEVER;
+}
+
+static void start_tx(lr11xx_sim_t* sim) {
+	sim->mode = LR11XX_SIM_MODE_TX;
+	sim->tx_length = sim->lora_pkt.pld_len_in_bytes;
+	sim->tx_end_us = sim->now_us + lr11xx_sim_time_on_air_us(sim, sim->tx_length);
+	sim->stats.tx_packets++;
+
+	if(sim->config.on_tx) {
+		sim->config.on_tx(sim, sim->config.user);
+	}
+}
+
+static void start_rx(lr11xx_sim_t* sim, uint32_t timeout_rtc) {
+	sim->mode = LR11XX_SIM_MODE_RX;
+	sim->rx_continuous = timeout_rtc == SIM_RX_CONTINUOUS;
+	sim->rx_timeout_us = 0;
+
+	if(timeout_rtc != SIM_RX_SINGLE && timeout_rtc != SIM_RX_CONTINUOUS) {
+		sim->rx_timeout_us = sim->now_us + rtc_step_to_us(timeout_rtc);
+	}
+}
+
+static void on_tx_done(lr11xx_sim_t* sim) {
+	sim->irq_status |= LR11XX_SYSTEM_IRQ_TX_DONE;
+	sim->mode = sim->fallback_mode;
+
+	if(sim->auto_chained) {
+		sim->auto_chained = false;
+		sim->auto_rx_at_us = sim->tx_end_us + rtc_step_to_us(sim->auto_delay_rtc);
+	}
+}
+
+static void on_rx_timeout(lr11xx_sim_t* sim) {
+	sim->irq_status |= LR11XX_SYSTEM_IRQ_TIMEOUT;
+	sim->mode = sim->fallback_mode;
+	sim->rx_timeout_us = 0;
+	sim->auto_chained = false;
+	sim->stats.rx_timeouts++;
+}
+
+static lr11xx_system_chip_modes_t chip_mode(const lr11xx_sim_t* sim) {
+	switch(sim->mode) {
+		case LR11XX_SIM_MODE_SLEEP:
+			return LR11XX_SYSTEM_CHIP_MODE_SLEEP;
+		case LR11XX_SIM_MODE_FS:
+			return LR11XX_SYSTEM_CHIP_MODE_FS;
+		case LR11XX_SIM_MODE_TX:
+			return LR11XX_SYSTEM_CHIP_MODE_TX;
+		case LR11XX_SIM_MODE_RX:
+			return LR11XX_SYSTEM_CHIP_MODE_RX;
+		default:
+			return LR11XX_SYSTEM_CHIP_MODE_STBY_RC;
+	}
+}
+
+// --- PUBLIC METHODS ---
+
+void lr11xx_sim_init(lr11xx_sim_t* sim, const lr11xx_sim_config_t* config) {
+	lr11xx_sim_config_t saved = *config;
+
+	memset(sim, 0, sizeof(*sim));
+	sim->config = saved;
+	if(!sim->config.spi_hz) {
+		sim->config.spi_hz = LR11XX_SIM_SPI_HZ;
+	}
+
+	sim->mode = LR11XX_SIM_MODE_STANDBY;
+	sim->fallback_mode = LR11XX_SIM_MODE_STANDBY;
+	sim->pkt_type = LR11XX_RADIO_PKT_TYPE_LORA;
+	sim->lora_mod = (lr11xx_radio_mod_params_lora_t) {
+		.sf = LR11XX_RADIO_LORA_SF7,
+		.bw = LR11XX_RADIO_LORA_BW_125,
+		.cr = LR11XX_RADIO_LORA_CR_4_5,
+		.ldro = 0,
+	};
+	sim->lora_pkt = (lr11xx_radio_pkt_params_lora_t) {
+		.preamble_len_in_symb = 8,
+		.header_type = LR11XX_RADIO_LORA_PKT_EXPLICIT,
+		.pld_len_in_bytes = 0xFF,
+		.crc = LR11XX_RADIO_LORA_CRC_ON,
+		.iq = LR11XX_RADIO_LORA_IQ_STANDARD,
+	};
+	sim->rssi_dbm = SIM_NOISE_FLOOR_DBM;
+	cancel_operation(sim);
+}
+
+uint64_t lr11xx_sim_next_event_us(const lr11xx_sim_t* sim) {
+	uint64_t at = SIM_NEVER;
+
+	if(sim->mode == LR11XX_SIM_MODE_TX && sim->tx_end_us < at) {
+		at = sim->tx_end_us;
+	}
+	if(sim->mode == LR11XX_SIM_MODE_RX && sim->rx_timeout_us && sim->rx_timeout_us < at) {
+		at = sim->rx_timeout_us;
+	}
+	if(sim->auto_rx_at_us < at) {
+		at = sim->auto_rx_at_us;
+	}
+	if(sim->auto_tx_at_us < at) {
+		at = sim->auto_tx_at_us;
+	}
+	return at;
+}
+
+void lr11xx_sim_advance(lr11xx_sim_t* sim, uint64_t now_us) {
+	uint64_t at;
+
+	while((at = lr11xx_sim_next_event_us(sim)) <= now_us) {
+		if(at > sim->now_us) {
+			sim->now_us = at;
+		}
+
+		if(sim->mode == LR11XX_SIM_MODE_TX && sim->tx_end_us == at) {
+			on_tx_done(sim);
+		}
+		else if(sim->auto_rx_at_us == at) {
+			sim->auto_rx_at_us = SIM_NEVER;
+			start_rx(sim, sim->auto_timeout_rtc);
+		}
+		else if(sim->auto_tx_at_us == at) {
+			sim->auto_tx_at_us = SIM_NEVER;
+			start_tx(sim);
+		}
+		else {
+			on_rx_timeout(sim);
+		}
+	}
+
+	if(now_us > sim->now_us) {
+		sim->now_us = now_us;
+	}
+}
+
+bool lr11xx_sim_receive(lr11xx_sim_t* sim, const uint8_t* data, uint8_t length,
+		int8_t rssi_dbm, int8_t snr_db, uint32_t irq_flags) {
+	lr11xx_sim_advance(sim, sim->now_us);
+
+	if(sim->mode != LR11XX_SIM_MODE_RX) {
+		sim->stats.rx_missed++;
+		return false;
+	}
+
+	memcpy(sim->rx_buffer, data, length);
+	sim->rx_length = length;
+	sim->rssi_dbm = rssi_dbm;
+	sim->snr_db = snr_db;
+	// a bad header ends reception without RX_DONE
+	sim->irq_status |= irq_flags;
+	if(!(irq_flags & LR11XX_SYSTEM_IRQ_HEADER_ERROR)) {
+		sim->irq_status |= LR11XX_SYSTEM_IRQ_RX_DONE;
+	}
+	sim->stats.rx_packets++;
+
+	if(!sim->rx_continuous) {
+		sim->mode = sim->fallback_mode;
+		sim->rx_timeout_us = 0;
+
+		if(sim->auto_chained) {
+			sim->auto_chained = false;
+			if(!(irq_flags & (LR11XX_SYSTEM_IRQ_CRC_ERROR | LR11XX_SYSTEM_IRQ_HEADER_ERROR))) {
+				sim->auto_tx_at_us = sim->now_us + rtc_step_to_us(sim->auto_delay_rtc);
+			}
+		}
+	}
+	return true;
+}
+
+bool lr11xx_sim_dio_level(const lr11xx_sim_t* sim) {
+	return (sim->irq_status & sim->dio_mask) != 0;
+}
+
+bool lr11xx_sim_is_busy(const lr11xx_sim_t* sim) {
+	return sim->mode == LR11XX_SIM_MODE_SLEEP || sim->now_us < sim->busy_until_us;
+}
+
+uint32_t lr11xx_sim_time_on_air_us(const lr11xx_sim_t* sim, uint8_t length) {
+	lr11xx_radio_pkt_params_lora_t pkt_params = sim->lora_pkt;
+	uint64_t numerator;
+	uint32_t bw_in_hz = lr11xx_radio_get_lora_bw_in_hz(sim->lora_mod.bw);
+
+	if(!bw_in_hz) {
+		return 0;
+	}
+
+	pkt_params.pld_len_in_bytes = length;
+	numerator = 1000000ULL * lr11xx_radio_get_lora_time_on_air_numerator(&pkt_params, &sim->lora_mod);
+	return (numerator + bw_in_hz - 1) / bw_in_hz;
+}
+
+void lr11xx_sim_get_stats(const lr11xx_sim_t* sim, lr11xx_sim_stats_t* stats) {
+	*stats = sim->stats;
+}
+
+void lr11xx_sim_reset_stats(lr11xx_sim_t* sim) {
+	memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+void lr11xx_sim_command(lr11xx_sim_t* sim, const uint8_t* command, uint16_t command_length,
+		const uint8_t* data, uint16_t data_length) {
+	uint16_t opcode = ((uint16_t)command[0] << 8) | command[1];
+	const uint8_t* p = command + 2;
+	uint16_t p_length = command_length - 2;
+
+	switch(opcode) {
+		case SIM_OC_SET_STANDBY:
+			cancel_operation(sim);
+			sim->mode = LR11XX_SIM_MODE_STANDBY;
+			break;
+
+		case SIM_OC_SET_FS:
+			cancel_operation(sim);
+			sim->mode = LR11XX_SIM_MODE_FS;
+			break;
+
+		case SIM_OC_SET_SLEEP:
+			cancel_operation(sim);
+			sim->mode = LR11XX_SIM_MODE_SLEEP;
+			break;
+
+		case SIM_OC_REBOOT:
+			cancel_operation(sim);
+			sim->mode = LR11XX_SIM_MODE_STANDBY;
+			sim->irq_status = 0;
+			break;
+
+		case SIM_OC_SET_RX_TX_FALLBACK_MODE:
+			sim->fallback_mode = p_length >= 1 && p[0] == LR11XX_RADIO_FALLBACK_FS ?
+				LR11XX_SIM_MODE_FS : LR11XX_SIM_MODE_STANDBY;
+			break;
+
+		case SIM_OC_SET_DIO_IRQ_PARAMS:
+			if(p_length >= 4) {
+				sim->dio_mask = get_u32(p);
+			}
+			break;
+
+		case SIM_OC_CLEAR_IRQ:
+			if(p_length >= 4) {
+				sim->irq_status &= ~get_u32(p);
+			}
+			break;
+
+		case SIM_OC_SET_PKT_TYPE:
+			if(p_length >= 1) {
+				sim->pkt_type = p[0];
+			}
+			break;
+
+		case SIM_OC_SET_RF_FREQUENCY:
+			if(p_length >= 4) {
+				sim->rf_freq_in_hz = get_u32(p);
+			}
+			break;
+
+		case SIM_OC_SET_MODULATION_PARAM:
+			if(sim->pkt_type == LR11XX_RADIO_PKT_TYPE_LORA && p_length >= 4) {
+				sim->lora_mod.sf = p[0];
+				sim->lora_mod.bw = p[1];
+				sim->lora_mod.cr = p[2];
+				sim->lora_mod.ldro = p[3];
+			}
+			break;
+
+		case SIM_OC_SET_PKT_PARAM:
+			if(sim->pkt_type == LR11XX_RADIO_PKT_TYPE_LORA && p_length >= 6) {
+				sim->lora_pkt.preamble_len_in_symb = ((uint16_t)p[0] << 8) | p[1];
+				sim->lora_pkt.header_type = p[2];
+				sim->lora_pkt.pld_len_in_bytes = p[3];
+				sim->lora_pkt.crc = p[4];
+				sim->lora_pkt.iq = p[5];
+			}
+			break;
+
+		case SIM_OC_SET_LORA_SYNC_WORD:
+			if(p_length >= 1) {
+				sim->sync_word = p[0];
+			}
+			break;
+
+		case SIM_OC_WRITE_BUFFER8:
+			if(data_length) {
+				memcpy(sim->tx_buffer, data, data_length < LR11XX_SIM_BUFFER_SIZE ? data_length : LR11XX_SIM_BUFFER_SIZE);
+			}
+			break;
+
+		case SIM_OC_CLEAR_RXBUFFER:
+			memset(sim->rx_buffer, 0, sizeof(sim->rx_buffer));
+			sim->rx_length = 0;
+			break;
+
+		case SIM_OC_AUTO_TX_RX:
+			if(p_length >= 7) {
+				sim->auto_delay_rtc = get_u24(p);
+				sim->auto_timeout_rtc = get_u24(p + 4);
+				sim->auto_armed = sim->auto_delay_rtc != SIM_AUTO_TX_RX_DISABLED;
+			}
+			break;
+
+		case SIM_OC_SET_TX:
+			cancel_operation(sim);
+			sim->auto_chained = sim->auto_armed;
+			start_tx(sim);
+			break;
+
+		case SIM_OC_SET_RX:
+			cancel_operation(sim);
+			sim->auto_chained = sim->auto_armed;
+			start_rx(sim, p_length >= 3 ? get_u24(p) : SIM_RX_SINGLE);
+			break;
+
+		// accepted, nothing to model; GFSK settings included, only LoRa timing is simulated
+		case SIM_OC_RESET_STATS:
+		case SIM_OC_WRITE_REGMEM32:
+		case SIM_OC_WRITE_REGMEM32_MASK:
+		case SIM_OC_ENABLE_SPI_CRC:
+		case SIM_OC_SET_GFSK_SYNC_WORD:
+		case SIM_OC_SET_PKT_ADRS:
+		case SIM_OC_SET_GFSK_CRC_PARAMS:
+		case SIM_OC_SET_GFSK_WHITENING:
+		case SIM_OC_CLEAR_ERRORS:
+		case SIM_OC_CALIBRATE:
+		case SIM_OC_SET_REGMODE:
+		case SIM_OC_CALIBRATE_IMAGE:
+		case SIM_OC_SET_DIO_AS_RF_SWITCH:
+		case SIM_OC_CONFIG_LF_CLOCK:
+		case SIM_OC_SET_TCXO_MODE:
+		case SIM_OC_SET_TX_PARAMS:
+		case SIM_OC_SET_PA_CFG:
+		case SIM_OC_SET_RX_BOOSTED:
+		case SIM_OC_SET_RSSI_CALIBRATION:
+			break;
+
+		default:
+			sim->stats.unknown_opcodes++;
+			break;
+	}
+
+	sim->busy_until_us = sim->now_us + busy_us(opcode);
+}
+
+void lr11xx_sim_respond(lr11xx_sim_t* sim, const uint8_t* command, uint16_t command_length,
+		uint8_t* response, uint16_t response_length) {
+	uint16_t opcode = ((uint16_t)command[0] << 8) | command[1];
+	uint8_t r[8] = {0};
+
+	memset(response, 0, response_length);
+
+	switch(opcode) {
+		case SIM_OC_GET_VERSION:
+			r[0] = 0x22;
+			r[1] = LR11XX_SYSTEM_VERSION_TYPE_LR1121;
+			put_u16(&r[2], 0x0103);
+			break;
+
+		case SIM_OC_GET_PKT_TYPE:
+			r[0] = sim->pkt_type;
+			break;
+
+		case SIM_OC_GET_RXBUFFER_STATUS:
+			r[0] = sim->rx_length;
+			r[1] = 0;
+			break;
+
+		case SIM_OC_GET_PKT_STATUS:
+			r[0] = -2 * sim->rssi_dbm;
+			r[1] = 4 * sim->snr_db;
+			r[2] = -2 * sim->rssi_dbm;
+			break;
+
+		case SIM_OC_GET_RSSI_INST:
+			r[0] = -2 * (sim->mode == LR11XX_SIM_MODE_RX ? SIM_NOISE_FLOOR_DBM : 0);
+			break;
+
+		case SIM_OC_READ_BUFFER8:
+			if(command_length >= 4) {
+				uint16_t offset = command[2];
+
+				for(uint16_t i = 0; i < response_length; i++) {
+					response[i] = sim->rx_buffer[(offset + i) % LR11XX_SIM_BUFFER_SIZE];
+				}
+			}
+			sim->busy_until_us = sim->now_us + busy_us(opcode);
+			return;
+
+		case SIM_OC_GET_STATS:
+		case SIM_OC_GET_ERRORS:
+		case SIM_OC_READ_REGMEM32:
+			break;
+
+		default:
+			sim->stats.unknown_opcodes++;
+			break;
+	}
+
+	memcpy(response, r, response_length < sizeof(r) ? response_length : sizeof(r));
+	sim->busy_until_us = sim->now_us + busy_us(opcode);
+}
+
+void lr11xx_sim_status(const lr11xx_sim_t* sim, uint8_t* data, uint16_t data_length) {
+	uint8_t r[6] = {
+		(LR11XX_SYSTEM_CMD_STATUS_OK << 1) | (lr11xx_sim_dio_level(sim) ? 0x01 : 0x00),
+		chip_mode(sim) << 1,
+		sim->irq_status >> 24,
+		sim->irq_status >> 16,
+		sim->irq_status >> 8,
+		sim->irq_status,
+	};
+
+	memset(data, 0, data_length);
+	memcpy(data, r, data_length < sizeof(r) ? data_length : sizeof(r));
+}
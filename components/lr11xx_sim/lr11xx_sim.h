@@ -0,0 +1,168 @@
+#ifndef LR11XX_SIM_H
+#define LR11XX_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lr11xx_radio_types.h"
+
+/*
+ * simulated LR11XX for host (linux target) builds
+ *
+ * lr11xx_sim_hal.c implements lr11xx_hal.h in place of the esp_lora_1121
+ * component's lr11xx_hal.c, so the unmodified Semtech driver runs against this model. the
+ * driver's context pointer is the lr11xx_sim_t itself.
+ *
+ * time is virtual: every SPI transaction and BUSY wait advances sim->now_us,
+ * the harness advances it further with lr11xx_sim_advance() to account for
+ * time spent outside the radio. packets leave through the on_tx hook and come
+ * in through lr11xx_sim_receive(), see the lr11xx_channel component
+ */
+
+// SIM SETTINGS
+#define LR11XX_SIM_SPI_HZ		8000000		// matches ESP_SPI_CLK_HZ in stormwater_drone_lora.h
+#define LR11XX_SIM_CS_US		2		// CS setup/hold and driver overhead per transaction
+#define LR11XX_SIM_BUSY_US		20		// BUSY high after a plain command
+#define LR11XX_SIM_BOOT_US		273000		// BUSY high after reset, per datasheet
+#define LR11XX_SIM_BUFFER_SIZE		256
+
+typedef enum lr11xx_sim_mode_e {
+	LR11XX_SIM_MODE_SLEEP,
+	LR11XX_SIM_MODE_STANDBY,
+	LR11XX_SIM_MODE_FS,
+	LR11XX_SIM_MODE_TX,
+	LR11XX_SIM_MODE_RX,
+} lr11xx_sim_mode_t;
+
+typedef struct lr11xx_sim_stats_s {
+	uint32_t transactions;		// CS assertions: one per write, two per read
+	uint32_t writes;
+	uint32_t reads;
+	uint32_t spi_bytes;
+	uint64_t spi_us;
+	uint64_t busy_wait_us;		// time the host spent waiting on BUSY
+	uint32_t unknown_opcodes;
+	uint32_t tx_packets;
+	uint32_t rx_packets;
+	uint32_t rx_missed;		// delivered while not listening
+	uint32_t rx_timeouts;
+} lr11xx_sim_stats_t;
+
+typedef struct lr11xx_sim_s lr11xx_sim_t;
+
+/*!
+ * @brief called when a transmission starts, packet is in sim->tx_buffer,
+ * sim->tx_length bytes, on air until sim->tx_end_us
+ */
+typedef void (*lr11xx_sim_tx_hook_t)(lr11xx_sim_t* sim, void* user);
+
+typedef struct lr11xx_sim_config_s {
+	uint32_t spi_hz;
+	lr11xx_sim_tx_hook_t on_tx;
+	void* user;
+} lr11xx_sim_config_t;
+
+struct lr11xx_sim_s {
+	lr11xx_sim_config_t config;
+
+	// virtual time
+	uint64_t now_us;
+	uint64_t busy_until_us;
+
+	// radio settings as last written by the driver
+	lr11xx_sim_mode_t mode;
+	lr11xx_sim_mode_t fallback_mode;
+	lr11xx_radio_pkt_type_t pkt_type;
+	uint32_t rf_freq_in_hz;
+	lr11xx_radio_mod_params_lora_t lora_mod;
+	lr11xx_radio_pkt_params_lora_t lora_pkt;
+	uint8_t sync_word;
+
+	uint32_t irq_status;
+	uint32_t dio_mask;
+
+	uint8_t tx_buffer[LR11XX_SIM_BUFFER_SIZE];
+	uint8_t tx_length;
+	uint64_t tx_end_us;
+
+	uint8_t rx_buffer[LR11XX_SIM_BUFFER_SIZE];
+	uint8_t rx_length;
+	int8_t rssi_dbm;
+	int8_t snr_db;
+	bool rx_continuous;
+	uint64_t rx_timeout_us;		// 0 = no timeout
+
+	// auto tx/rx: a set_tx (set_rx) issued while armed chains an rx (tx) after the delay
+	bool auto_armed;
+	bool auto_chained;		// the current tx/rx was started while armed
+	uint32_t auto_delay_rtc;
+	uint32_t auto_timeout_rtc;
+	uint64_t auto_tx_at_us;		// UINT64_MAX = none pending
+	uint64_t auto_rx_at_us;
+
+	lr11xx_sim_stats_t stats;
+};
+
+/*!
+ * @brief power-on state: standby, LoRa, nothing pending, BUSY low
+ */
+void lr11xx_sim_init(lr11xx_sim_t* sim, const lr11xx_sim_config_t* config);
+
+/*!
+ * @brief move virtual time forward to now_us, completing transmissions,
+ * rx timeouts and auto tx/rx transitions due by then
+ */
+void lr11xx_sim_advance(lr11xx_sim_t* sim, uint64_t now_us);
+
+/*!
+ * @returns time of the next internal event, UINT64_MAX if none is pending
+ */
+uint64_t lr11xx_sim_next_event_us(const lr11xx_sim_t* sim);
+
+/*!
+ * @brief a packet finished arriving at the antenna at sim->now_us
+ *
+ * @param [in] irq_flags extra irq bits to raise with RX_DONE, e.g. CRC_ERROR;
+ * HEADER_ERROR is raised on its own
+ *
+ * @returns false if the radio was not listening and the packet was missed
+ */
+bool lr11xx_sim_receive(lr11xx_sim_t* sim, const uint8_t* data, uint8_t length,
+		int8_t rssi_dbm, int8_t snr_db, uint32_t irq_flags);
+
+/*!
+ * @returns level of the DIO9 irq line (any irq enabled by set_dio_irq_params pending)
+ */
+bool lr11xx_sim_dio_level(const lr11xx_sim_t* sim);
+
+bool lr11xx_sim_is_busy(const lr11xx_sim_t* sim);
+
+/*!
+ * @returns time on air for length bytes at the current LoRa settings
+ */
+uint32_t lr11xx_sim_time_on_air_us(const lr11xx_sim_t* sim, uint8_t length);
+
+void lr11xx_sim_get_stats(const lr11xx_sim_t* sim, lr11xx_sim_stats_t* stats);
+
+void lr11xx_sim_reset_stats(lr11xx_sim_t* sim);
+
+// used by lr11xx_sim_hal.c
+
+/*!
+ * @brief execute one command frame (opcode + parameters)
+ */
+void lr11xx_sim_command(lr11xx_sim_t* sim, const uint8_t* command, uint16_t command_length,
+		const uint8_t* data, uint16_t data_length);
+
+/*!
+ * @brief execute a read command and fill its response
+ */
+void lr11xx_sim_respond(lr11xx_sim_t* sim, const uint8_t* command, uint16_t command_length,
+		uint8_t* response, uint16_t response_length);
+
+/*!
+ * @returns stat1, stat2 and the big-endian irq status as returned by a direct read
+ */
+void lr11xx_sim_status(const lr11xx_sim_t* sim, uint8_t* data, uint16_t data_length);
+
+#endif
@@ -0,0 +1,114 @@
+#include "lr11xx_hal.h"
+#include "lr11xx_sim.h"
+
+/*
+ * lr11xx_hal.h on top of lr11xx_sim, mirrors the transaction pattern of the
+ * esp_lora_1121 component's lr11xx_hal.c so transaction counts and BUSY waits match
+ * the target. USE_LR11XX_CRC_OVER_SPI is not modelled
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define SIM_HAL_PIN_PULSE_US		10000	// vTaskDelay(10 ms) around reset and wakeup
+
+static void spi_transaction(lr11xx_sim_t* sim, uint32_t length) {
+	uint64_t us = LR11XX_SIM_CS_US + ((uint64_t)length * 8 * 1000000 + sim->config.spi_hz - 1) / sim->config.spi_hz;
+
+	sim->stats.transactions++;
+	sim->stats.spi_bytes += length;
+	sim->stats.spi_us += us;
+	lr11xx_sim_advance(sim, sim->now_us + us);
+}
+
+static lr11xx_hal_status_t wait_on_unbusy(lr11xx_sim_t* sim, uint32_t timeout_ms) {
+	// BUSY stays high while asleep, the target HAL times out the same way
+	if(sim->mode == LR11XX_SIM_MODE_SLEEP) {
+		sim->stats.busy_wait_us += (uint64_t)timeout_ms * 1000;
+		lr11xx_sim_advance(sim, sim->now_us + (uint64_t)timeout_ms * 1000);
+		return LR11XX_HAL_STATUS_ERROR;
+	}
+
+	if(sim->busy_until_us > sim->now_us) {
+		sim->stats.busy_wait_us += sim->busy_until_us - sim->now_us;
+		lr11xx_sim_advance(sim, sim->busy_until_us);
+	}
+	return LR11XX_HAL_STATUS_OK;
+}
+
+// --- PUBLIC METHODS ---
+
+lr11xx_hal_status_t lr11xx_hal_write(const void* context, const uint8_t* command, const uint16_t command_length,
+		const uint8_t* data, const uint16_t data_length) {
+	lr11xx_sim_t* sim = (lr11xx_sim_t*)context;
+
+	if(wait_on_unbusy(sim, 10000) != LR11XX_HAL_STATUS_OK) {
+		return LR11XX_HAL_STATUS_ERROR;
+	}
+
+	spi_transaction(sim, command_length + data_length);
+	sim->stats.writes++;
+	lr11xx_sim_command(sim, command, command_length, data, data_length);
+	return LR11XX_HAL_STATUS_OK;
+}
+
+lr11xx_hal_status_t lr11xx_hal_read(const void* context, const uint8_t* command, const uint16_t command_length,
+		uint8_t* data, const uint16_t data_length) {
+	lr11xx_sim_t* sim = (lr11xx_sim_t*)context;
+
+	if(wait_on_unbusy(sim, 10000) != LR11XX_HAL_STATUS_OK) {
+		return LR11XX_HAL_STATUS_ERROR;
+	}
+
+	spi_transaction(sim, command_length);
+	sim->stats.reads++;
+	lr11xx_sim_respond(sim, command, command_length, data, data_length);
+
+	if(wait_on_unbusy(sim, 1000) != LR11XX_HAL_STATUS_OK) {
+		return LR11XX_HAL_STATUS_ERROR;
+	}
+
+	// dummy status byte, then the response
+	spi_transaction(sim, 1 + data_length);
+	return LR11XX_HAL_STATUS_OK;
+}
+
+lr11xx_hal_status_t lr11xx_hal_direct_read(const void* context, uint8_t* data, const uint16_t data_length) {
+	lr11xx_sim_t* sim = (lr11xx_sim_t*)context;
+
+	if(wait_on_unbusy(sim, 10000) != LR11XX_HAL_STATUS_OK) {
+		return LR11XX_HAL_STATUS_ERROR;
+	}
+
+	spi_transaction(sim, data_length);
+	sim->stats.reads++;
+	lr11xx_sim_status(sim, data, data_length);
+	return LR11XX_HAL_STATUS_OK;
+}
+
+lr11xx_hal_status_t lr11xx_hal_reset(const void* context) {
+	lr11xx_sim_t* sim = (lr11xx_sim_t*)context;
+	lr11xx_sim_stats_t stats = sim->stats;
+	uint64_t now_us = sim->now_us + SIM_HAL_PIN_PULSE_US;
+
+	lr11xx_sim_init(sim, &sim->config);
+	sim->stats = stats;
+	sim->now_us = now_us;
+	sim->busy_until_us = now_us + LR11XX_SIM_BOOT_US;
+	return LR11XX_HAL_STATUS_OK;
+}
+
+lr11xx_hal_status_t lr11xx_hal_wakeup(const void* context) {
+	lr11xx_sim_t* sim = (lr11xx_sim_t*)context;
+
+	lr11xx_sim_advance(sim, sim->now_us + SIM_HAL_PIN_PULSE_US);
+	if(sim->mode == LR11XX_SIM_MODE_SLEEP) {
+		sim->mode = LR11XX_SIM_MODE_STANDBY;
+		sim->busy_until_us = sim->now_us + LR11XX_SIM_BUSY_US;
+	}
+	return LR11XX_HAL_STATUS_OK;
+}
+
+lr11xx_hal_status_t lr11xx_hal_abort_blocking_cmd(const void* context) {
+	(void)context;
+	return LR11XX_HAL_STATUS_OK;
+}
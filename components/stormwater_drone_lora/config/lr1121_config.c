@@ -37,6 +37,19 @@
 
 lr1121_t lr1121;
 
+// Parameters currently programmed in the radio
+static lora_radio_config_t radio_config = {
+    .pkt_type      = PACKET_TYPE,
+    .rf_freq_in_hz = RF_FREQ_IN_HZ,
+    .tx_power_dbm  = TX_OUTPUT_POWER_DBM,
+    .sf            = LORA_SPREADING_FACTOR,
+    .bw            = LORA_BANDWIDTH,
+    .cr            = LORA_CODING_RATE,
+    .preamble_len  = LORA_PREAMBLE_LENGTH,
+    .sync_word     = LORA_SYNCWORD,
+    .payload_len   = PAYLOAD_LENGTH,
+};
+
 // LoRa modulation parameters
 static lr11xx_radio_mod_params_lora_t lora_mod_params = {
   .sf   = LORA_SPREADING_FACTOR,  // Spreading factor
@@ -46,7 +59,7 @@ static lr11xx_radio_mod_params_lora_t lora_mod_params = {
 };
 
 // LoRa packet parameters
-static const lr11xx_radio_pkt_params_lora_t lora_pkt_params = {
+static lr11xx_radio_pkt_params_lora_t lora_pkt_params = {
   .preamble_len_in_symb = LORA_PREAMBLE_LENGTH,  // Preamble length in symbols
   .header_type          = LORA_PKT_LEN_MODE,     // Header type (implicit or explicit)
   .pld_len_in_bytes     = PAYLOAD_LENGTH,        // Payload length in bytes
@@ -63,7 +76,7 @@ static const lr11xx_radio_mod_params_gfsk_t gfsk_mod_params = {
 };
 
 // GFSK packet parameters
-static const lr11xx_radio_pkt_params_gfsk_t gfsk_pkt_params = {
+static lr11xx_radio_pkt_params_gfsk_t gfsk_pkt_params = {
     .preamble_len_in_bits  = FSK_PREAMBLE_LENGTH,  // Preamble length in bits
     .preamble_detector     = FSK_PREAMBLE_DETECTOR, // Preamble detector type
     .sync_word_len_in_bits = FSK_SYNCWORD_LENGTH,   // Sync word length in bits
@@ -369,11 +382,234 @@ void print_gfsk_configuration( void )
     printf( "\n" );
 }
 
+// Change spreading factor, bandwidth and TX power without a full radio init
+void lora_radio_set_rate( const void* context, const lr11xx_radio_lora_sf_t sf, const lr11xx_radio_lora_bw_t bw,
+                          const int8_t power_dbm )
+{
+    const smtc_shield_lr11xx_pa_pwr_cfg_t* pa_pwr_cfg =
+        smtc_shield_lr1121mb1gis_get_pa_pwr_cfg( radio_config.rf_freq_in_hz, power_dbm );
+
+    if( pa_pwr_cfg != NULL )
+    {
+        lr11xx_radio_set_pa_cfg( context, &( pa_pwr_cfg->pa_config ) );
+        lr11xx_radio_set_tx_params( context, pa_pwr_cfg->power, PA_RAMP_TIME );
+        radio_config.tx_power_dbm = power_dbm;
+    }
+
+    if( radio_config.pkt_type == LR11XX_RADIO_PKT_TYPE_LORA )
+    {
+        radio_config.sf      = sf;
+        radio_config.bw      = bw;
+        lora_mod_params.sf   = sf;
+        lora_mod_params.bw   = bw;
+        lora_mod_params.ldro = smtc_shield_lr11xx_common_compute_lora_ldro( sf, bw );
+        lr11xx_radio_set_lora_mod_params( context, &lora_mod_params );
+    }
+}
+
+// Change the payload length used for the next TX
+void lora_radio_set_payload_length( const void* context, const uint8_t payload_len )
+{
+    lora_pkt_params.pld_len_in_bytes = payload_len;
+    gfsk_pkt_params.pld_len_in_bytes = payload_len;
+
+    if( radio_config.pkt_type == LR11XX_RADIO_PKT_TYPE_LORA )
+    {
+        lr11xx_radio_set_lora_pkt_params( context, &lora_pkt_params );
+    }
+    else if( radio_config.pkt_type == LR11XX_RADIO_PKT_TYPE_GFSK )
+    {
+        lr11xx_radio_set_gfsk_pkt_params( context, &gfsk_pkt_params );
+    }
+}
+
+// Copy out the parameters currently programmed in the radio
+void lora_radio_get_config( lora_radio_config_t* config )
+{
+    *config = radio_config;
+}
+
+// Check a configuration can be applied (supported modem, PA table entry, payload length)
+bool lora_radio_config_is_valid( const lora_radio_config_t* config )
+{
+    if( config->pkt_type != LR11XX_RADIO_PKT_TYPE_LORA && config->pkt_type != LR11XX_RADIO_PKT_TYPE_GFSK )
+    {
+        return false;
+    }
+    if( config->payload_len == 0 )
+    {
+        return false;
+    }
+    if( config->pkt_type == LR11XX_RADIO_PKT_TYPE_LORA &&
+        ( config->sf < LR11XX_RADIO_LORA_SF5 || config->sf > LR11XX_RADIO_LORA_SF12 ) )
+    {
+        return false;
+    }
+    return smtc_shield_lr1121mb1gis_get_pa_pwr_cfg( config->rf_freq_in_hz, config->tx_power_dbm ) != NULL;
+}
+
+/*
+ * Apply a new configuration, sending only the commands whose parameters changed.
+ * The radio must be in standby. payload_len is only recorded as the default length,
+ * the length of each packet is set with lora_radio_set_payload_length.
+ * Returns the number of commands sent over SPI.
+ */
+uint8_t lora_radio_reconfigure( const void* context, const lora_radio_config_t* config )
+{
+    uint8_t commands = 0;
+
+    // Changing the packet type resets the modem, so everything below is resent
+    const bool pkt_type_changed = config->pkt_type != radio_config.pkt_type;
+    const bool freq_changed     = config->rf_freq_in_hz != radio_config.rf_freq_in_hz;
+    const bool lora             = config->pkt_type == LR11XX_RADIO_PKT_TYPE_LORA;
+
+    if( pkt_type_changed )
+    {
+        lr11xx_radio_set_pkt_type( context, config->pkt_type );
+        commands++;
+    }
+
+    if( freq_changed )
+    {
+        const uint16_t freq_in_mhz = config->rf_freq_in_hz / 1000000;
+
+        lr11xx_system_calibrate_image_in_mhz( context, freq_in_mhz, freq_in_mhz );
+        lr11xx_radio_set_rf_freq( context, config->rf_freq_in_hz );
+        lr11xx_radio_set_rssi_calibration( context,
+                                           smtc_shield_lr11xx_get_rssi_calibration_table( config->rf_freq_in_hz ) );
+        commands += 3;
+    }
+
+    // The PA configuration depends on both frequency and power
+    if( freq_changed || config->tx_power_dbm != radio_config.tx_power_dbm )
+    {
+        const smtc_shield_lr11xx_pa_pwr_cfg_t* pa_pwr_cfg =
+            smtc_shield_lr1121mb1gis_get_pa_pwr_cfg( config->rf_freq_in_hz, config->tx_power_dbm );
+
+        lr11xx_radio_set_pa_cfg( context, &( pa_pwr_cfg->pa_config ) );
+        lr11xx_radio_set_tx_params( context, pa_pwr_cfg->power, PA_RAMP_TIME );
+        commands += 2;
+    }
+
+    lora_mod_params.sf   = config->sf;
+    lora_mod_params.bw   = config->bw;
+    lora_mod_params.cr   = config->cr;
+    lora_mod_params.ldro = smtc_shield_lr11xx_common_compute_lora_ldro( config->sf, config->bw );
+    lora_pkt_params.preamble_len_in_symb = config->preamble_len;
+
+    if( lora )
+    {
+        if( pkt_type_changed || config->sf != radio_config.sf || config->bw != radio_config.bw ||
+            config->cr != radio_config.cr )
+        {
+            lr11xx_radio_set_lora_mod_params( context, &lora_mod_params );
+            commands++;
+        }
+        if( pkt_type_changed || config->preamble_len != radio_config.preamble_len )
+        {
+            lr11xx_radio_set_lora_pkt_params( context, &lora_pkt_params );
+            commands++;
+        }
+        if( pkt_type_changed || config->sync_word != radio_config.sync_word )
+        {
+            lr11xx_radio_set_lora_sync_word( context, config->sync_word );
+            commands++;
+        }
+    }
+    else
+    {
+        if( pkt_type_changed )
+        {
+            lr11xx_radio_set_gfsk_mod_params( context, &gfsk_mod_params );
+            lr11xx_radio_set_gfsk_pkt_params( context, &gfsk_pkt_params );
+            lr11xx_radio_set_gfsk_sync_word( context, gfsk_sync_word );
+            commands += 3;
+
+            if( FSK_DC_FREE != LR11XX_RADIO_GFSK_DC_FREE_OFF )
+            {
+                lr11xx_radio_set_gfsk_whitening_seed( context, FSK_WHITENING_SEED );
+                commands++;
+            }
+            if( FSK_CRC_TYPE != LR11XX_RADIO_GFSK_CRC_OFF )
+            {
+                lr11xx_radio_set_gfsk_crc_params( context, FSK_CRC_SEED, FSK_CRC_POLYNOMIAL );
+                commands++;
+            }
+            if( FSK_ADDRESS_FILTERING != LR11XX_RADIO_GFSK_ADDRESS_FILTERING_DISABLE )
+            {
+                lr11xx_radio_set_pkt_address( context, FSK_NODE_ADDRESS, FSK_BROADCAST_ADDRESS );
+                commands++;
+            }
+        }
+    }
+
+    radio_config = *config;
+    return commands;
+}
+
+// Calculate the time on air for a packet of the given payload length
+uint32_t get_time_on_air_in_ms_for_length( const uint8_t payload_len )
+{
+    switch( radio_config.pkt_type )
+    {
+      case LR11XX_RADIO_PKT_TYPE_LORA:
+      {
+          lr11xx_radio_pkt_params_lora_t pkt_params = lora_pkt_params;
+          pkt_params.pld_len_in_bytes = payload_len;
+          return lr11xx_radio_get_lora_time_on_air_in_ms( &pkt_params, &lora_mod_params );
+      }
+      case LR11XX_RADIO_PKT_TYPE_GFSK:
+      {
+          lr11xx_radio_pkt_params_gfsk_t pkt_params = gfsk_pkt_params;
+          pkt_params.pld_len_in_bytes = payload_len;
+          return lr11xx_radio_get_gfsk_time_on_air_in_ms( &pkt_params, &gfsk_mod_params );
+      }
+      default:
+      {
+          return 0;
+      }
+    }
+}
+
+// Calculate the time on air in microseconds for a packet of the given payload length
+uint32_t get_time_on_air_in_us_for_length( const uint8_t payload_len )
+{
+    uint64_t numerator;
+    uint32_t denominator;
+
+    switch( radio_config.pkt_type )
+    {
+      case LR11XX_RADIO_PKT_TYPE_LORA:
+      {
+          lr11xx_radio_pkt_params_lora_t pkt_params = lora_pkt_params;
+          pkt_params.pld_len_in_bytes = payload_len;
+          numerator   = 1000000ULL * lr11xx_radio_get_lora_time_on_air_numerator( &pkt_params, &lora_mod_params );
+          denominator = lr11xx_radio_get_lora_bw_in_hz( lora_mod_params.bw );
+          break;
+      }
+      case LR11XX_RADIO_PKT_TYPE_GFSK:
+      {
+          lr11xx_radio_pkt_params_gfsk_t pkt_params = gfsk_pkt_params;
+          pkt_params.pld_len_in_bytes = payload_len;
+          numerator   = 1000000ULL * lr11xx_radio_get_gfsk_time_on_air_numerator( &pkt_params );
+          denominator = gfsk_mod_params.br_in_bps;
+          break;
+      }
+      default:
+      {
+          return 0;
+      }
+    }
+
+    // Perform integral ceil()
+    return ( uint32_t ) ( ( numerator + denominator - 1 ) / denominator );
+}
+
 // Calculate the time on air for the configured packet
 uint32_t get_time_on_air_in_ms( void )
 {
     // Determine the time on air based on the packet type
-    switch( PACKET_TYPE )
+    switch( radio_config.pkt_type )
     {
       case LR11XX_RADIO_PKT_TYPE_LORA:
       {
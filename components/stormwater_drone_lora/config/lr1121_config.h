@@ -202,11 +202,40 @@ static const uint8_t gfsk_sync_word[8] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0
 #error "Select a valid Radio Configuration"
 #endif
 
+/*!
+ * @brief Radio parameters that can be changed at runtime with lora_radio_reconfigure
+ *
+ * Defaults come from the macros above. sf, bw, cr, preamble_len and sync_word only
+ * apply to LoRa packets, payload_len is the default length of sent packets.
+ */
+typedef struct lora_radio_config_s
+{
+    lr11xx_radio_pkt_type_t pkt_type;
+    uint32_t                rf_freq_in_hz;
+    int8_t                  tx_power_dbm;
+    lr11xx_radio_lora_sf_t  sf;
+    lr11xx_radio_lora_bw_t  bw;
+    lr11xx_radio_lora_cr_t  cr;
+    uint16_t                preamble_len;
+    uint8_t                 sync_word;
+    uint8_t                 payload_len;
+} lora_radio_config_t;
+
 extern lr1121_t lr1121;
 
 void lora_system_init( const void* context );
 void lora_radio_init( const void* context );
 void lora_radio_dbpsk_init( const void* context, const uint8_t payload_len );
 
+void lora_radio_set_rate( const void* context, const lr11xx_radio_lora_sf_t sf, const lr11xx_radio_lora_bw_t bw,
+                          const int8_t power_dbm );
+void lora_radio_set_payload_length( const void* context, const uint8_t payload_len );
+
+void lora_radio_get_config( lora_radio_config_t* config );
+bool lora_radio_config_is_valid( const lora_radio_config_t* config );
+uint8_t lora_radio_reconfigure( const void* context, const lora_radio_config_t* config );
+
 uint32_t get_time_on_air_in_ms( void );
+uint32_t get_time_on_air_in_ms_for_length( const uint8_t payload_len );
+uint32_t get_time_on_air_in_us_for_length( const uint8_t payload_len );
 #endif
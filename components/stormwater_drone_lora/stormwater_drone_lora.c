@@ -3,25 +3,298 @@
 
 #include "driver/spi_common.h"
 #include "driver/spi_master.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/idf_additions.h"
 #include "portmacro.h"
+#include <string.h>
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#endif
 
 #include "lr1121_config.h"
 #include "lr11xx_radio.h"
 #include "lr11xx_regmem.h"
 #include "lr11xx_system_types.h"
+#include "stormwater_drone_lora_adr.h"
+#include "stormwater_drone_lora_arq.h"
+#include "stormwater_drone_lora_spsc.h"
+#include "stormwater_drone_lora_tdma.h"
+#include "stormwater_frame.h"
 
 // --- PRIVATE DEFS AND METHODS ---
 
+// task notification bits for the radio task
+#define LORA_NOTIFY_IRQ		(1 << 0)
+#define LORA_NOTIFY_REPLY	(1 << 1)
+#define LORA_NOTIFY_ADR_FALLBACK	(1 << 2)
+#define LORA_NOTIFY_RECONFIGURE	(1 << 3)
+#define LORA_NOTIFY_PRELOAD	(1 << 4)
+#define LORA_NOTIFY_CAD		(1 << 5)
+#define LORA_NOTIFY_LBT		(1 << 6)
+#define LORA_NOTIFY_REPLY_DELAY	(1 << 7)
+
+#define LORA_RTC_FREQ_IN_HZ	32768
+
+#if TDMA_ENABLED && LORA_LINK_MODE != LORA_LINK_MODE_SOFTWARE
+#error "TDMA slots are timed by the radio task, use LORA_LINK_MODE_SOFTWARE"
+#endif
+#if (CAD_LISTEN_ENABLED || CAD_LBT_ENABLED) && LORA_LINK_MODE != LORA_LINK_MODE_SOFTWARE
+#error "the sequencer does not run cad, use LORA_LINK_MODE_SOFTWARE"
+#endif
+#if RX_DUTY_CYCLE_ENABLED && (CAD_LISTEN_ENABLED || LORA_LINK_MODE != LORA_LINK_MODE_SOFTWARE)
+#error "RX_DUTY_CYCLE replaces CAD_LISTEN and needs LORA_LINK_MODE_SOFTWARE"
+#endif
+
+// drone light sleeps while the radio duty cycles; DIO wakes it by level
+#if CONFIG_PM_ENABLE && RX_DUTY_CYCLE_ENABLED && !IS_HOST
+#define LORA_LIGHT_SLEEP	1
+#else
+#define LORA_LIGHT_SLEEP	0
+#endif
+
+#if (LORA_RX_POOL_SIZE & (LORA_RX_POOL_SIZE - 1)) || (LORA_WORK_QUEUE_LENGTH & (LORA_WORK_QUEUE_LENGTH - 1)) || \
+		(LORA_TX_QUEUE_LENGTH & (LORA_TX_QUEUE_LENGTH - 1))
+#error "LORA_RX_POOL_SIZE, LORA_WORK_QUEUE_LENGTH and LORA_TX_QUEUE_LENGTH size spsc rings, use powers of two"
+#endif
+
+#if LORA_RX_POOL_SIZE > 32
+#error "free rx pool slots are a 32 bit mask"
+#endif
+
+#if TDMA_ENABLED && ARQ_ENABLED
+#error "ARQ tracks a single peer, disable it for TDMA"
+#endif
+
+// the drone's auto reply leaves before it reads the request, so that request
+// cannot ack it yet
+#define ARQ_ACK_COVERS_LAST_TX	(IS_HOST || LORA_LINK_MODE == LORA_LINK_MODE_SOFTWARE)
+
+/*!
+ * @brief work the radio task hands to the work task; frames go ahead of log events
+ */
+typedef enum lora_work_type_e {
+	LORA_WORK_DELIVER,
+	LORA_WORK_EVENT,
+} lora_work_type_t;
+
+typedef struct lora_work_s {
+	uint8_t type;
+	uint8_t event;		// stormwater_drone_lora_event_t
+	uint16_t arg;		// OVERSIZE: payload length, RECONFIGURED: commands sent
+	uint32_t value;		// RECONFIGURED: time on air
+	stormwater_drone_lora_rx_frame_t* frame;
+} lora_work_t;
+
+/*!
+ * @brief frame queued by stormwater_drone_lora_submit for the radio task
+ */
+typedef struct lora_submit_s {
+	uint8_t length;
+	uint8_t frame[LORA_MAX_FRAME_LENGTH];
+} lora_submit_t;
+
+static const char* TAG = "StormwaterDroneLora";
+
 static spi_device_handle_t stormwater_drone_spi_handle = NULL;
+static TaskHandle_t lora_task_handle = NULL;
+static esp_timer_handle_t reply_timer = NULL;
+static uint32_t reply_delay_ms = IS_HOST ? ITERATION_DELAY : REPLY_TURNAROUND_DELAY;
+// longest the peer takes to answer us, sizes the rx window after each tx
+static uint32_t peer_reply_delay_ms = PEER_REPLY_DELAY;
+// set by the app, taken by the radio task on LORA_NOTIFY_REPLY_DELAY
+static uint32_t reply_delay_pending_ms = IS_HOST ? ITERATION_DELAY : REPLY_TURNAROUND_DELAY;
+static uint32_t peer_reply_delay_pending_ms = PEER_REPLY_DELAY;
+
+// own address, used by a drone to find its tdma slot
+static uint8_t node_address = STORMWATER_FRAME_ADDR_BROADCAST;
+
+// ctrlr: end of the current superframe's uplink slots
+static int64_t tdma_window_end_us = 0;
+static uint8_t tdma_beacon_seq = 0;
+
+/*
+ * the radio task takes no lock on the packet path: frames come in through
+ * submit_ring, pool slots through rx_free_mask and work goes out through the work
+ * rings. only a reconfigure, off that path, reads a queue
+ */
+
+// frames submitted by the app, app -> radio task. arq moves them into its window;
+// without arq each is sent once in turn and the last one repeats while none is queued
+static lora_submit_t submit_items[LORA_TX_QUEUE_LENGTH];
+static stormwater_drone_lora_spsc_t submit_ring;
+static lora_submit_t submit_buffer;	// app, filled through stormwater_drone_lora_send_buffer
+
+// latest config requested by stormwater_drone_lora_reconfigure, applied by the radio task
+static QueueHandle_t reconfigure_queue = NULL;
+
+// rx frame pool: bit n of rx_free_mask set while rx_pool[n] is free. only the radio
+// task clears bits, any task sets them; frames waiting for the app pass by pointer
+static stormwater_drone_lora_rx_frame_t rx_pool[LORA_RX_POOL_SIZE];
+static uint32_t rx_free_mask = 0;
+static QueueHandle_t rx_frame_queue = NULL;
+static stormwater_drone_lora_rx_stats_t rx_stats = { 0 };
+
+// packets received while every pool slot is taken, read for the link fields only
+static stormwater_drone_lora_rx_frame_t rx_scratch;
+
+// deferred work, radio task -> work task: high carries frames, low carries events
+static TaskHandle_t work_task_handle = NULL;
+static lora_work_t work_high_items[LORA_RX_POOL_SIZE];
+static lora_work_t work_low_items[LORA_WORK_QUEUE_LENGTH];
+static stormwater_drone_lora_spsc_t work_high;
+static stormwater_drone_lora_spsc_t work_low;
+static stormwater_drone_lora_work_stats_t work_stats = { 0 };
+static stormwater_drone_lora_callbacks_t callbacks = { 0 };
+
+// values the app copies out that span several words (rate, irq latency, link
+// timing): the radio task writes them under this lock and the getters copy under
+// it. the counter sets are single words each and go without
+static portMUX_TYPE snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static stormwater_drone_lora_link_stats_t link_stats = { 0 };
+
+// link quality bookkeeping
+static int64_t tx_start_us = 0;		// host: last tx start, 0 once its reply is timed
+static uint32_t arq_retransmitted = 0;	// arq counter at the last tx done
+static uint8_t radio_stats_countdown = LINK_STATS_RADIO_POLL;
+
+// stormwater_drone_lora_send producers
+static SemaphoreHandle_t send_lock = NULL;
+
+// link quality of the last received packet
+static int8_t last_rssi_dbm = 0;
+static int8_t last_snr_db = 0;
+
+// adr: host proposes, drone applies after replying, both revert on silence
+static stormwater_drone_lora_rate_t default_rate = { LORA_SPREADING_FACTOR, LORA_BANDWIDTH, TX_OUTPUT_POWER_DBM };
+static stormwater_drone_lora_rate_t current_rate = { LORA_SPREADING_FACTOR, LORA_BANDWIDTH, TX_OUTPUT_POWER_DBM };
+static stormwater_drone_lora_rate_t adr_pending_rate;
+static uint8_t adr_pending_id = 0;	// host: request in flight, drone: switch after tx done
+static uint8_t adr_last_id = 0;		// host: last id issued, drone: last id applied
+static esp_timer_handle_t adr_fallback_timer = NULL;
+
+// cad: drone sniff timer, ctrlr listen-before-talk backoff
+static esp_timer_handle_t cad_timer = NULL;
+static esp_timer_handle_t lbt_timer = NULL;
+static bool cad_sniffing = false;	// drone: in standby between sniffs
+static uint8_t lbt_attempts = 0;
+static uint32_t lbt_timeout_ms = 0;
+static stormwater_drone_lora_cad_stats_t cad_stats = { 0 };
+
+// cad symbols and detection peak per sf (SF5..SF12), Semtech's starting points
+static const uint8_t cad_symbols_by_sf[] = { 2, 2, 2, 2, 4, 4, 4, 4 };
+static const uint8_t cad_detect_peak_by_sf[] = { 22, 22, 22, 22, 23, 24, 25, 28 };
+#define CAD_DETECT_MIN		10
+
+#if LORA_LIGHT_SLEEP
+// held through init, then by the radio task while it works; BUSY edges and SPI do
+// not survive light sleep
+static esp_pm_lock_handle_t radio_pm_lock = NULL;
+#endif
+
+// irq edge timestamp, written by isr and taken by the radio task; 64 bits do not
+// load or store in one go on the esp32, so both sides hold the lock
+static portMUX_TYPE irq_edge_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t irq_edge_time_us = 0;
+// time of the irq being handled: its edge, or when a still raised DIO was seen
+static int64_t irq_time_us = 0;
+static stormwater_drone_lora_irq_latency_t irq_latency = { 0 };
+static uint64_t irq_latency_sum_us = 0;
 
 static void IRAM_ATTR isr(void* arg) {
-	stormwater_drone_lora_irq_flag = true;
+	BaseType_t woken = pdFALSE;
+
+	if(lora_task_handle == NULL) {
+		return;
+	}
+	portENTER_CRITICAL_ISR(&irq_edge_lock);
+	irq_edge_time_us = esp_timer_get_time();
+	portEXIT_CRITICAL_ISR(&irq_edge_lock);
+#if LORA_LIGHT_SLEEP
+	// level triggered for the sleep wakeup, the radio task re-enables it
+	gpio_intr_disable(ESP_INT);
+#endif
+	xTaskNotifyFromISR(lora_task_handle, LORA_NOTIFY_IRQ, eSetBits, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+
+static void reply_timer_callback(void* arg) {
+	xTaskNotify(lora_task_handle, LORA_NOTIFY_REPLY, eSetBits);
+}
+
+static void adr_fallback_timer_callback(void* arg) {
+	xTaskNotify(lora_task_handle, LORA_NOTIFY_ADR_FALLBACK, eSetBits);
+}
+
+static void cad_timer_callback(void* arg) {
+	xTaskNotify(lora_task_handle, LORA_NOTIFY_CAD, eSetBits);
+}
+
+static void lbt_timer_callback(void* arg) {
+	xTaskNotify(lora_task_handle, LORA_NOTIFY_LBT, eSetBits);
+}
+
+static bool work_post(stormwater_drone_lora_spsc_t* ring, const lora_work_t* work) {
+	uint8_t depth;
+
+	if(!stormwater_drone_lora_spsc_push(ring, work)) {
+		work_stats.dropped++;
+		return false;
+	}
+	work_stats.posted++;
+	depth = (uint8_t)(stormwater_drone_lora_spsc_count(&work_high) + stormwater_drone_lora_spsc_count(&work_low));
+	if(depth > work_stats.depth_max) {
+		work_stats.depth_max = depth;
+	}
+	xTaskNotifyGive(work_task_handle);
+	return true;
 }
 
-uint8_t stormwater_drone_lora_send_packet[PAYLOAD_LENGTH];
-uint8_t stormwater_drone_lora_receive_packet[PAYLOAD_LENGTH];
-bool stormwater_drone_lora_irq_flag = false;
+static void post_event(stormwater_drone_lora_event_t event, uint16_t arg, uint32_t value) {
+	lora_work_t work = { .type = LORA_WORK_EVENT, .event = event, .arg = arg, .value = value };
+
+	work_post(&work_low, &work);
+}
+
+// radio task, no arq: the frame last sent, and whether the packet last built is the
+// front of submit_ring, which is popped once it has gone out
+static lora_submit_t tx_current;
+static bool tx_from_ring = false;
+
+/*
+ * copy of the radio tx buffer: link header (arq) + send frame with link-layer fields
+ * (adr) filled in. rx does not clobber the tx buffer, a loaded reply survives any
+ * number of receptions: AUTO_TXRX relies on it (the reply is armed before the request
+ * comes in) and so does the preloaded reply. the only places it is not trusted clear
+ * tx_loaded_length: a reconfigure, which may reset the modem, and RX_DUTY_CYCLE, whose
+ * sleep phases do not keep it
+ */
+static uint8_t tx_packet[LORA_MAX_PAYLOAD_LENGTH];
+static uint8_t tx_loaded_length = 0;	// 0 = radio buffer contents unknown
+
+// drone: in rx, waiting for a request, so the reply may be restaged
+static bool listening = false;
+
+// payload length currently programmed in the radio packet params
+static uint8_t radio_payload_length = PAYLOAD_LENGTH;
+
+// length sent while nothing has been submitted
+static uint8_t default_payload_length = PAYLOAD_LENGTH;
+
+// radio task's table, and the copy it publishes for the app under snapshot_lock
+static stormwater_drone_lora_link_timing_t link_timing;
+static stormwater_drone_lora_link_timing_t link_timing_snapshot;
+
+// radio task: the modem in use is LoRa. adr, cad and rx duty cycling drive LoRa
+// parameters and sit out while a reconfigure has it on GFSK
+static bool modem_lora = PACKET_TYPE == LR11XX_RADIO_PKT_TYPE_LORA;
 
 static void stormwater_drone_spi_init(void) {
 	spi_bus_config_t stormwater_drone_spi_config = {
@@ -30,13 +303,17 @@ static void stormwater_drone_spi_init(void) {
 		.sclk_io_num = ESP_CLK,
 		.quadwp_io_num = -1,
 		.quadhd_io_num = -1,
-		.max_transfer_sz = 64,
+		.max_transfer_sz = LORA_SPI_BUFFER_SIZE,	// one coalesced HAL transaction
 	};
 
 	spi_device_interface_config_t stormwater_drone_spi_device_config = {
 		.clock_speed_hz = ESP_SPI_CLK_HZ,
 		.mode = 0,
+#if defined(USE_LR11XX_SPI_HW_CS)
+		.spics_io_num = ESP_CS,
+#else
 		.spics_io_num = -1,
+#endif
 		.queue_size = 1,
 	};
 
@@ -45,23 +322,544 @@ static void stormwater_drone_spi_init(void) {
 	spi_bus_add_device(ESP_SPI_HOST, &stormwater_drone_spi_device_config, &stormwater_drone_spi_handle);
 }
 
-static void reception_failure(void) {
+static uint32_t us_to_rtc_step(uint32_t time_us) {
+	return (uint32_t)(((uint64_t)time_us * LORA_RTC_FREQ_IN_HZ + 999999) / 1000000);
+}
+
+static void cad_configure(lr11xx_radio_cad_exit_mode_t exit_mode, uint32_t timeout_rtc) {
+	const uint8_t sf_index = current_rate.sf - LR11XX_RADIO_LORA_SF5;
+	const lr11xx_radio_cad_params_t params = {
+		.cad_symb_nb = cad_symbols_by_sf[sf_index],
+		.cad_detect_peak = cad_detect_peak_by_sf[sf_index],
+		.cad_detect_min = CAD_DETECT_MIN,
+		.cad_exit_mode = exit_mode,
+		.cad_timeout = timeout_rtc,
+	};
+
+	lr11xx_radio_set_cad_params(&lr1121, &params);
+}
+
+/*
+ * both ends send a preamble a listening drone cannot miss: for CAD_LISTEN a whole
+ * sniff period plus the cad itself, for RX_DUTY_CYCLE a sleep period plus the rx
+ * window, which the radio doubles once it detects a preamble
+ */
+static void wake_preamble_update(void) {
+	lora_radio_config_t config;
+	uint32_t symbol_us;
+	uint32_t preamble;
+
+	lora_radio_get_config(&config);
+	if(config.pkt_type != LR11XX_RADIO_PKT_TYPE_LORA) {
+		return;
+	}
+	symbol_us = (uint32_t)(((uint64_t)1000000 << config.sf) / lr11xx_radio_get_lora_bw_in_hz(config.bw));
+	if(CAD_LISTEN_ENABLED) {
+		preamble = CAD_LISTEN_PERIOD * 1000 / symbol_us + cad_symbols_by_sf[config.sf - LR11XX_RADIO_LORA_SF5] + 2;
+	}
+	else {
+		preamble = RX_DUTY_CYCLE_SLEEP_PERIOD * 1000 / symbol_us + 2 * RX_DUTY_CYCLE_RX_SYMBOLS + 2;
+	}
+	if(preamble < LORA_PREAMBLE_LENGTH) {
+		preamble = LORA_PREAMBLE_LENGTH;
+	}
+	if(preamble != config.preamble_len) {
+		config.preamble_len = (uint16_t)preamble;
+		lora_radio_reconfigure(&lr1121, &config);
+	}
+}
+
+// rebuild the timing table; call whenever modulation or packet params change
+static void link_timing_update(void) {
+	const uint32_t margin_us = (TX_RX_TRANSITION_DELAY + peer_reply_delay_ms) * 1000;
+	lora_radio_config_t config;
+
+	if(CAD_LISTEN_ENABLED || RX_DUTY_CYCLE_ENABLED) {
+		wake_preamble_update();
+	}
+
+	for(uint8_t length = 0; length <= LORA_MAX_PAYLOAD_LENGTH; length++) {
+		link_timing.toa_us[length] = get_time_on_air_in_us_for_length(length);
+	}
+	// peer may answer with anything up to a full batch
+	for(uint8_t length = 0; length <= LORA_MAX_PAYLOAD_LENGTH; length++) {
+		link_timing.rx_window_rtc[length] = us_to_rtc_step(link_timing.toa_us[length] +
+				link_timing.toa_us[LORA_MAX_PAYLOAD_LENGTH] + margin_us);
+	}
+	link_timing.reply_delay_rtc = us_to_rtc_step(reply_delay_ms * 1000);
+	// a detection can land anywhere in the preamble, the toa covers all of it
+	link_timing.cad_rx_window_rtc = us_to_rtc_step(link_timing.toa_us[LORA_MAX_PAYLOAD_LENGTH] +
+			TX_RX_TRANSITION_DELAY * 1000);
+
+	lora_radio_get_config(&config);
+	modem_lora = config.pkt_type == LR11XX_RADIO_PKT_TYPE_LORA;
+	link_timing.symbol_us = 0;
+	if(modem_lora) {
+		link_timing.symbol_us = (uint32_t)(((uint64_t)1000000 << config.sf) / lr11xx_radio_get_lora_bw_in_hz(config.bw));
+	}
+	link_timing.duty_cycle_rx_rtc = us_to_rtc_step(RX_DUTY_CYCLE_RX_SYMBOLS * link_timing.symbol_us);
+	link_timing.duty_cycle_sleep_rtc = us_to_rtc_step(RX_DUTY_CYCLE_SLEEP_PERIOD * 1000);
+
+	portENTER_CRITICAL(&snapshot_lock);
+	link_timing_snapshot = link_timing;
+	portEXIT_CRITICAL(&snapshot_lock);
+
+	if(IS_HOST && TDMA_ENABLED) {
+		stormwater_drone_lora_tdma_init(TDMA_DRONE_COUNT, link_timing.toa_us[TDMA_UPLINK_LENGTH]);
+	}
+}
+
+// take the delays the app set; link_timing_update puts them into the table
+static void reply_delay_take(void) {
+	reply_delay_ms = __atomic_load_n(&reply_delay_pending_ms, __ATOMIC_RELAXED);
+	peer_reply_delay_ms = __atomic_load_n(&peer_reply_delay_pending_ms, __ATOMIC_RELAXED);
+}
+
+static void apply_rate(const stormwater_drone_lora_rate_t* rate) {
+	// modulation params may only change out of rx/tx
+	lr11xx_system_set_standby(&lr1121, LR11XX_SYSTEM_STANDBY_CFG_RC);
+	lora_radio_set_rate(&lr1121, (lr11xx_radio_lora_sf_t)rate->sf, (lr11xx_radio_lora_bw_t)rate->bw, rate->power_dbm);
+	portENTER_CRITICAL(&snapshot_lock);
+	current_rate = *rate;
+	portEXIT_CRITICAL(&snapshot_lock);
+	stormwater_drone_lora_adr_reset(&current_rate);
+	link_timing_update();
+}
+
+static void adr_watchdog_kick(void) {
+	esp_timer_stop(adr_fallback_timer);
+	esp_timer_start_once(adr_fallback_timer, (uint64_t)ADR_FALLBACK_TIMEOUT * 1000);
+}
+
+// host: piggyback a pending adr request on the outgoing control frame
+static void adr_fill_request(uint8_t* packet, uint8_t length) {
+	stormwater_frame_t frame;
+
+	if(!IS_HOST || adr_pending_id == 0 ||
+			stormwater_frame_decode(packet, length, &frame) != STORMWATER_FRAME_OK ||
+			frame.type != STORMWATER_FRAME_TYPE_CONTROL) {
+		return;
+	}
+	frame.control.adr_id = adr_pending_id;
+	frame.control.adr_sf = adr_pending_rate.sf;
+	frame.control.adr_power_dbm = adr_pending_rate.power_dbm;
+	frame.control.adr_bw = adr_pending_rate.bw;
+	stormwater_frame_encode(&frame, packet, length);
+}
+
+// ctrlr: replace the outgoing control frame with the beacon of a new superframe
+static uint8_t tdma_fill_beacon(uint8_t* packet, uint8_t length) {
+	stormwater_frame_t frame;
+	uint8_t command = 0;
+
+	if(stormwater_frame_decode(packet, length, &frame) == STORMWATER_FRAME_OK &&
+			frame.type == STORMWATER_FRAME_TYPE_CONTROL) {
+		command = frame.control.command;
+	}
+	frame.type = STORMWATER_FRAME_TYPE_BEACON;
+	frame.addr = STORMWATER_FRAME_ADDR_BROADCAST;
+	frame.seq = tdma_beacon_seq++;
+	stormwater_drone_lora_tdma_begin(&frame.beacon, command);
+	return (uint8_t)stormwater_frame_encode(&frame, packet, LORA_MAX_PAYLOAD_LENGTH);
+}
+
+// move submitted frames into the arq window while it has room
+static void arq_fill_window(void) {
+	lora_submit_t submit;
+
+	while(stormwater_drone_lora_spsc_peek(&submit_ring, &submit) &&
+			stormwater_drone_lora_arq_push(submit.frame, submit.length)) {
+		stormwater_drone_lora_spsc_pop(&submit_ring, &submit);
+	}
+}
+
+// no arq: the oldest frame queued, else the last one sent again
+static const lora_submit_t* tx_next_frame(lora_submit_t* front) {
+	tx_from_ring = stormwater_drone_lora_spsc_peek(&submit_ring, front);
+	return tx_from_ring ? front : &tx_current;
+}
+
+// no arq, tx done: a queued frame went out, the next one goes next time
+static void tx_frame_sent(void) {
+	if(tx_from_ring) {
+		stormwater_drone_lora_spsc_pop(&submit_ring, &tx_current);
+		tx_from_ring = false;
+	}
+}
+
+// next packet to send; peek leaves the arq window as it is. without arq the frame
+// stays queued until tx done, so a packet built and not sent goes again
+static uint8_t build_send_packet(uint8_t* packet, bool peek) {
+	lora_submit_t front;
+	const lora_submit_t* submit;
+	uint8_t length;
+
+	if(ARQ_ENABLED) {
+		arq_fill_window();
+		length = peek ? stormwater_drone_lora_arq_peek(packet) : stormwater_drone_lora_arq_next(packet);
+		adr_fill_request(packet + PACKET_PREFIX_SIZE, length - PACKET_PREFIX_SIZE);
+		return length;
+	}
+
+	submit = tx_next_frame(&front);
+	length = submit->length;
+	if(length == 0 || length > LORA_MAX_FRAME_LENGTH) {
+		length = default_payload_length;
+	}
+	memcpy(packet, submit->frame, length);
+	if(IS_HOST && TDMA_ENABLED) {
+		length = tdma_fill_beacon(packet, length);
+	}
+	else {
+		adr_fill_request(packet, length);
+	}
+	return length;
+}
+
+/*
+ * write_buffer8 always starts at offset 0, so only the bytes up to the last one
+ * that differs from what the radio holds are sent: nothing for an unchanged frame,
+ * the link header for an arq frame whose acks moved
+ */
+static void write_send_packet(const uint8_t* packet, uint8_t length) {
+	uint8_t changed = length;
+
+	if(length != radio_payload_length) {
+		lora_radio_set_payload_length(&lr1121, length);
+		radio_payload_length = length;
+	}
+	if(length == tx_loaded_length) {
+		while(changed > 0 && packet[changed - 1] == tx_packet[changed - 1]) {
+			changed--;
+		}
+	}
+	if(changed > 0) {
+		memcpy(tx_packet, packet, changed);
+		lr11xx_regmem_write_buffer8(&lr1121, tx_packet, changed);
+	}
+	tx_loaded_length = length;
+}
+
+static void load_send_packet(void) {
+	uint8_t packet[LORA_MAX_PAYLOAD_LENGTH];
+
+	write_send_packet(packet, build_send_packet(packet, false));
+}
+
+// airtime class: arq acks and control frames go ahead of bulk data
+static bool packet_is_bulk(const uint8_t* packet, uint8_t length) {
+	if(length <= PACKET_PREFIX_SIZE) {
+		return false;
+	}
+	switch(stormwater_frame_peek_type(packet + PACKET_PREFIX_SIZE)) {
+		case STORMWATER_FRAME_TYPE_CONTROL:
+		case STORMWATER_FRAME_TYPE_BEACON:
+			return false;
+		default:
+			return true;
+	}
+}
+
+/*
+ * load the next packet if the airtime budget has room for it; bulk data over its
+ * share goes out as the arq acks alone. returns the us to wait when nothing fits
+ */
+static uint32_t load_send_packet_budgeted(void) {
+	uint8_t packet[LORA_MAX_PAYLOAD_LENGTH];
+	uint8_t length = STORMWATER_FRAME_LENGTH;
+	bool bulk = false;
+	int64_t now_us = esp_timer_get_time();
+	uint32_t wait_us;
+
+	if(!AIRTIME_BUDGET_ENABLED) {
+		load_send_packet();
+		return 0;
+	}
+	// the ctrlr beacon is built as it is sent and always a control frame
+	if(!(IS_HOST && TDMA_ENABLED)) {
+		length = build_send_packet(packet, true);
+		bulk = packet_is_bulk(packet, length);
+	}
+	wait_us = stormwater_drone_lora_airtime_wait_us(now_us, link_timing.toa_us[length], bulk);
+	if(wait_us == 0) {
+		load_send_packet();
+		return 0;
+	}
+	if(ARQ_ENABLED && bulk) {
+		length = stormwater_drone_lora_arq_ack(packet);
+		wait_us = stormwater_drone_lora_airtime_wait_us(now_us, link_timing.toa_us[length], false);
+		if(wait_us == 0) {
+			stormwater_drone_lora_airtime_on_demoted();
+			write_send_packet(packet, length);
+			return 0;
+		}
+	}
+	stormwater_drone_lora_airtime_on_deferred();
+	return wait_us;
+}
+
+/*
+ * stage the packet that will most likely go next, so sending it later only writes
+ * what changed. the ctrlr beacon is built as it is sent
+ */
+static void preload_send_packet(void) {
+	uint8_t packet[LORA_MAX_PAYLOAD_LENGTH];
+
+	if(IS_HOST && TDMA_ENABLED) {
+		return;
+	}
+	write_send_packet(packet, build_send_packet(packet, true));
+}
+
+/*
+ * drone listen state. in auto tx/rx mode the reply is pre-loaded and the
+ * sequencer is armed, so rx done rolls straight into tx without the host
+ */
+static void listen(void) {
+#if LORA_LINK_MODE == LORA_LINK_MODE_AUTO_TXRX
+	load_send_packet();
+	lr11xx_radio_auto_tx_rx(&lr1121, link_timing.reply_delay_rtc, AUTO_TXRX_INTERMEDIARY_MODE, 0);
+	lr11xx_radio_set_rx_with_timeout_in_rtc_step(&lr1121, 0);
+#else
+	if(CAD_LISTEN_ENABLED && modem_lora) {
+		// standby between sniffs; a detected preamble puts the radio in rx by itself
+		lr11xx_system_set_standby(&lr1121, LR11XX_SYSTEM_STANDBY_CFG_RC);
+		cad_configure(LR11XX_RADIO_CAD_EXIT_MODE_RX, link_timing.cad_rx_window_rtc);
+		cad_sniffing = true;
+		esp_timer_stop(cad_timer);
+		esp_timer_start_periodic(cad_timer, (uint64_t)CAD_LISTEN_PERIOD * 1000);
+	}
+	else if(RX_DUTY_CYCLE_ENABLED && modem_lora) {
+		// any spi access wakes the radio and ends the cycle, and the sleep phases lose
+		// the tx buffer (see tx_packet), so the reply is written once the request is in
+		lr11xx_radio_set_rx_duty_cycle_with_timings_in_rtc_step(&lr1121, link_timing.duty_cycle_rx_rtc,
+				link_timing.duty_cycle_sleep_rtc, LR11XX_RADIO_RX_DUTY_CYCLE_MODE_RX);
+		tx_loaded_length = 0;
+		return;
+	}
+	else {
+		// RX_CONTINUOUS is an rtc step value; set_rx would scale it as ms and overflow
+		lr11xx_radio_set_rx_with_timeout_in_rtc_step(&lr1121, RX_CONTINUOUS);
+	}
+	// the reply sits in the radio while we wait, refreshed as the app submits
+	listening = true;
+	preload_send_packet();
+#endif
+}
+
+static void cad_sniff_stop(void) {
+	if(cad_sniffing) {
+		cad_sniffing = false;
+		esp_timer_stop(cad_timer);
+	}
+}
+
+// ctrlr with CAD_LBT: the radio checks the channel and only transmits if it is clear
+static void start_tx(uint32_t timeout_ms) {
+	if(IS_HOST && CAD_LBT_ENABLED && modem_lora) {
+		lbt_attempts = 0;
+		lbt_timeout_ms = timeout_ms;
+		cad_configure(LR11XX_RADIO_CAD_EXIT_MODE_TX, us_to_rtc_step(timeout_ms * 1000));
+		lr11xx_radio_set_cad(&lr1121);
+		return;
+	}
+	lr11xx_radio_set_tx(&lr1121, timeout_ms);
+}
+
+/*
+ * false when the budget holds the packet back: the host tries again once there is
+ * room, the drone skips this reply and answers the host's retry
+ */
+static bool airtime_admit(void) {
+	uint32_t wait_us = load_send_packet_budgeted();
+
+	if(wait_us == 0) {
+		return true;
+	}
 	if(IS_HOST) {
-		// TODO: add debug message: client failed to respond
-		lr11xx_regmem_write_buffer8(&lr1121, stormwater_drone_lora_send_packet, PAYLOAD_LENGTH);
-		lr11xx_radio_set_tx(&lr1121, 50);
+		esp_timer_stop(reply_timer);
+		esp_timer_start_once(reply_timer, wait_us);
 	}
 	else {
-		lr11xx_radio_set_rx(&lr1121, RX_CONTINUOUS);
+		listen();
+	}
+	return false;
+}
+
+static void send_reply(void) {
+	listening = false;
+	cad_sniff_stop();
+	if(!airtime_admit()) {
+		return;
 	}
+#if LORA_LINK_MODE == LORA_LINK_MODE_AUTO_TXRX
+	// chip enters rx on its own once tx is done
+	lr11xx_radio_auto_tx_rx(&lr1121, us_to_rtc_step(AUTO_TXRX_TX_RX_DELAY_US), AUTO_TXRX_INTERMEDIARY_MODE,
+			link_timing.rx_window_rtc[radio_payload_length]);
+#endif
+	start_tx(0);
 }
 
+/*
+ * queue the reply instead of blocking the radio task for the turnaround;
+ * a newer rx before the timer fires restarts it and replies once. the reply is
+ * staged in the radio now so the timer mostly only has to start tx
+ */
+static void schedule_reply(void) {
+	if(reply_delay_ms == 0) {
+		send_reply();
+		return;
+	}
+	preload_send_packet();
+	esp_timer_stop(reply_timer);
+	esp_timer_start_once(reply_timer, (uint64_t)reply_delay_ms * 1000);
+}
+
+// ctrlr: keep listening until the last slot ends or every drone has answered
+static void tdma_host_rx_next(bool all_heard) {
+	int64_t remaining_us = tdma_window_end_us - esp_timer_get_time();
+
+	if(!all_heard && remaining_us > 0) {
+		lr11xx_radio_set_rx_with_timeout_in_rtc_step(&lr1121, us_to_rtc_step((uint32_t)remaining_us));
+		return;
+	}
+	lr11xx_system_set_standby(&lr1121, LR11XX_SYSTEM_STANDBY_CFG_RC);
+	stormwater_drone_lora_tdma_end();
+	schedule_reply();
+}
+
+// ctrlr: every valid uplink frame carries the sender's address and sequence number
+static void tdma_host_on_uplink(const uint8_t* packet, uint8_t size) {
+	stormwater_frame_t frame;
+	stormwater_frame_batch_t batch;
+	bool all_heard = false;
+
+	if(stormwater_frame_peek_type(packet) == STORMWATER_FRAME_TYPE_BATCH) {
+		if(stormwater_frame_batch_decode(packet, size, &batch) == STORMWATER_FRAME_OK) {
+			all_heard = stormwater_drone_lora_tdma_on_uplink(batch.addr, batch.seq, last_rssi_dbm, last_snr_db);
+		}
+	}
+	else if(stormwater_frame_decode(packet, size, &frame) == STORMWATER_FRAME_OK) {
+		all_heard = stormwater_drone_lora_tdma_on_uplink(frame.addr, frame.seq, last_rssi_dbm, last_snr_db);
+	}
+	tdma_host_rx_next(all_heard);
+}
+
+// drone: answer in our own slot of a beacon, ignore everything else
+static void tdma_drone_on_downlink(const uint8_t* packet, uint8_t size) {
+	stormwater_frame_t frame;
+	uint32_t offset_us;
+
+	if(stormwater_frame_decode(packet, size, &frame) == STORMWATER_FRAME_OK &&
+			frame.type == STORMWATER_FRAME_TYPE_BEACON &&
+			stormwater_drone_lora_tdma_slot_offset_us(&frame.beacon, node_address, &offset_us)) {
+		esp_timer_stop(reply_timer);
+		esp_timer_start_once(reply_timer, offset_us);
+		return;
+	}
+	listen();
+}
+
+static void reception_failure(void) {
+	if(IS_HOST && TDMA_ENABLED) {
+		tdma_host_rx_next(false);
+	}
+	else if(IS_HOST) {
+#if LORA_LINK_MODE == LORA_LINK_MODE_AUTO_TXRX
+		send_reply();
+#else
+		if(airtime_admit()) {
+			start_tx(50);
+		}
+#endif
+	}
+	else {
+		listen();
+	}
+}
+
+
+// the radio counts packets itself, fold its counters in now and then; not while the
+// drone's radio sniffs or duty cycles on its own, a command would cut that short
+static void radio_stats_poll(void) {
+	lr11xx_radio_stats_lora_t radio_stats;
+
+	if(!modem_lora || (!IS_HOST && (CAD_LISTEN_ENABLED || RX_DUTY_CYCLE_ENABLED))) {
+		return;
+	}
+	if(--radio_stats_countdown > 0) {
+		return;
+	}
+	radio_stats_countdown = LINK_STATS_RADIO_POLL;
+	if(lr11xx_radio_get_lora_stats(&lr1121, &radio_stats) == LR11XX_STATUS_OK) {
+		lr11xx_radio_reset_stats(&lr1121);
+		stormwater_drone_lora_stats_on_radio(radio_stats.nb_pkt_received, radio_stats.nb_pkt_crc_error,
+				radio_stats.nb_pkt_header_error, radio_stats.nb_pkt_falsesync);
+	}
+}
+
+// link quality and airtime budget bookkeeping for the packet just sent
+static void tx_account(void) {
+	stormwater_drone_lora_arq_stats_t arq_stats;
+	uint32_t toa_us = link_timing.toa_us[radio_payload_length];
+	bool retransmission = false;
+
+	if(ARQ_ENABLED) {
+		stormwater_drone_lora_arq_get_stats(&arq_stats);
+		retransmission = arq_stats.retransmitted != arq_retransmitted;
+		arq_retransmitted = arq_stats.retransmitted;
+	}
+	stormwater_drone_lora_stats_on_tx(irq_time_us, toa_us, retransmission);
+	stormwater_drone_lora_airtime_add(irq_time_us, toa_us);
+	if(IS_HOST) {
+		tx_start_us = irq_time_us - toa_us;
+	}
+}
 
 static void on_tx_done(void) {
-	lr11xx_radio_set_rx(&lr1121, (2 * get_time_on_air_in_ms() + TX_RX_TRANSITION_DELAY + ITERATION_DELAY));
+	link_stats.tx_done++;
+	post_event(STORMWATER_DRONE_LORA_EVENT_TX_DONE, 0, 0);
+	// before an adr switch changes the time on air
+	tx_account();
+	if(!ARQ_ENABLED) {
+		tx_frame_sent();
+	}
+
+	// drone: the reply acknowledging an adr request went out at the old rate
+	if(!IS_HOST && adr_pending_id != 0) {
+		adr_last_id = adr_pending_id;
+		adr_pending_id = 0;
+		apply_rate(&adr_pending_rate);
+	}
+#if LORA_LINK_MODE == LORA_LINK_MODE_AUTO_TXRX
+	// host is already in rx via the sequencer; drone re-arms for the next request
+	if(!IS_HOST) {
+		listen();
+	}
+#else
+	if(TDMA_ENABLED && IS_HOST) {
+		tdma_window_end_us = esp_timer_get_time() + stormwater_drone_lora_tdma_window_us();
+		tdma_host_rx_next(false);
+	}
+	else if(TDMA_ENABLED) {
+		listen();
+	}
+	else if(!IS_HOST && (CAD_LISTEN_ENABLED || RX_DUTY_CYCLE_ENABLED)) {
+		listen();
+	}
+	else {
+		lr11xx_radio_set_rx_with_timeout_in_rtc_step(&lr1121, link_timing.rx_window_rtc[radio_payload_length]);
+		if(!IS_HOST) {
+			listening = true;
+			preload_send_packet();
+		}
+	}
+#endif
+	// off the turnaround path, the radio is already in its next state
+	radio_stats_poll();
 }
 
-static void lora_receive(const void* context, uint8_t* buffer, uint8_t buffer_length, uint8_t* size) {
+static bool lora_receive(const void* context, uint8_t* buffer, uint8_t buffer_length, uint8_t* size) {
 	lr11xx_radio_rx_buffer_status_t rx_buffer_status;
 	lr11xx_radio_pkt_status_lora_t pkt_status_lora;
 	lr11xx_radio_pkt_status_gfsk_t pkt_status_gfsk;
@@ -69,79 +867,264 @@ static void lora_receive(const void* context, uint8_t* buffer, uint8_t buffer_le
 	lr11xx_radio_get_rx_buffer_status(&lr1121, &rx_buffer_status);
 	*size = rx_buffer_status.pld_len_in_bytes;
 	if(*size > buffer_length) {
-		// TODO: add debug - payload larger than buffer
-		return;
+		post_event(STORMWATER_DRONE_LORA_EVENT_OVERSIZE, *size, 0);
+		return false;
 	}
 
 	lr11xx_regmem_read_buffer8(&lr1121, buffer, rx_buffer_status.buffer_start_pointer, 
 			rx_buffer_status.pld_len_in_bytes);
-	// TODO: add paket status debug
-	
+
+	if(modem_lora) {
+		lr11xx_radio_get_lora_pkt_status(&lr1121, &pkt_status_lora);
+		last_rssi_dbm = pkt_status_lora.rssi_pkt_in_dbm;
+		last_snr_db = pkt_status_lora.snr_pkt_in_db;
+	}
+	else {
+		lr11xx_radio_get_gfsk_pkt_status(&lr1121, &pkt_status_gfsk);
+		last_rssi_dbm = pkt_status_gfsk.rssi_avg_in_dbm;
+		last_snr_db = 0;
+	}
+	return true;
 }
 
-static void on_rx_done(void) {
-	uint8_t size;
-	lora_receive(&lr1121, stormwater_drone_lora_receive_packet, PAYLOAD_LENGTH, &size);
-	vTaskDelay(ITERATION_DELAY / portTICK_PERIOD_MS);
-	lr11xx_regmem_write_buffer8(&lr1121, stormwater_drone_lora_send_packet, PAYLOAD_LENGTH);
-	lr11xx_radio_set_tx(&lr1121, 0);
+static bool rate_is_valid(uint8_t sf, uint8_t bw, int8_t power_dbm) {
+	return sf >= LR11XX_RADIO_LORA_SF5 && sf <= LR11XX_RADIO_LORA_SF12 && bw >= ADR_BW_MIN && bw <= ADR_BW_MAX &&
+		power_dbm >= SMTC_SHIELD_LR11XX_MIN_PWR && power_dbm <= SMTC_SHIELD_LR11XX_MAX_PWR;
 }
 
-static void on_rx_timeout() {
-	// TODO: add debug msg
-	reception_failure();
+/*
+ * host: any reply proves the drone got the request and switched after
+ * sending it, so switch too; otherwise feed adr and maybe start a request
+ */
+static void adr_host_on_reply(void) {
+	stormwater_drone_lora_rate_t proposal;
+
+	if(adr_pending_id != 0) {
+		adr_pending_id = 0;
+		apply_rate(&adr_pending_rate);
+		return;
+	}
+	stormwater_drone_lora_adr_on_packet(last_rssi_dbm, last_snr_db);
+	if(ADR_ENABLED && modem_lora && stormwater_drone_lora_adr_propose(&proposal)) {
+		adr_pending_rate = proposal;
+		adr_pending_id = (adr_last_id == UINT8_MAX) ? 1 : adr_last_id + 1;
+		adr_last_id = adr_pending_id;
+	}
 }
 
+// drone: note a new adr request; it takes effect once the reply is sent
+static void adr_drone_on_request(const uint8_t* packet, uint8_t size) {
+	stormwater_frame_t frame;
 
+	if(!modem_lora || stormwater_frame_decode(packet, size, &frame) != STORMWATER_FRAME_OK ||
+			frame.type != STORMWATER_FRAME_TYPE_CONTROL || frame.control.adr_id == 0 ||
+			frame.control.adr_id == adr_last_id ||
+			!rate_is_valid(frame.control.adr_sf, frame.control.adr_bw, frame.control.adr_power_dbm)) {
+		return;
+	}
+	adr_pending_rate.sf = frame.control.adr_sf;
+	adr_pending_rate.power_dbm = frame.control.adr_power_dbm;
+	adr_pending_rate.bw = frame.control.adr_bw;
+	adr_pending_id = frame.control.adr_id;
+}
 
+// both sides: no valid packet for ADR_FALLBACK_TIMEOUT, go back to the default rate
+static void adr_fallback(void) {
+	adr_pending_id = 0;
+	if(!modem_lora) {
+		return;
+	}
+	if(current_rate.sf == default_rate.sf && current_rate.bw == default_rate.bw &&
+			current_rate.power_dbm == default_rate.power_dbm) {
+		return;
+	}
+	apply_rate(&default_rate);
+	if(IS_HOST) {
+		send_reply();
+	}
+	else {
+		listen();
+	}
+}
 
-// --- PUBLIC METHODS ---
+// radio task: a free pool slot, NULL if the app holds them all
+static stormwater_drone_lora_rx_frame_t* rx_slot_take(void) {
+	uint32_t free_mask = __atomic_load_n(&rx_free_mask, __ATOMIC_ACQUIRE);
+	uint8_t i;
 
-void stormwater_drone_lora_init(void) {
+	if(free_mask == 0) {
+		return NULL;
+	}
+	i = (uint8_t)__builtin_ctz(free_mask);
+	__atomic_fetch_and(&rx_free_mask, ~(1u << i), __ATOMIC_ACQ_REL);
+	return &rx_pool[i];
+}
 
-	stormwater_drone_spi_init();
+// any task
+static void rx_slot_give(stormwater_drone_lora_rx_frame_t* slot) {
+	__atomic_fetch_or(&rx_free_mask, 1u << (slot - rx_pool), __ATOMIC_RELEASE);
+}
 
-	lora_init_io_context(&lr1121, ESP_CS, ESP_RESET, ESP_BUSY, ESP_INT);
-	lora_init_io(&lr1121);
+// hand a received packet to the work task for the app, or give its slot back
+static void rx_deliver(stormwater_drone_lora_rx_frame_t* slot, const uint8_t* frame, uint8_t frame_length,
+		bool is_new) {
+	lora_work_t work = { .type = LORA_WORK_DELIVER, .frame = slot };
 
-	lora_spi_init(&lr1121, stormwater_drone_spi_handle);
+	if(slot == &rx_scratch) {
+		return;
+	}
+	if(!is_new || frame_length == 0) {
+		rx_slot_give(slot);
+		return;
+	}
+	slot->frame = frame;
+	slot->frame_length = frame_length;
+	slot->rssi_dbm = last_rssi_dbm;
+	slot->snr_db = last_snr_db;
+	// never fails, the high ring has an entry per pool slot
+	work_post(&work_high, &work);
+}
 
-	lora_system_init(&lr1121);
-	lora_radio_init(&lr1121);
-	lora_init_irq(&lr1121, isr);
+static void on_rx_done(void) {
+	stormwater_drone_lora_rx_frame_t* slot;
+	uint8_t size;
+	const uint8_t* frame;
+	uint8_t frame_length;
+	bool is_new = true;
 
-	lr11xx_system_set_dio_irq_params( &lr1121, IRQ_MASK, 0 );
-	lr11xx_system_clear_irq_status( &lr1121, LR11XX_SYSTEM_IRQ_ALL_MASK );
+	// the radio reads straight into a pool slot the app then owns
+	slot = rx_slot_take();
+	if(slot == NULL) {
+		slot = &rx_scratch;
+		rx_stats.overruns++;
+		post_event(STORMWATER_DRONE_LORA_EVENT_RX_OVERRUN, 0, 0);
+	}
+	slot->timestamp_us = irq_time_us;
+
+	if(!lora_receive(&lr1121, slot->data, LORA_MAX_PAYLOAD_LENGTH, &size)) {
+		stormwater_drone_lora_stats_on_loss();
+		rx_deliver(slot, NULL, 0, false);
+		reception_failure();
+		return;
+	}
 
-	lr11xx_regmem_write_buffer8(&lr1121, stormwater_drone_lora_send_packet, PAYLOAD_LENGTH);
+	link_stats.rx_done++;
+	stormwater_drone_lora_stats_on_rx(last_rssi_dbm, last_snr_db);
+	if(IS_HOST && tx_start_us != 0) {
+		stormwater_drone_lora_stats_on_rtt((uint32_t)(irq_time_us - tx_start_us));
+		tx_start_us = 0;
+	}
+	frame = slot->data;
+	frame_length = size;
+	if(ARQ_ENABLED) {
+		// link fields (adr) are read from duplicates too, the app only sees new frames;
+		// without a slot the frame stays unacked and the peer repeats it
+		is_new = stormwater_drone_lora_arq_receive(slot->data, size, ARQ_ACK_COVERS_LAST_TX,
+				slot != &rx_scratch, &frame, &frame_length);
+	}
+	else if(slot == &rx_scratch) {
+		is_new = false;
+	}
+	rx_deliver(slot, frame, frame_length, is_new);
 
+	adr_watchdog_kick();
+	if(TDMA_ENABLED) {
+		// one rate for the whole cell; adr negotiates per link
+		if(IS_HOST) {
+			tdma_host_on_uplink(frame, frame_length);
+		}
+		else {
+			tdma_drone_on_downlink(frame, frame_length);
+		}
+		return;
+	}
 	if(IS_HOST) {
-		lr11xx_radio_set_tx(&lr1121, 0);
+		adr_host_on_reply();
+	}
+	else {
+		adr_drone_on_request(frame, frame_length);
+	}
+#if LORA_LINK_MODE == LORA_LINK_MODE_AUTO_TXRX
+	// drone reply was already started by the sequencer
+	if(!IS_HOST) {
+		return;
+	}
+#endif
+	schedule_reply();
+}
+
+static void on_rx_timeout() {
+	link_stats.rx_timeouts++;
+	post_event(STORMWATER_DRONE_LORA_EVENT_RX_TIMEOUT, 0, 0);
+	// a cad rx window that times out woke on noise, nothing was lost
+	if(!IS_HOST && CAD_LISTEN_ENABLED) {
+		cad_stats.false_wakes++;
 	}
 	else {
-		lr11xx_radio_set_rx(&lr1121, RX_CONTINUOUS);
+		stormwater_drone_lora_stats_on_loss();
 	}
+	reception_failure();
 }
 
-void stormwater_drone_lora_irq_process(void) {
-	stormwater_drone_lora_irq_flag = false;
+static void on_cad_done(bool detected) {
+	if(IS_HOST && CAD_LBT_ENABLED) {
+		if(!detected) {
+			// clear: the radio is already transmitting
+			cad_stats.lbt_clear++;
+			return;
+		}
+		cad_stats.lbt_busy++;
+		if(++lbt_attempts >= CAD_LBT_MAX_ATTEMPTS) {
+			cad_stats.lbt_forced++;
+			lr11xx_radio_set_tx(&lr1121, lbt_timeout_ms);
+			return;
+		}
+		esp_timer_start_once(lbt_timer, (uint64_t)(esp_random() % CAD_LBT_BACKOFF_MAX + 1) * 1000);
+	}
+	else if(!IS_HOST && CAD_LISTEN_ENABLED && detected) {
+		// radio is in rx until a packet or the cad rx window times out
+		cad_sniff_stop();
+		cad_stats.detections++;
+	}
+}
+
+static void lora_irq_process(void) {
 	lr11xx_system_irq_mask_t irq_regs;
 	lr11xx_system_get_and_clear_irq_status(&lr1121, &irq_regs);
 
 	// parse flags
 	irq_regs &= IRQ_MASK;
 
+	if((irq_regs & LR11XX_SYSTEM_IRQ_CAD_DONE) == LR11XX_SYSTEM_IRQ_CAD_DONE) {
+		on_cad_done((irq_regs & LR11XX_SYSTEM_IRQ_CAD_DETECTED) == LR11XX_SYSTEM_IRQ_CAD_DETECTED);
+	}
 	if((irq_regs & LR11XX_SYSTEM_IRQ_TX_DONE) == LR11XX_SYSTEM_IRQ_TX_DONE) {
 		on_tx_done();
 	}
 	if((irq_regs & LR11XX_SYSTEM_IRQ_HEADER_ERROR) == LR11XX_SYSTEM_IRQ_HEADER_ERROR) {
-		// TODO: add debug message
+		link_stats.header_errors++;
+		stormwater_drone_lora_stats_on_loss();
+		post_event(STORMWATER_DRONE_LORA_EVENT_HEADER_ERROR, 0, 0);
+		// single rx after a cad detection ends here, go back to sniffing
+		if(!IS_HOST && CAD_LISTEN_ENABLED) {
+			cad_stats.false_wakes++;
+			listen();
+		}
+		else if(!IS_HOST && RX_DUTY_CYCLE_ENABLED) {
+			listen();
+		}
 	}
 	if((irq_regs & LR11XX_SYSTEM_IRQ_RX_DONE) == LR11XX_SYSTEM_IRQ_RX_DONE) {
 		if((irq_regs & LR11XX_SYSTEM_IRQ_CRC_ERROR) == LR11XX_SYSTEM_IRQ_CRC_ERROR) {
+			link_stats.crc_errors++;
+			stormwater_drone_lora_stats_on_loss();
+			post_event(STORMWATER_DRONE_LORA_EVENT_CRC_ERROR, 0, 0);
 			reception_failure();
 		}
 		else if((irq_regs & LR11XX_SYSTEM_IRQ_FSK_LEN_ERROR) == LR11XX_SYSTEM_IRQ_FSK_LEN_ERROR) {
+			link_stats.len_errors++;
+			stormwater_drone_lora_stats_on_loss();
+			post_event(STORMWATER_DRONE_LORA_EVENT_LEN_ERROR, 0, 0);
 			reception_failure();
 		}
 		else {
@@ -153,4 +1136,475 @@ void stormwater_drone_lora_irq_process(void) {
 	}
 }
 
+// take the edge the isr recorded, 0 if none since the last take
+static int64_t irq_edge_take(void) {
+	int64_t edge_us;
+
+	portENTER_CRITICAL(&irq_edge_lock);
+	edge_us = irq_edge_time_us;
+	irq_edge_time_us = 0;
+	portEXIT_CRITICAL(&irq_edge_lock);
+	return edge_us;
+}
+
+static void irq_latency_update(void) {
+	uint32_t latency_us = (uint32_t)(esp_timer_get_time() - irq_time_us);
+
+	irq_latency_sum_us += latency_us;
+	portENTER_CRITICAL(&snapshot_lock);
+	irq_latency.last_us = latency_us;
+	if(latency_us > irq_latency.max_us) {
+		irq_latency.max_us = latency_us;
+	}
+	irq_latency.count++;
+	irq_latency.avg_us = (uint32_t)(irq_latency_sum_us / irq_latency.count);
+	portEXIT_CRITICAL(&snapshot_lock);
+}
+
+static void reconfigure(void) {
+	lora_radio_config_t config;
+	uint8_t commands;
+
+	if(xQueueReceive(reconfigure_queue, &config, 0) != pdTRUE) {
+		return;
+	}
+
+	esp_timer_stop(reply_timer);
+	// a sniff or backoff started on the old profile must not fire on the new one
+	cad_sniff_stop();
+	esp_timer_stop(lbt_timer);
+	tx_loaded_length = 0;	// see tx_packet
+	lr11xx_system_set_standby(&lr1121, LR11XX_SYSTEM_STANDBY_CFG_RC);
+	commands = lora_radio_reconfigure(&lr1121, &config);
+
+	default_payload_length = config.payload_len;
+	if(config.payload_len != radio_payload_length) {
+		lora_radio_set_payload_length(&lr1121, config.payload_len);
+		radio_payload_length = config.payload_len;
+	}
+
+	// the new profile is what adr starts from and falls back to
+	default_rate.sf = config.sf;
+	default_rate.bw = config.bw;
+	default_rate.power_dbm = config.tx_power_dbm;
+	portENTER_CRITICAL(&snapshot_lock);
+	current_rate = default_rate;
+	portEXIT_CRITICAL(&snapshot_lock);
+	adr_pending_id = 0;
+	stormwater_drone_lora_adr_reset(&current_rate);
+	link_timing_update();
+
+	post_event(STORMWATER_DRONE_LORA_EVENT_RECONFIGURED, commands, link_timing.toa_us[radio_payload_length]);
+
+	if(IS_HOST) {
+		send_reply();
+	}
+	else {
+		listen();
+	}
+}
+
+/*
+ * radio task - sleeps until the isr notifies it, so no core is spent polling
+ */
+static void lora_task(void* pvParameters) {
+	uint32_t notify_bits;
+
+	// started here rather than by init, so no other task ever drives the radio
+	if(IS_HOST) {
+		send_reply();
+	}
+	else {
+		listen();
+	}
+	for(;;) {
+#if LORA_LIGHT_SLEEP
+		esp_pm_lock_release(radio_pm_lock);
+		xTaskNotifyWait(0, UINT32_MAX, &notify_bits, portMAX_DELAY);
+		esp_pm_lock_acquire(radio_pm_lock);
+#else
+		xTaskNotifyWait(0, UINT32_MAX, &notify_bits, portMAX_DELAY);
+#endif
+
+		if(notify_bits & LORA_NOTIFY_IRQ) {
+			irq_time_us = irq_edge_take();
+			if(irq_time_us != 0) {
+				irq_latency_update();
+			}
+			else {
+				irq_time_us = esp_timer_get_time();
+			}
+			lora_irq_process();
+
+			// DIO is level-held until cleared; catch irqs raised while processing. they
+			// never made an edge, so the best time we have is now
+			while(gpio_get_level(lr1121.irq) == 1) {
+				irq_time_us = esp_timer_get_time();
+				lora_irq_process();
+			}
+#if LORA_LIGHT_SLEEP
+			gpio_intr_enable(lr1121.irq);
+#endif
+		}
+		if(notify_bits & LORA_NOTIFY_REPLY) {
+			send_reply();
+		}
+		if(notify_bits & LORA_NOTIFY_ADR_FALLBACK) {
+			adr_fallback();
+		}
+		if(notify_bits & LORA_NOTIFY_RECONFIGURE) {
+			reconfigure();
+		}
+		// a reply already armed keeps the old delay, the next one uses the new
+		if(notify_bits & LORA_NOTIFY_REPLY_DELAY) {
+			reply_delay_take();
+			link_timing_update();
+		}
+		if((notify_bits & LORA_NOTIFY_CAD) && cad_sniffing) {
+			cad_stats.sniffs++;
+			lr11xx_radio_set_cad(&lr1121);
+		}
+		if(notify_bits & LORA_NOTIFY_LBT) {
+			lr11xx_radio_set_cad(&lr1121);
+		}
+		// writing the tx buffer mid-transmission would tear the packet on air
+		if((notify_bits & LORA_NOTIFY_PRELOAD) && listening) {
+			preload_send_packet();
+		}
+	}
+}
+
+
+
+
+static void work_event(const lora_work_t* work) {
+	switch(work->event) {
+		case STORMWATER_DRONE_LORA_EVENT_TX_DONE:
+			if(callbacks.on_tx_done != NULL) {
+				callbacks.on_tx_done(callbacks.context);
+			}
+			return;
+		case STORMWATER_DRONE_LORA_EVENT_RX_TIMEOUT:
+			if(IS_HOST) {
+				ESP_LOGD(TAG, "drone failed to respond");
+			}
+			else {
+				ESP_LOGD(TAG, "rx timeout");
+			}
+			if(callbacks.on_timeout != NULL) {
+				callbacks.on_timeout(callbacks.context);
+			}
+			return;
+		case STORMWATER_DRONE_LORA_EVENT_CRC_ERROR:
+			ESP_LOGD(TAG, "crc error");
+			break;
+		case STORMWATER_DRONE_LORA_EVENT_HEADER_ERROR:
+			ESP_LOGD(TAG, "header error");
+			break;
+		case STORMWATER_DRONE_LORA_EVENT_LEN_ERROR:
+			ESP_LOGD(TAG, "fsk length error");
+			break;
+		case STORMWATER_DRONE_LORA_EVENT_OVERSIZE:
+			ESP_LOGW(TAG, "%u byte payload larger than the rx buffer", work->arg);
+			break;
+		case STORMWATER_DRONE_LORA_EVENT_RX_OVERRUN:
+			ESP_LOGW(TAG, "rx pool empty, frame not delivered");
+			break;
+		case STORMWATER_DRONE_LORA_EVENT_RECONFIGURED:
+			ESP_LOGI(TAG, "reconfigured: %u commands, time on air %lu us", work->arg,
+					(unsigned long)work->value);
+			return;
+	}
+	if(callbacks.on_error != NULL) {
+		callbacks.on_error((stormwater_drone_lora_event_t)work->event, callbacks.context);
+	}
+}
+
+static void work_deliver(stormwater_drone_lora_rx_frame_t* slot) {
+	uint8_t in_use;
 
+	rx_stats.delivered++;
+	in_use = LORA_RX_POOL_SIZE - (uint8_t)__builtin_popcount(__atomic_load_n(&rx_free_mask, __ATOMIC_ACQUIRE));
+	if(in_use > rx_stats.in_use_max) {
+		rx_stats.in_use_max = in_use;
+	}
+
+	if(callbacks.on_rx != NULL) {
+		callbacks.on_rx(slot, callbacks.context);
+	}
+	else {
+		xQueueSend(rx_frame_queue, &slot, 0);
+	}
+}
+
+/*
+ * work task - below the radio task, runs whatever the radio task should not wait on
+ */
+static void lora_work_task(void* pvParameters) {
+	lora_work_t work;
+
+	for(;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		// drain frames before each event so a burst of errors cannot hold one back
+		while(stormwater_drone_lora_spsc_pop(&work_high, &work) ||
+				stormwater_drone_lora_spsc_pop(&work_low, &work)) {
+			if(work.type == LORA_WORK_DELIVER) {
+				work_deliver(work.frame);
+			}
+			else {
+				work_event(&work);
+			}
+		}
+	}
+}
+
+// esp32 light sleep between radio irqs, needs CONFIG_PM_ENABLE and tickless idle
+static void light_sleep_init(void) {
+#if LORA_LIGHT_SLEEP
+	const esp_pm_config_t pm_config = {
+		.max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+		.min_freq_mhz = CONFIG_XTAL_FREQ,
+		.light_sleep_enable = true,
+	};
+
+	// covers the rest of init, the radio task releases it once it waits
+	esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "lora_radio", &radio_pm_lock);
+	esp_pm_lock_acquire(radio_pm_lock);
+	esp_pm_configure(&pm_config);
+
+	// edge interrupts cannot wake light sleep; DIO stays high until the irq is cleared
+	gpio_wakeup_enable(ESP_INT, GPIO_INTR_HIGH_LEVEL);
+	esp_sleep_enable_gpio_wakeup();
+#endif
+}
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_set_callbacks(const stormwater_drone_lora_callbacks_t* app_callbacks) {
+	callbacks = *app_callbacks;
+}
+
+void stormwater_drone_lora_init(void) {
+
+	stormwater_drone_spi_init();
+
+	lora_init_io_context(&lr1121, ESP_CS, ESP_RESET, ESP_BUSY, ESP_INT);
+	lora_init_io(&lr1121);
+
+	lora_spi_init(&lr1121, stormwater_drone_spi_handle);
+
+	lora_system_init(&lr1121);
+	lora_radio_init(&lr1121);
+	lora_init_irq(&lr1121, isr);
+	light_sleep_init();
+
+	lr11xx_system_set_dio_irq_params( &lr1121, IRQ_MASK, 0 );
+	lr11xx_system_clear_irq_status( &lr1121, LR11XX_SYSTEM_IRQ_ALL_MASK );
+
+	// epoch 0 means "peer not heard yet" in the arq header
+	stormwater_drone_lora_arq_reset((uint8_t)(esp_random() % 15) + 1);
+	stormwater_drone_lora_spsc_init(&submit_ring, submit_items, sizeof(lora_submit_t), LORA_TX_QUEUE_LENGTH);
+
+	rx_frame_queue = xQueueCreate(LORA_RX_POOL_SIZE, sizeof(stormwater_drone_lora_rx_frame_t*));
+	__atomic_store_n(&rx_free_mask, (uint32_t)((1ull << LORA_RX_POOL_SIZE) - 1), __ATOMIC_RELEASE);
+
+	load_send_packet();
+	reply_delay_take();
+	link_timing_update();
+	stormwater_drone_lora_stats_reset(esp_timer_get_time());
+	stormwater_drone_lora_airtime_reset();
+
+	const esp_timer_create_args_t reply_timer_args = {
+		.callback = reply_timer_callback,
+		.name = "lora_reply",
+	};
+	esp_timer_create(&reply_timer_args, &reply_timer);
+
+	const esp_timer_create_args_t adr_fallback_timer_args = {
+		.callback = adr_fallback_timer_callback,
+		.name = "lora_adr_fallback",
+	};
+	esp_timer_create(&adr_fallback_timer_args, &adr_fallback_timer);
+
+	const esp_timer_create_args_t cad_timer_args = {
+		.callback = cad_timer_callback,
+		.name = "lora_cad",
+	};
+	esp_timer_create(&cad_timer_args, &cad_timer);
+
+	const esp_timer_create_args_t lbt_timer_args = {
+		.callback = lbt_timer_callback,
+		.name = "lora_lbt",
+	};
+	esp_timer_create(&lbt_timer_args, &lbt_timer);
+	stormwater_drone_lora_adr_reset(&current_rate);
+
+	reconfigure_queue = xQueueCreate(1, sizeof(lora_radio_config_t));
+
+	send_lock = xSemaphoreCreateMutex();
+
+	stormwater_drone_lora_spsc_init(&work_high, work_high_items, sizeof(lora_work_t), LORA_RX_POOL_SIZE);
+	stormwater_drone_lora_spsc_init(&work_low, work_low_items, sizeof(lora_work_t), LORA_WORK_QUEUE_LENGTH);
+	xTaskCreate(lora_work_task, "lora_work_task", LORA_WORK_TASK_STACK_SIZE, NULL, LORA_WORK_TASK_PRIORITY,
+			&work_task_handle);
+	xTaskCreate(lora_task, "lora_task", LORA_TASK_STACK_SIZE, NULL, LORA_TASK_PRIORITY, &lora_task_handle);
+}
+
+uint8_t* stormwater_drone_lora_send_buffer(void) {
+	return submit_buffer.frame;
+}
+
+bool stormwater_drone_lora_submit(uint8_t length) {
+	if(submit_ring.items == NULL || length == 0 || length > LORA_MAX_FRAME_LENGTH) {
+		return false;
+	}
+	// the radio task only ever sees whole frames, copied in by the push
+	submit_buffer.length = length;
+	if(!stormwater_drone_lora_spsc_push(&submit_ring, &submit_buffer)) {
+		return false;
+	}
+	// drone: restage the reply now rather than on the rx done path
+	if(!IS_HOST && lora_task_handle != NULL) {
+		xTaskNotify(lora_task_handle, LORA_NOTIFY_PRELOAD, eSetBits);
+	}
+	return true;
+}
+
+bool stormwater_drone_lora_send(const uint8_t* frame, uint8_t length) {
+	bool submitted;
+
+	if(send_lock == NULL || length > LORA_MAX_FRAME_LENGTH) {
+		return false;
+	}
+	xSemaphoreTake(send_lock, portMAX_DELAY);
+	memcpy(stormwater_drone_lora_send_buffer(), frame, length);
+	submitted = stormwater_drone_lora_submit(length);
+	xSemaphoreGive(send_lock);
+	return submitted;
+}
+
+stormwater_drone_lora_rx_frame_t* stormwater_drone_lora_receive(TickType_t timeout) {
+	stormwater_drone_lora_rx_frame_t* frame;
+
+	if(rx_frame_queue == NULL || xQueueReceive(rx_frame_queue, &frame, timeout) != pdTRUE) {
+		return NULL;
+	}
+	return frame;
+}
+
+void stormwater_drone_lora_release(stormwater_drone_lora_rx_frame_t* frame) {
+	if(frame != NULL) {
+		rx_slot_give(frame);
+	}
+}
+
+void stormwater_drone_lora_get_link_stats(stormwater_drone_lora_link_stats_t* stats) {
+	*stats = link_stats;
+}
+
+void stormwater_drone_lora_get_link_quality(stormwater_drone_lora_link_quality_t* quality) {
+	stormwater_drone_lora_stats_get(quality, esp_timer_get_time());
+}
+
+size_t stormwater_drone_lora_encode_link_stats(uint8_t addr, uint8_t seq, uint8_t* buf, size_t buf_length) {
+	stormwater_drone_lora_link_quality_t quality;
+	stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_LINK_STATS,
+		.addr = addr,
+		.seq = seq,
+	};
+
+	stormwater_drone_lora_stats_get(&quality, esp_timer_get_time());
+	frame.link_stats.per_permille = quality.per_permille;
+	frame.link_stats.rssi_dbm = quality.rssi_avg_dbm;
+	frame.link_stats.snr_db = quality.snr_avg_db;
+	frame.link_stats.snr_min_db = quality.snr_min_db;
+	frame.link_stats.retries = quality.retries;
+	frame.link_stats.airtime_permille = quality.airtime_permille;
+	frame.link_stats.rtt_p90_ms = (uint16_t)(quality.rtt_p90_us / 1000 > UINT16_MAX ? UINT16_MAX :
+			quality.rtt_p90_us / 1000);
+	return stormwater_frame_encode(&frame, buf, buf_length);
+}
+
+void stormwater_drone_lora_get_airtime_stats(stormwater_drone_lora_airtime_stats_t* stats) {
+	stormwater_drone_lora_airtime_get_stats(stats, esp_timer_get_time());
+}
+
+void stormwater_drone_lora_get_rx_stats(stormwater_drone_lora_rx_stats_t* stats) {
+	*stats = rx_stats;
+}
+
+void stormwater_drone_lora_get_arq_stats(stormwater_drone_lora_arq_stats_t* stats) {
+	stormwater_drone_lora_arq_get_stats(stats);
+}
+
+void stormwater_drone_lora_set_reply_delay(uint32_t delay_ms) {
+	__atomic_store_n(&reply_delay_pending_ms, delay_ms, __ATOMIC_RELAXED);
+	if(lora_task_handle != NULL) {
+		xTaskNotify(lora_task_handle, LORA_NOTIFY_REPLY_DELAY, eSetBits);
+	}
+}
+
+void stormwater_drone_lora_set_peer_reply_delay(uint32_t delay_ms) {
+	__atomic_store_n(&peer_reply_delay_pending_ms, delay_ms, __ATOMIC_RELAXED);
+	if(lora_task_handle != NULL) {
+		xTaskNotify(lora_task_handle, LORA_NOTIFY_REPLY_DELAY, eSetBits);
+	}
+}
+
+void stormwater_drone_lora_get_link_timing(stormwater_drone_lora_link_timing_t* timing) {
+	portENTER_CRITICAL(&snapshot_lock);
+	*timing = link_timing_snapshot;
+	portEXIT_CRITICAL(&snapshot_lock);
+}
+
+bool stormwater_drone_lora_reconfigure(const lora_radio_config_t* config) {
+	if(lora_task_handle == NULL || config->payload_len > LORA_MAX_PAYLOAD_LENGTH ||
+			!lora_radio_config_is_valid(config)) {
+		return false;
+	}
+	xQueueOverwrite(reconfigure_queue, config);
+	xTaskNotify(lora_task_handle, LORA_NOTIFY_RECONFIGURE, eSetBits);
+	return true;
+}
+
+void stormwater_drone_lora_get_config(lora_radio_config_t* config) {
+	lora_radio_get_config(config);
+}
+
+void stormwater_drone_lora_set_address(uint8_t address) {
+	node_address = address;
+}
+
+void stormwater_drone_lora_get_tdma_stats(stormwater_drone_lora_tdma_stats_t* stats) {
+	stormwater_drone_lora_tdma_get_stats(stats);
+}
+
+void stormwater_drone_lora_get_rate(stormwater_drone_lora_rate_t* rate) {
+	portENTER_CRITICAL(&snapshot_lock);
+	*rate = current_rate;
+	portEXIT_CRITICAL(&snapshot_lock);
+}
+
+void stormwater_drone_lora_get_irq_latency(stormwater_drone_lora_irq_latency_t* latency) {
+	portENTER_CRITICAL(&snapshot_lock);
+	*latency = irq_latency;
+	portEXIT_CRITICAL(&snapshot_lock);
+}
+
+void stormwater_drone_lora_get_cad_stats(stormwater_drone_lora_cad_stats_t* stats) {
+	*stats = cad_stats;
+}
+
+void stormwater_drone_lora_get_work_stats(stormwater_drone_lora_work_stats_t* stats) {
+	*stats = work_stats;
+}
+
+uint8_t stormwater_drone_lora_get_busy_stats(lora_busy_stats_t* stats, uint8_t max_count) {
+	return lora_busy_get_stats(&lr1121, stats, max_count);
+}
+
+void stormwater_drone_lora_trace_dump(void) {
+	lora_trace_dump(&lr1121);
+}
@@ -2,6 +2,13 @@
 #define STORMWATER_DRONE_LORA_H
 
 #include "lr1121_config.h"
+#include "stormwater_drone_lora_adr.h"
+#include "stormwater_drone_lora_airtime.h"
+#include "stormwater_drone_lora_arq.h"
+#include "stormwater_drone_lora_stats.h"
+#include "stormwater_drone_lora_tdma.h"
+
+#include "freertos/FreeRTOS.h"
 
 // ESP GPIO PINS
 #define ESP_CS			(GPIO_NUM_18)
@@ -19,42 +26,352 @@
 // LR11XX IRQ
 #define IRQ_MASK                                                                          \
     ( LR11XX_SYSTEM_IRQ_TX_DONE | LR11XX_SYSTEM_IRQ_RX_DONE | LR11XX_SYSTEM_IRQ_TIMEOUT | \
-      LR11XX_SYSTEM_IRQ_HEADER_ERROR | LR11XX_SYSTEM_IRQ_CRC_ERROR | LR11XX_SYSTEM_IRQ_FSK_LEN_ERROR )
+      LR11XX_SYSTEM_IRQ_HEADER_ERROR | LR11XX_SYSTEM_IRQ_CRC_ERROR | LR11XX_SYSTEM_IRQ_FSK_LEN_ERROR | \
+      LR11XX_SYSTEM_IRQ_CAD_DONE | LR11XX_SYSTEM_IRQ_CAD_DETECTED )
 
 // LR11XX APP SETTINGS
+#ifndef IS_HOST
 #define IS_HOST			false
+#endif
 #define RX_TIMEOUT_VALUE	RX_CONTINUOUS
 #define TX_TIMEOUT_VALUE	
-#define PACKET_PREFIX_SIZE	0
+#define PACKET_PREFIX_SIZE	(ARQ_ENABLED ? ARQ_HEADER_LENGTH : 0)
+#define LORA_MAX_PAYLOAD_LENGTH	64
+#define LORA_MAX_FRAME_LENGTH	(LORA_MAX_PAYLOAD_LENGTH - PACKET_PREFIX_SIZE)
 #define SYNC_PACKET_THRESHOLD	64
 #define TX_RX_TRANSITION_DELAY	10  // ms
 #define ITERATION_DELAY		1000  // ms
+#define REPLY_TURNAROUND_DELAY	5  // ms, drone rx done -> reply tx
+#define PEER_REPLY_DELAY	(IS_HOST ? REPLY_TURNAROUND_DELAY : ITERATION_DELAY)
+
+// LORA LINK MODE
+// SOFTWARE: host issues every set_rx/set_tx over spi
+// AUTO_TXRX: LR11XX sequencer does tx->rx (host) and rx->tx (drone) itself
+#define LORA_LINK_MODE_SOFTWARE		0
+#define LORA_LINK_MODE_AUTO_TXRX	1
+#ifndef LORA_LINK_MODE
+#define LORA_LINK_MODE			LORA_LINK_MODE_SOFTWARE
+#endif
+#define AUTO_TXRX_INTERMEDIARY_MODE	LR11XX_RADIO_MODE_FS
+#define AUTO_TXRX_TX_RX_DELAY_US	0  // host tx done -> rx
+
+// LORA CHANNEL ACTIVITY DETECTION (LoRa packets, LORA_LINK_MODE_SOFTWARE)
+// CAD_LISTEN: drone stays in standby and sniffs for a preamble every CAD_LISTEN_PERIOD,
+//   opening an rx window only on detection. both ends then send a preamble longer
+//   than the period (recomputed per sf/bw) so a sniff always lands in one
+// CAD_LBT: ctrlr runs cad before each transmission, the radio sends on its own if the
+//   channel is clear, otherwise we back off and try again
+#define CAD_LISTEN_ENABLED	false
+#define CAD_LISTEN_PERIOD	100  // ms
+#define CAD_LBT_ENABLED		false
+#define CAD_LBT_BACKOFF_MAX	50  // ms, random backoff after a busy channel
+#define CAD_LBT_MAX_ATTEMPTS	8  // busy results before sending anyway
+
+// DRONE RX DUTY CYCLE (LoRa packets, LORA_LINK_MODE_SOFTWARE, not with CAD_LISTEN)
+// the radio alternates RX_DUTY_CYCLE_RX_SYMBOLS of rx with RX_DUTY_CYCLE_SLEEP_PERIOD of
+// sleep on its own and only raises DIO for a packet. with CONFIG_PM_ENABLE the ESP32
+// light sleeps in between. both ends send a preamble covering a whole cycle, recomputed
+// per sf/bw; the host leaves the radio alone while it cycles
+#define RX_DUTY_CYCLE_ENABLED		false
+#define RX_DUTY_CYCLE_RX_SYMBOLS	8
+#define RX_DUTY_CYCLE_SLEEP_PERIOD	500  // ms
+
+// LORA TDMA (see stormwater_drone_lora_tdma.h)
+#define TDMA_UPLINK_LENGTH	LORA_MAX_PAYLOAD_LENGTH  // slot fits the largest drone uplink
+
+// LORA RADIO TASK
+#define LORA_TASK_STACK_SIZE	4096
+#define LORA_TASK_PRIORITY	5
+
+// LORA WORK TASK
+// the radio task only services the radio; handing frames to the app, callbacks and
+// logging run here, below it, so the next radio state never waits on them
+#define LORA_WORK_TASK_STACK_SIZE	3072
+#define LORA_WORK_TASK_PRIORITY		4
+#define LORA_WORK_QUEUE_LENGTH		16	// events, power of two; frames get one entry per pool slot
+
+// LORA RX FRAME POOL
+#define LORA_RX_POOL_SIZE	8	// frames the app may hold or have queued at once, power of two, up to 32
+
+// LORA TX QUEUE
+#define LORA_TX_QUEUE_LENGTH	8	// frames submitted and not yet taken by the radio task, power of two
+
+/*!
+ * @brief latency from LR11XX DIO irq edge to the radio task waking (in us)
+ */
+typedef struct stormwater_drone_lora_irq_latency_s {
+	uint32_t last_us;
+	uint32_t max_us;
+	uint32_t avg_us;
+	uint32_t count;
+} stormwater_drone_lora_irq_latency_t;
+
+/*!
+ * @brief link timing for the current radio profile, rebuilt on init, adr rate change
+ * and reconfigure so the irq path only does table lookups
+ */
+typedef struct stormwater_drone_lora_link_timing_s {
+	uint32_t toa_us[LORA_MAX_PAYLOAD_LENGTH + 1];		// time on air, indexed by payload length
+	uint32_t rx_window_rtc[LORA_MAX_PAYLOAD_LENGTH + 1];	// rx timeout after sending that many bytes
+	uint32_t reply_delay_rtc;				// rx done -> reply (auto tx/rx mode)
+	uint32_t cad_rx_window_rtc;				// rx after a cad detection (CAD_LISTEN)
+	uint32_t symbol_us;					// LoRa symbol time, 0 for GFSK
+	uint32_t duty_cycle_rx_rtc;				// RX_DUTY_CYCLE listen window
+	uint32_t duty_cycle_sleep_rtc;
+} stormwater_drone_lora_link_timing_t;
+
+/*!
+ * @brief received frame, owned by the app from stormwater_drone_lora_receive (or
+ * the on_rx callback) until stormwater_drone_lora_release
+ *
+ * the radio reads the packet straight into data; frame points past the link header
+ */
+typedef struct stormwater_drone_lora_rx_frame_s {
+	const uint8_t* frame;
+	uint8_t frame_length;
+	int8_t rssi_dbm;
+	int8_t snr_db;
+	int64_t timestamp_us;		// irq edge of the rx done
+	uint8_t data[LORA_MAX_PAYLOAD_LENGTH];
+} stormwater_drone_lora_rx_frame_t;
+
+typedef struct stormwater_drone_lora_cad_stats_s {
+	uint32_t sniffs;		// drone: cad runs while listening
+	uint32_t detections;		// drone: preambles detected, each opens an rx window
+	uint32_t false_wakes;		// drone: rx windows that ended without a packet
+	uint32_t lbt_clear;		// ctrlr: transmissions started on a clear channel
+	uint32_t lbt_busy;		// ctrlr: cad found the channel busy
+	uint32_t lbt_forced;		// ctrlr: sent after CAD_LBT_MAX_ATTEMPTS busy results
+} stormwater_drone_lora_cad_stats_t;
+
+typedef struct stormwater_drone_lora_rx_stats_s {
+	uint32_t delivered;		// frames queued to the app
+	uint32_t overruns;		// packets received with every slot taken (left unacked with arq)
+	uint8_t in_use_max;		// most slots held or queued at once
+} stormwater_drone_lora_rx_stats_t;
 
 /*!
- * @brief packet to be sent of length PAYLOAD_LENGTH (in bytes)
+ * @brief link events, passed to the callbacks from the work task
  */
-extern uint8_t stormwater_drone_lora_send_packet[];
+typedef enum stormwater_drone_lora_event_e {
+	STORMWATER_DRONE_LORA_EVENT_TX_DONE,
+	STORMWATER_DRONE_LORA_EVENT_RX_TIMEOUT,		// host: drone did not reply
+	STORMWATER_DRONE_LORA_EVENT_CRC_ERROR,
+	STORMWATER_DRONE_LORA_EVENT_HEADER_ERROR,
+	STORMWATER_DRONE_LORA_EVENT_LEN_ERROR,		// GFSK length error
+	STORMWATER_DRONE_LORA_EVENT_OVERSIZE,		// payload larger than LORA_MAX_PAYLOAD_LENGTH
+	STORMWATER_DRONE_LORA_EVENT_RX_OVERRUN,		// frame received with the pool empty
+	STORMWATER_DRONE_LORA_EVENT_RECONFIGURED,
+} stormwater_drone_lora_event_t;
 
 /*!
- * @brief packet to be sent of length PAYLOAD_LENGTH (in bytes)
+ * @brief app hooks, all optional, run one at a time in the work task
+ *
+ * keep them short: the work task holds later frames and events until they return.
+ * they may call any stormwater_drone_lora function
  */
-extern uint8_t stormwater_drone_lora_receive_packet[];
+typedef struct stormwater_drone_lora_callbacks_s {
+	// new frame, owned by the callee until stormwater_drone_lora_release; when
+	// NULL frames queue for stormwater_drone_lora_receive instead
+	void (*on_rx)(stormwater_drone_lora_rx_frame_t* frame, void* context);
+	void (*on_tx_done)(void* context);
+	void (*on_timeout)(void* context);
+	// crc, header, length, oversize and overrun events
+	void (*on_error)(stormwater_drone_lora_event_t event, void* context);
+	void* context;
+} stormwater_drone_lora_callbacks_t;
 
 /*!
- * @brief interrupt detect flag
+ * @brief radio level counters, kept by the radio task
+ *
+ * like the rx, cad and work counters each is a single word read while the radio
+ * task runs on: a copy has every counter whole, but one may be a packet ahead of
+ * another. rate, irq latency, link timing and tdma stats are copied consistently
  */
-extern bool stormwater_drone_lora_irq_flag;
+typedef struct stormwater_drone_lora_link_stats_s {
+	uint32_t tx_done;
+	uint32_t rx_done;		// clean packets, duplicates included
+	uint32_t rx_timeouts;
+	uint32_t crc_errors;
+	uint32_t header_errors;
+	uint32_t len_errors;
+} stormwater_drone_lora_link_stats_t;
 
+typedef struct stormwater_drone_lora_work_stats_s {
+	uint32_t posted;		// work items queued by the radio task
+	uint32_t dropped;		// events lost to a full queue
+	uint8_t depth_max;		// most items waiting at once, both priorities
+} stormwater_drone_lora_work_stats_t;
 
 /*!
- * @brief initialize lora module and interrupt service routine
+ * @brief register the app hooks, copied; call before stormwater_drone_lora_init
+ */
+void stormwater_drone_lora_set_callbacks(const stormwater_drone_lora_callbacks_t* callbacks);
+
+/*!
+ * @brief initialize lora module, interrupt service routine and radio task
+ *
+ * the radio task starts the link and from then on is the only task driving the
+ * radio: it blocks until the isr notifies it, then reads/writes packets; delivery
+ * to the app and logging are deferred to the work task
  */
 void stormwater_drone_lora_init(void);
 
 /*!
- * @brief when flag boolean set, start interrupt process; reads/writes packets
+ * @brief buffer to build the next frame in, LORA_MAX_FRAME_LENGTH bytes
+ *
+ * owned by the caller (a single producer task) until stormwater_drone_lora_submit;
+ * the radio task never reads it while it is being filled. tasks sharing the link
+ * use stormwater_drone_lora_send instead
+ */
+uint8_t* stormwater_drone_lora_send_buffer(void);
+
+/*!
+ * @brief hand length bytes of the send buffer to the link
+ *
+ * the frame is copied into a queue of LORA_TX_QUEUE_LENGTH; returns false (frame
+ * not taken) while it is full. with ARQ_ENABLED frames move from the queue into the
+ * arq window, are sent once and repeated only if the peer does not ack them. without
+ * arq each frame is sent once, in order, and the last one is sent again on exchanges
+ * with nothing newer queued; none is dropped unsent. the send buffer may be
+ * refilled as soon as this returns
+ */
+bool stormwater_drone_lora_submit(uint8_t length);
+
+/*!
+ * @brief copy a frame in and submit it, safe from any number of tasks
+ *
+ * producers take turns on a mutex the radio task never touches; same queueing and
+ * return value as stormwater_drone_lora_submit
+ */
+bool stormwater_drone_lora_send(const uint8_t* frame, uint8_t length);
+
+/*!
+ * @brief take the oldest new frame received (duplicates dropped by arq)
+ *
+ * blocks up to timeout ticks; returns NULL if nothing arrived. the frame must be
+ * handed back with stormwater_drone_lora_release
+ */
+stormwater_drone_lora_rx_frame_t* stormwater_drone_lora_receive(TickType_t timeout);
+
+/*!
+ * @brief return a frame from stormwater_drone_lora_receive or on_rx to the pool
+ */
+void stormwater_drone_lora_release(stormwater_drone_lora_rx_frame_t* frame);
+
+/*!
+ * @brief copy out tx done, rx done, timeout and error counters
+ */
+void stormwater_drone_lora_get_link_stats(stormwater_drone_lora_link_stats_t* stats);
+
+/*!
+ * @brief rolling link quality: PER, RSSI/SNR, retries, round trips and airtime
+ */
+void stormwater_drone_lora_get_link_quality(stormwater_drone_lora_link_quality_t* quality);
+
+/*!
+ * @brief pack the current link quality into a STORMWATER_FRAME_TYPE_LINK_STATS frame
+ * for sending over the link itself
+ *
+ * @returns bytes written (STORMWATER_FRAME_LENGTH), or 0 if buf is too small
+ */
+size_t stormwater_drone_lora_encode_link_stats(uint8_t addr, uint8_t seq, uint8_t* buf, size_t buf_length);
+
+/*!
+ * @brief airtime used in the budget window and transmissions held back for it
+ */
+void stormwater_drone_lora_get_airtime_stats(stormwater_drone_lora_airtime_stats_t* stats);
+
+/*!
+ * @brief copy out rx frame pool counters
+ */
+void stormwater_drone_lora_get_rx_stats(stormwater_drone_lora_rx_stats_t* stats);
+
+/*!
+ * @brief copy out arq counters
+ */
+void stormwater_drone_lora_get_arq_stats(stormwater_drone_lora_arq_stats_t* stats);
+
+/*!
+ * @brief set delay between rx done and the scheduled reply (0 replies immediately)
+ *
+ * defaults to REPLY_TURNAROUND_DELAY on the drone and ITERATION_DELAY on the host.
+ * the radio task takes it up from the next reply on. the peer's rx window has to
+ * cover it: raise the peer's stormwater_drone_lora_set_peer_reply_delay to match
+ */
+void stormwater_drone_lora_set_reply_delay(uint32_t delay_ms);
+
+/*!
+ * @brief set the longest the peer waits between our packet and its reply
+ *
+ * sizes the rx window opened after each tx; defaults to PEER_REPLY_DELAY, the
+ * peer's default reply delay
+ */
+void stormwater_drone_lora_set_peer_reply_delay(uint32_t delay_ms);
+
+/*!
+ * @brief switch radio profile without a full lora_system_init
+ *
+ * only parameters that differ from the current ones are sent to the radio; the radio
+ * task applies the config, resets adr to the new sf/bw/power and restarts the link.
+ * on a GFSK profile adr, cad and rx duty cycling are suspended until the link is
+ * back on LoRa. both ends must switch to the same profile. returns false if config
+ * is invalid
+ */
+bool stormwater_drone_lora_reconfigure(const lora_radio_config_t* config);
+
+/*!
+ * @brief copy out the radio parameters currently in use
+ */
+void stormwater_drone_lora_get_config(lora_radio_config_t* config);
+
+/*!
+ * @brief set own frame address; a drone answers tdma beacons in slot (address - 1)
+ */
+void stormwater_drone_lora_set_address(uint8_t address);
+
+/*!
+ * @brief copy out ctrlr tdma per-drone counters
+ */
+void stormwater_drone_lora_get_tdma_stats(stormwater_drone_lora_tdma_stats_t* stats);
+
+/*!
+ * @brief spreading factor and tx power currently in use (adr may change them)
+ */
+void stormwater_drone_lora_get_rate(stormwater_drone_lora_rate_t* rate);
+
+/*!
+ * @brief copy out the cached link timing; rtc values are in LR11XX rtc steps (1/32768 s)
+ */
+void stormwater_drone_lora_get_link_timing(stormwater_drone_lora_link_timing_t* timing);
+
+/*!
+ * @brief copy out irq edge-to-task latency statistics
+ */
+void stormwater_drone_lora_get_irq_latency(stormwater_drone_lora_irq_latency_t* latency);
+
+/*!
+ * @brief copy out channel activity detection counters
+ */
+void stormwater_drone_lora_get_cad_stats(stormwater_drone_lora_cad_stats_t* stats);
+
+/*!
+ * @brief copy out work task counters
+ */
+void stormwater_drone_lora_get_work_stats(stormwater_drone_lora_work_stats_t* stats);
+
+/*!
+ * @brief copy out per-opcode time spent waiting on the LR11XX BUSY line
+ *
+ * @returns number of opcodes written, at most max_count
+ */
+uint8_t stormwater_drone_lora_get_busy_stats(lora_busy_stats_t* stats, uint8_t max_count);
+
+/*!
+ * @brief print the LR11XX SPI trace since the last dump, for tools/lr11xx_trace.py.
+ * no-op unless USE_LR11XX_SPI_TRACE is defined in esp_lora_1121.h
  */
-void stormwater_drone_lora_irq_process(void);
+void stormwater_drone_lora_trace_dump(void);
 
 
 #endif
@@ -0,0 +1,87 @@
+#include "stormwater_drone_lora_adr.h"
+#include "lr1121_config.h"
+
+// --- PRIVATE DEFS AND METHODS ---
+
+static stormwater_drone_lora_rate_t adr_current;
+static int8_t adr_snr_min;
+static uint8_t adr_packets = 0;
+
+// lowest snr (in 0.1 dB) each sf can demodulate: sf7 -7.5 dB ... sf12 -20 dB
+static int16_t snr_floor_tenths(uint8_t sf) {
+	return -25 * (sf - 4);
+}
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_adr_reset(const stormwater_drone_lora_rate_t* current) {
+	adr_current = *current;
+	adr_snr_min = INT8_MAX;
+	adr_packets = 0;
+}
+
+void stormwater_drone_lora_adr_on_packet(int8_t rssi_dbm, int8_t snr_db) {
+	// decide on the worst packet of the window, not the average
+	if(snr_db < adr_snr_min) {
+		adr_snr_min = snr_db;
+	}
+	if(adr_packets < UINT8_MAX) {
+		adr_packets++;
+	}
+}
+
+bool stormwater_drone_lora_adr_propose(stormwater_drone_lora_rate_t* proposal) {
+	if(adr_packets < ADR_WINDOW) {
+		return false;
+	}
+
+	int16_t margin_tenths = adr_snr_min * 10 - snr_floor_tenths(adr_current.sf) - ADR_MARGIN_DB * 10;
+	int16_t steps = margin_tenths >= 0 ? margin_tenths / (ADR_STEP_DB * 10) :
+		-((-margin_tenths + ADR_STEP_DB * 10 - 1) / (ADR_STEP_DB * 10));
+	stormwater_drone_lora_rate_t rate = adr_current;
+
+	/*
+	 * spare margin: faster sf first, then wider bw (both halve the airtime), then less
+	 * power. doubling the bw doubles the noise in band, so it costs the snr about what
+	 * one sf step does
+	 */
+	while(steps > 0 && rate.sf > ADR_SF_MIN) {
+		rate.sf--;
+		steps--;
+	}
+	while(steps > 0 && rate.bw < ADR_BW_MAX) {
+		rate.bw++;
+		steps--;
+	}
+	while(steps > 0 && rate.power_dbm - ADR_STEP_DB >= ADR_POWER_MIN_DBM) {
+		rate.power_dbm -= ADR_STEP_DB;
+		steps--;
+	}
+
+	// missing margin: more power first, then narrower bw, then slower sf
+	while(steps < 0 && rate.power_dbm < ADR_POWER_MAX_DBM) {
+		rate.power_dbm += ADR_STEP_DB;
+		if(rate.power_dbm > ADR_POWER_MAX_DBM) {
+			rate.power_dbm = ADR_POWER_MAX_DBM;
+		}
+		steps++;
+	}
+	while(steps < 0 && rate.bw > ADR_BW_MIN) {
+		rate.bw--;
+		steps++;
+	}
+	while(steps < 0 && rate.sf < ADR_SF_MAX) {
+		rate.sf++;
+		steps++;
+	}
+
+	// start a fresh window either way
+	adr_snr_min = INT8_MAX;
+	adr_packets = 0;
+
+	if(rate.sf == adr_current.sf && rate.bw == adr_current.bw && rate.power_dbm == adr_current.power_dbm) {
+		return false;
+	}
+	*proposal = rate;
+	return true;
+}
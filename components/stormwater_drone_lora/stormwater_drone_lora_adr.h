@@ -0,0 +1,48 @@
+#ifndef STORMWATER_DRONE_LORA_ADR_H
+#define STORMWATER_DRONE_LORA_ADR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ADR SETTINGS
+#define ADR_ENABLED		true
+#define ADR_WINDOW		8	// uplink packets between decisions
+#define ADR_MARGIN_DB		10	// snr kept above the demod floor
+#define ADR_STEP_DB		3	// margin per sf, bw or power step
+#define ADR_SF_MIN		7
+#define ADR_SF_MAX		12
+// bw codes 62.5..500 kHz are consecutive, one code is one doubling. keep ADR_BW_MAX
+// within the channel width the band plan allows
+#define ADR_BW_MIN		LORA_BANDWIDTH
+#define ADR_BW_MAX		LR11XX_RADIO_LORA_BW_250
+#define ADR_POWER_MIN_DBM	2
+#define ADR_POWER_MAX_DBM	TX_OUTPUT_POWER_DBM
+#define ADR_FALLBACK_TIMEOUT	10000	// ms without a valid packet before reverting to defaults
+
+/*!
+ * @brief spreading factor, bandwidth and tx power negotiated by adr
+ */
+typedef struct stormwater_drone_lora_rate_s {
+	uint8_t sf;
+	uint8_t bw;	// lr11xx_radio_lora_bw_t
+	int8_t power_dbm;
+} stormwater_drone_lora_rate_t;
+
+/*!
+ * @brief reset adr history and set the rate currently in use
+ */
+void stormwater_drone_lora_adr_reset(const stormwater_drone_lora_rate_t* current);
+
+/*!
+ * @brief feed link quality of a received packet
+ */
+void stormwater_drone_lora_adr_on_packet(int8_t rssi_dbm, int8_t snr_db);
+
+/*!
+ * @brief propose a new rate once ADR_WINDOW packets have been seen
+ *
+ * @returns true if the proposed rate differs from the current one
+ */
+bool stormwater_drone_lora_adr_propose(stormwater_drone_lora_rate_t* proposal);
+
+#endif
@@ -0,0 +1,72 @@
+#include "stormwater_drone_lora_airtime.h"
+
+#include "stormwater_drone_lora_buckets.h"
+#include "freertos/FreeRTOS.h"
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define BUCKET_US		((int64_t)AIRTIME_WINDOW_MS * 1000 / AIRTIME_BUCKETS)
+#define BUDGET_US		((uint32_t)((uint64_t)AIRTIME_WINDOW_MS * AIRTIME_BUDGET_PERMILLE))
+#define BULK_US			((uint32_t)((uint64_t)AIRTIME_WINDOW_MS * AIRTIME_BULK_PERMILLE))
+
+// updated by the radio task, read by the app
+static portMUX_TYPE airtime_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// time on air per bucket
+static stormwater_drone_lora_bucket_t buckets[AIRTIME_BUCKETS];
+static stormwater_drone_lora_buckets_t window;
+
+static uint32_t airtime_deferred = 0;
+static uint32_t airtime_demoted = 0;
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_airtime_reset(void) {
+	portENTER_CRITICAL(&airtime_lock);
+	stormwater_drone_lora_buckets_init(&window, buckets, AIRTIME_BUCKETS, BUCKET_US);
+	airtime_deferred = 0;
+	airtime_demoted = 0;
+	portEXIT_CRITICAL(&airtime_lock);
+}
+
+void stormwater_drone_lora_airtime_add(int64_t now_us, uint32_t toa_us) {
+	portENTER_CRITICAL(&airtime_lock);
+	stormwater_drone_lora_buckets_add(&window, now_us, toa_us);
+	portEXIT_CRITICAL(&airtime_lock);
+}
+
+uint32_t stormwater_drone_lora_airtime_wait_us(int64_t now_us, uint32_t toa_us, bool bulk) {
+	uint32_t limit_us = bulk ? BULK_US : BUDGET_US;
+	uint32_t used_us;
+	uint32_t wait_us = 0;
+
+	portENTER_CRITICAL(&airtime_lock);
+	used_us = stormwater_drone_lora_buckets_sum(&window, now_us);
+	// a packet longer than the whole budget still goes once the window is empty
+	if(used_us + toa_us > limit_us && used_us != 0) {
+		wait_us = stormwater_drone_lora_buckets_expire_us(&window, now_us, used_us + toa_us - limit_us);
+	}
+	portEXIT_CRITICAL(&airtime_lock);
+	return wait_us;
+}
+
+void stormwater_drone_lora_airtime_on_deferred(void) {
+	portENTER_CRITICAL(&airtime_lock);
+	airtime_deferred++;
+	portEXIT_CRITICAL(&airtime_lock);
+}
+
+void stormwater_drone_lora_airtime_on_demoted(void) {
+	portENTER_CRITICAL(&airtime_lock);
+	airtime_demoted++;
+	portEXIT_CRITICAL(&airtime_lock);
+}
+
+void stormwater_drone_lora_airtime_get_stats(stormwater_drone_lora_airtime_stats_t* stats, int64_t now_us) {
+	portENTER_CRITICAL(&airtime_lock);
+	stats->used_us = stormwater_drone_lora_buckets_sum(&window, now_us);
+	stats->budget_us = BUDGET_US;
+	stats->deferred = airtime_deferred;
+	stats->demoted = airtime_demoted;
+	portEXIT_CRITICAL(&airtime_lock);
+}
@@ -0,0 +1,62 @@
+#ifndef STORMWATER_DRONE_LORA_AIRTIME_H
+#define STORMWATER_DRONE_LORA_AIRTIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * airtime accountant: time on air over a sliding AIRTIME_WINDOW_MS, kept in
+ * AIRTIME_BUCKETS buckets, against a duty cycle budget. US915 (RF_FREQ_IN_HZ) sets
+ * no duty cycle, the default only caps our share of the channel; most EU868
+ * sub-bands allow 1 % (see SIGFOX_RC in lr1121_config.h), set 10 and 8 there
+ *
+ * bulk data may use AIRTIME_BULK_PERMILLE of the window; the rest of the budget
+ * is kept for control frames and acks, so a drone over its bulk share still
+ * acks the ctrlr and the ctrlr can still command it
+ */
+
+// AIRTIME BUDGET SETTINGS
+#ifndef AIRTIME_BUDGET_ENABLED
+#define AIRTIME_BUDGET_ENABLED		true
+#endif
+#define AIRTIME_WINDOW_MS		3600000	// one hour
+#define AIRTIME_BUCKETS			60	// the window slides a bucket (a minute) at a time
+#define AIRTIME_BUDGET_PERMILLE		100	// 10 % duty cycle
+#define AIRTIME_BULK_PERMILLE		80	// bulk data stops here
+
+typedef struct stormwater_drone_lora_airtime_stats_s {
+	uint32_t used_us;		// on air in the current window
+	uint32_t budget_us;		// AIRTIME_BUDGET_PERMILLE of the window
+	uint32_t deferred;		// transmissions held back for budget
+	uint32_t demoted;		// bulk packets sent as acks only
+} stormwater_drone_lora_airtime_stats_t;
+
+/*!
+ * @brief empty window
+ */
+void stormwater_drone_lora_airtime_reset(void);
+
+/*!
+ * @brief account a transmission of toa_us that ended at now_us
+ */
+void stormwater_drone_lora_airtime_add(int64_t now_us, uint32_t toa_us);
+
+/*!
+ * @brief how long a toa_us transmission has to wait to stay within budget
+ *
+ * @param [in] bulk bulk data, held to AIRTIME_BULK_PERMILLE
+ *
+ * @returns 0 if it may go now, else us until enough of the window has slid out
+ */
+uint32_t stormwater_drone_lora_airtime_wait_us(int64_t now_us, uint32_t toa_us, bool bulk);
+
+/*!
+ * @brief count a transmission deferred or demoted by the caller
+ */
+void stormwater_drone_lora_airtime_on_deferred(void);
+
+void stormwater_drone_lora_airtime_on_demoted(void);
+
+void stormwater_drone_lora_airtime_get_stats(stormwater_drone_lora_airtime_stats_t* stats, int64_t now_us);
+
+#endif
@@ -0,0 +1,221 @@
+#include "stormwater_drone_lora_arq.h"
+
+#include <string.h>
+
+// --- PRIVATE DEFS AND METHODS ---
+
+typedef struct arq_entry_s {
+	uint8_t seq;
+	uint8_t length;
+	bool sent;		// cleared again when the peer's ack shows it was lost
+	bool acked;		// acked out of order, dropped once it reaches the front
+	uint8_t transmissions;
+	uint8_t frame[ARQ_MAX_FRAME_LENGTH];
+} arq_entry_t;
+
+// sender: ring of unacknowledged frames, oldest at tx_head
+static arq_entry_t tx_window[ARQ_WINDOW];
+static uint8_t tx_head = 0;
+static uint8_t tx_count = 0;
+static uint8_t tx_next_seq = 0;
+static arq_entry_t tx_last;		// repeated when the window is empty
+static uint8_t tx_epoch = 0;
+
+// receiver: everything before rx_next delivered, rx_bitmap bit n = rx_next + 1 + n
+static uint8_t rx_next = 0;
+static uint8_t rx_bitmap = 0;
+static uint8_t rx_epoch = 0;		// 0 until the peer is heard
+
+static stormwater_drone_lora_arq_stats_t arq_stats;
+
+// sequence distance b - a, negative if b is older
+static int16_t seq_diff(uint8_t a, uint8_t b) {
+	return (int8_t)(uint8_t)(b - a);
+}
+
+static arq_entry_t* tx_entry(uint8_t i) {
+	return &tx_window[(tx_head + i) % ARQ_WINDOW];
+}
+
+static bool is_acked(uint8_t seq, uint8_t ack, uint8_t bitmap) {
+	int16_t d = seq_diff(ack, seq);
+
+	if(d < 0) {
+		return true;
+	}
+	return d >= 1 && d <= 8 && (bitmap & (1 << (d - 1)));
+}
+
+static void on_ack(uint8_t ack, uint8_t bitmap, bool covers_last_tx) {
+	for(uint8_t i = 0; i < tx_count; i++) {
+		arq_entry_t* entry = tx_entry(i);
+
+		if(is_acked(entry->seq, ack, bitmap)) {
+			entry->acked = true;
+		}
+		else if(covers_last_tx || entry->seq != tx_last.seq) {
+			// selective repeat: only the frames the peer is missing go again
+			entry->sent = false;
+		}
+	}
+	while(tx_count > 0 && tx_entry(0)->acked) {
+		tx_head = (tx_head + 1) % ARQ_WINDOW;
+		tx_count--;
+		arq_stats.acked++;
+	}
+}
+
+// the peer holds nothing older than base: move past it, then over frames received since
+static void on_base(uint8_t base) {
+	bool received = false;
+
+	while(seq_diff(rx_next, base) > 0 || received) {
+		received = rx_bitmap & 1;
+		rx_bitmap >>= 1;
+		rx_next++;
+	}
+}
+
+static bool on_frame(uint8_t seq) {
+	int16_t d = seq_diff(rx_next, seq);
+
+	if(d < 0 || (d >= 1 && d <= 8 && (rx_bitmap & (1 << (d - 1))))) {
+		return false;
+	}
+	if(d > 8) {
+		// peer moved past what we can track; resync on this frame
+		rx_next = seq;
+		rx_bitmap = 0;
+		d = 0;
+	}
+	if(d > 0) {
+		rx_bitmap |= (uint8_t)(1 << (d - 1));
+		return true;
+	}
+
+	// in order: advance over it and any frames already received after it
+	bool received;
+	do {
+		received = rx_bitmap & 1;
+		rx_bitmap >>= 1;
+		rx_next++;
+	} while(received);
+	return true;
+}
+
+// lost or unsent frames first, oldest first; if the ack never came, the oldest again
+static arq_entry_t* pick_next(void) {
+	for(uint8_t i = 0; i < tx_count; i++) {
+		if(!tx_entry(i)->sent && !tx_entry(i)->acked) {
+			return tx_entry(i);
+		}
+	}
+	return tx_count > 0 ? tx_entry(0) : NULL;
+}
+
+static uint8_t build_packet(uint8_t* packet, const arq_entry_t* entry) {
+	packet[0] = (uint8_t)(tx_epoch << 4 | rx_epoch);
+	packet[1] = entry->seq;
+	packet[2] = rx_next;
+	packet[3] = rx_bitmap;
+	packet[4] = tx_count > 0 ? tx_entry(0)->seq : tx_next_seq;
+	memcpy(packet + ARQ_HEADER_LENGTH, entry->frame, entry->length);
+	return ARQ_HEADER_LENGTH + entry->length;
+}
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_arq_reset(uint8_t epoch) {
+	tx_head = 0;
+	tx_count = 0;
+	tx_next_seq = 0;
+	tx_last.length = 0;
+	tx_epoch = epoch & 0x0F;
+	rx_next = 0;
+	rx_bitmap = 0;
+	rx_epoch = 0;
+	memset(&arq_stats, 0, sizeof(arq_stats));
+}
+
+bool stormwater_drone_lora_arq_push(const uint8_t* frame, uint8_t length) {
+	if(tx_count == ARQ_WINDOW || length == 0 || length > ARQ_MAX_FRAME_LENGTH) {
+		return false;
+	}
+
+	arq_entry_t* entry = tx_entry(tx_count);
+	entry->seq = tx_next_seq++;
+	entry->length = length;
+	entry->sent = false;
+	entry->acked = false;
+	entry->transmissions = 0;
+	memcpy(entry->frame, frame, length);
+	tx_count++;
+	return true;
+}
+
+uint8_t stormwater_drone_lora_arq_next(uint8_t* packet) {
+	arq_entry_t* entry = pick_next();
+
+	if(entry != NULL) {
+		if(entry->transmissions++ == 0) {
+			arq_stats.sent++;
+		}
+		else {
+			arq_stats.retransmitted++;
+		}
+		entry->sent = true;
+		tx_last = *entry;
+	}
+	return build_packet(packet, &tx_last);
+}
+
+uint8_t stormwater_drone_lora_arq_peek(uint8_t* packet) {
+	const arq_entry_t* entry = pick_next();
+
+	return build_packet(packet, entry != NULL ? entry : &tx_last);
+}
+
+uint8_t stormwater_drone_lora_arq_ack(uint8_t* packet) {
+	const arq_entry_t ack = { .seq = tx_last.seq, .length = 0 };
+
+	return build_packet(packet, &ack);
+}
+
+bool stormwater_drone_lora_arq_receive(const uint8_t* packet, uint8_t length, bool covers_last_tx,
+		bool can_deliver, const uint8_t** frame, uint8_t* frame_length) {
+	if(length < ARQ_HEADER_LENGTH) {
+		return false;
+	}
+	*frame = packet + ARQ_HEADER_LENGTH;
+	*frame_length = length - ARQ_HEADER_LENGTH;
+
+	// peer rebooted (or first contact): its sequence numbers start over, at its
+	// window base rather than this frame, which may not be the first unacked one
+	if((packet[0] >> 4) != rx_epoch) {
+		rx_epoch = packet[0] >> 4;
+		rx_next = packet[4];
+		rx_bitmap = 0;
+	}
+	on_base(packet[4]);
+	// acks made before the peer heard this boot refer to old sequence numbers
+	if((packet[0] & 0x0F) == tx_epoch) {
+		on_ack(packet[2], packet[3], covers_last_tx);
+	}
+
+	if(*frame_length == 0) {
+		return false;
+	}
+	if(!can_deliver) {
+		return false;
+	}
+	if(!on_frame(packet[1])) {
+		arq_stats.duplicates++;
+		return false;
+	}
+	arq_stats.delivered++;
+	return true;
+}
+
+void stormwater_drone_lora_arq_get_stats(stormwater_drone_lora_arq_stats_t* stats) {
+	*stats = arq_stats;
+}
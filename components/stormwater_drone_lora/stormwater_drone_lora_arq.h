@@ -0,0 +1,87 @@
+#ifndef STORMWATER_DRONE_LORA_ARQ_H
+#define STORMWATER_DRONE_LORA_ARQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * link header in front of every frame when ARQ_ENABLED:
+ *
+ *   0     epoch (high nibble), random 1..15 per boot; a change resets the peer's
+ *         receive state. low nibble echoes the peer's epoch, 0 until heard, and
+ *         the ack fields are ignored unless it matches
+ *   1     sequence number of this frame
+ *   2     ack: next sequence number expected from the peer (all before it received)
+ *   3     ack bitmap: bit n set = sequence number ack + 1 + n received
+ *   4     window base: oldest sequence number not yet acked to us (the next one to
+ *         be pushed if none). the peer starts receiving from it on first contact
+ *         or a new epoch, so frames lost before that are still asked for
+ *
+ * a packet with nothing but the header only carries acks
+ */
+
+// ARQ SETTINGS
+#ifndef ARQ_ENABLED
+#define ARQ_ENABLED		true
+#endif
+#define ARQ_WINDOW		8	// frames in flight, bounded by the ack bitmap
+#define ARQ_HEADER_LENGTH	5
+#define ARQ_MAX_FRAME_LENGTH	64
+
+typedef struct stormwater_drone_lora_arq_stats_s {
+	uint32_t sent;			// first transmissions
+	uint32_t retransmitted;
+	uint32_t acked;
+	uint32_t delivered;		// new frames passed up
+	uint32_t duplicates;		// frames dropped as already delivered
+} stormwater_drone_lora_arq_stats_t;
+
+/*!
+ * @brief clear both windows; epoch (1..15) identifies this boot to the peer
+ */
+void stormwater_drone_lora_arq_reset(uint8_t epoch);
+
+/*!
+ * @brief queue a frame for transmission
+ *
+ * @returns false if ARQ_WINDOW frames are still unacknowledged
+ */
+bool stormwater_drone_lora_arq_push(const uint8_t* frame, uint8_t length);
+
+/*!
+ * @brief build the next packet: oldest frame needing (re)transmission, else the
+ * last frame again (the peer drops it as a duplicate), else header only
+ *
+ * @returns packet length, at most ARQ_HEADER_LENGTH + ARQ_MAX_FRAME_LENGTH
+ */
+uint8_t stormwater_drone_lora_arq_next(uint8_t* packet);
+
+/*!
+ * @brief build the packet stormwater_drone_lora_arq_next would, without marking
+ * or counting anything; used to stage a reply in the radio ahead of time
+ */
+uint8_t stormwater_drone_lora_arq_peek(uint8_t* packet);
+
+/*!
+ * @brief build a header-only packet carrying our acks; nothing is marked sent, so
+ * a frame held back this way goes out on a later exchange
+ */
+uint8_t stormwater_drone_lora_arq_ack(uint8_t* packet);
+
+/*!
+ * @brief process a received packet's header and find its frame
+ *
+ * @param [in] covers_last_tx the peer sent this after hearing our last packet, so
+ * frames it does not ack were lost
+ * @param [in] can_deliver false when there is nowhere to put a new frame; it is
+ * left unacked so the peer sends it again
+ * @param [out] frame, frame_length payload after the header (also set for duplicates)
+ *
+ * @returns true if the frame is new and should be delivered
+ */
+bool stormwater_drone_lora_arq_receive(const uint8_t* packet, uint8_t length, bool covers_last_tx,
+		bool can_deliver, const uint8_t** frame, uint8_t* frame_length);
+
+void stormwater_drone_lora_arq_get_stats(stormwater_drone_lora_arq_stats_t* stats);
+
+#endif
@@ -0,0 +1,69 @@
+#include "stormwater_drone_lora_buckets.h"
+
+// --- PRIVATE DEFS AND METHODS ---
+
+// epochs before the first bucket (the window reaches back past time 0) are empty
+static uint32_t bucket_get(const stormwater_drone_lora_buckets_t* window, int64_t epoch) {
+	if(epoch < 0) {
+		return 0;
+	}
+	const stormwater_drone_lora_bucket_t* bucket = &window->buckets[epoch % window->count];
+
+	return bucket->epoch == epoch ? bucket->sum : 0;
+}
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_buckets_init(stormwater_drone_lora_buckets_t* window,
+		stormwater_drone_lora_bucket_t* storage, uint8_t count, int64_t width_us) {
+	window->buckets = storage;
+	window->width_us = width_us;
+	window->count = count;
+	stormwater_drone_lora_buckets_reset(window);
+}
+
+void stormwater_drone_lora_buckets_reset(stormwater_drone_lora_buckets_t* window) {
+	for(uint8_t i = 0; i < window->count; i++) {
+		window->buckets[i].epoch = -1;
+		window->buckets[i].sum = 0;
+	}
+}
+
+void stormwater_drone_lora_buckets_add(stormwater_drone_lora_buckets_t* window, int64_t now_us, uint32_t value) {
+	int64_t epoch = now_us / window->width_us;
+	stormwater_drone_lora_bucket_t* bucket = &window->buckets[epoch % window->count];
+
+	if(bucket->epoch != epoch) {
+		bucket->epoch = epoch;
+		bucket->sum = 0;
+	}
+	bucket->sum += value;
+}
+
+uint32_t stormwater_drone_lora_buckets_sum(const stormwater_drone_lora_buckets_t* window, int64_t now_us) {
+	int64_t epoch = now_us / window->width_us;
+	uint32_t sum = 0;
+
+	for(uint8_t i = 0; i < window->count; i++) {
+		if(window->buckets[i].epoch > epoch - window->count) {
+			sum += window->buckets[i].sum;
+		}
+	}
+	return sum;
+}
+
+uint32_t stormwater_drone_lora_buckets_expire_us(const stormwater_drone_lora_buckets_t* window, int64_t now_us,
+		uint32_t amount) {
+	int64_t epoch = now_us / window->width_us;
+	uint32_t held = stormwater_drone_lora_buckets_sum(window, now_us);
+	uint32_t freed = 0;
+
+	// oldest bucket first; bucket k leaves the window when bucket k + count begins
+	for(int64_t k = epoch - window->count + 1; k <= epoch; k++) {
+		freed += bucket_get(window, k);
+		if(freed >= amount || freed == held) {
+			return (uint32_t)((k + window->count) * window->width_us - now_us);
+		}
+	}
+	return (uint32_t)((epoch + window->count) * window->width_us - now_us);
+}
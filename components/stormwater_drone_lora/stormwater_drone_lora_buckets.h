@@ -0,0 +1,51 @@
+#ifndef STORMWATER_DRONE_LORA_BUCKETS_H
+#define STORMWATER_DRONE_LORA_BUCKETS_H
+
+#include <stdint.h>
+
+/*
+ * sliding window sum kept in a ring of time buckets, count buckets of width_us
+ * each; the window slides a bucket at a time. a bucket is tagged with the pass
+ * of the ring it was last written in (now_us / width_us), one from an older pass
+ * counts as empty, so nothing has to be cleared as time moves on
+ *
+ * not locked, callers serialise access
+ */
+
+typedef struct stormwater_drone_lora_bucket_s {
+	int64_t epoch;
+	uint32_t sum;
+} stormwater_drone_lora_bucket_t;
+
+typedef struct stormwater_drone_lora_buckets_s {
+	stormwater_drone_lora_bucket_t* buckets;
+	int64_t width_us;
+	uint8_t count;
+} stormwater_drone_lora_buckets_t;
+
+/*!
+ * @brief empty window over storage for count buckets
+ */
+void stormwater_drone_lora_buckets_init(stormwater_drone_lora_buckets_t* window,
+		stormwater_drone_lora_bucket_t* storage, uint8_t count, int64_t width_us);
+
+void stormwater_drone_lora_buckets_reset(stormwater_drone_lora_buckets_t* window);
+
+/*!
+ * @brief add value to the bucket now_us falls in
+ */
+void stormwater_drone_lora_buckets_add(stormwater_drone_lora_buckets_t* window, int64_t now_us, uint32_t value);
+
+/*!
+ * @returns sum over the window ending with the bucket now_us falls in
+ */
+uint32_t stormwater_drone_lora_buckets_sum(const stormwater_drone_lora_buckets_t* window, int64_t now_us);
+
+/*!
+ * @returns us from now_us until the oldest buckets holding at least amount have
+ * slid out of the window, or all of it if the window holds less
+ */
+uint32_t stormwater_drone_lora_buckets_expire_us(const stormwater_drone_lora_buckets_t* window, int64_t now_us,
+		uint32_t amount);
+
+#endif
@@ -0,0 +1,53 @@
+#include "stormwater_drone_lora_spsc.h"
+
+#include <string.h>
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_spsc_init(stormwater_drone_lora_spsc_t* ring, void* storage, uint16_t item_size,
+		uint16_t capacity) {
+	ring->items = storage;
+	ring->item_size = item_size;
+	ring->capacity = capacity;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+bool stormwater_drone_lora_spsc_push(stormwater_drone_lora_spsc_t* ring, const void* item) {
+	uint16_t head = ring->head;
+	uint16_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if((uint16_t)(head - tail) == ring->capacity) {
+		return false;
+	}
+	memcpy(&ring->items[(head & (ring->capacity - 1)) * ring->item_size], item, ring->item_size);
+	__atomic_store_n(&ring->head, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+	return true;
+}
+
+bool stormwater_drone_lora_spsc_pop(stormwater_drone_lora_spsc_t* ring, void* item) {
+	uint16_t tail = ring->tail;
+	uint16_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if(head == tail) {
+		return false;
+	}
+	memcpy(item, &ring->items[(tail & (ring->capacity - 1)) * ring->item_size], ring->item_size);
+	__atomic_store_n(&ring->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+	return true;
+}
+
+bool stormwater_drone_lora_spsc_peek(const stormwater_drone_lora_spsc_t* ring, void* item) {
+	uint16_t tail = ring->tail;
+	uint16_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if(head == tail) {
+		return false;
+	}
+	memcpy(item, &ring->items[(tail & (ring->capacity - 1)) * ring->item_size], ring->item_size);
+	return true;
+}
+
+uint16_t stormwater_drone_lora_spsc_count(const stormwater_drone_lora_spsc_t* ring) {
+	return (uint16_t)(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
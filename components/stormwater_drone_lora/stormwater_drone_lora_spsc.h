@@ -0,0 +1,57 @@
+#ifndef STORMWATER_DRONE_LORA_SPSC_H
+#define STORMWATER_DRONE_LORA_SPSC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * lock-free ring between exactly one producer task and one consumer task
+ *
+ * items are copied in and out whole. head is only written by the producer and
+ * tail only by the consumer, so neither side takes a lock or enters a critical
+ * section; the release/acquire pair on each index publishes the item with it.
+ * pair a push with a task notification to wake the consumer
+ */
+
+typedef struct stormwater_drone_lora_spsc_s {
+	uint8_t* items;
+	uint16_t item_size;
+	uint16_t capacity;		// power of two
+	uint16_t head;			// free running, producer
+	uint16_t tail;			// free running, consumer
+} stormwater_drone_lora_spsc_t;
+
+/*!
+ * @brief empty ring over storage of capacity * item_size bytes, capacity a power
+ * of two up to 32768
+ */
+void stormwater_drone_lora_spsc_init(stormwater_drone_lora_spsc_t* ring, void* storage, uint16_t item_size,
+		uint16_t capacity);
+
+/*!
+ * @brief producer side
+ *
+ * @returns false if the ring is full, the item is not queued
+ */
+bool stormwater_drone_lora_spsc_push(stormwater_drone_lora_spsc_t* ring, const void* item);
+
+/*!
+ * @brief consumer side
+ *
+ * @returns false if the ring is empty
+ */
+bool stormwater_drone_lora_spsc_pop(stormwater_drone_lora_spsc_t* ring, void* item);
+
+/*!
+ * @brief consumer side: copy the oldest item out and leave it queued
+ *
+ * @returns false if the ring is empty
+ */
+bool stormwater_drone_lora_spsc_peek(const stormwater_drone_lora_spsc_t* ring, void* item);
+
+/*!
+ * @returns items waiting, exact from either side, a snapshot from anywhere else
+ */
+uint16_t stormwater_drone_lora_spsc_count(const stormwater_drone_lora_spsc_t* ring);
+
+#endif
@@ -0,0 +1,224 @@
+#include "stormwater_drone_lora_stats.h"
+
+#include "stormwater_drone_lora_buckets.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define BUCKET_US		((int64_t)LINK_STATS_AIRTIME_BUCKET_MS * 1000)
+
+typedef struct packet_entry_s {
+	bool received;
+	int8_t rssi_dbm;
+	int8_t snr_db;
+} packet_entry_t;
+
+// updated by the radio task, read by the app
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// expected packets, oldest overwritten; the sums cover the received ones
+static packet_entry_t packets[LINK_STATS_WINDOW];
+static uint8_t packet_head = 0;
+static uint8_t packet_count = 0;
+static uint8_t packet_received = 0;
+static int16_t rssi_sum = 0;
+static int16_t snr_sum = 0;
+
+static bool tx_retry[LINK_STATS_WINDOW];
+static uint8_t tx_head = 0;
+static uint8_t tx_count = 0;
+static uint8_t tx_retries = 0;
+
+static uint32_t rtt_window[LINK_STATS_WINDOW];
+static uint8_t rtt_head = 0;
+static uint8_t rtt_count = 0;
+
+// time on air per bucket
+static stormwater_drone_lora_bucket_t airtime_buckets[LINK_STATS_AIRTIME_BUCKETS];
+static stormwater_drone_lora_buckets_t airtime_window;
+static int64_t airtime_start_us = 0;
+
+static uint32_t radio_rx_packets = 0;
+static uint32_t radio_crc_errors = 0;
+static uint32_t radio_header_errors = 0;
+static uint32_t radio_false_syncs = 0;
+
+static void packet_push(bool received, int8_t rssi_dbm, int8_t snr_db) {
+	packet_entry_t* entry = &packets[packet_head];
+
+	if(packet_count == LINK_STATS_WINDOW) {
+		if(entry->received) {
+			packet_received--;
+			rssi_sum -= entry->rssi_dbm;
+			snr_sum -= entry->snr_db;
+		}
+	}
+	else {
+		packet_count++;
+	}
+
+	entry->received = received;
+	entry->rssi_dbm = rssi_dbm;
+	entry->snr_db = snr_db;
+	if(received) {
+		packet_received++;
+		rssi_sum += rssi_dbm;
+		snr_sum += snr_db;
+	}
+	packet_head = (packet_head + 1) % LINK_STATS_WINDOW;
+}
+
+// nearest rank of an ascending array
+static uint32_t percentile(const uint32_t* sorted, uint8_t count, uint8_t percent) {
+	uint16_t rank = ((uint16_t)count * percent + 99) / 100;
+
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_stats_reset(int64_t now_us) {
+	portENTER_CRITICAL(&stats_lock);
+	packet_head = 0;
+	packet_count = 0;
+	packet_received = 0;
+	rssi_sum = 0;
+	snr_sum = 0;
+	tx_head = 0;
+	tx_count = 0;
+	tx_retries = 0;
+	rtt_head = 0;
+	rtt_count = 0;
+	stormwater_drone_lora_buckets_init(&airtime_window, airtime_buckets, LINK_STATS_AIRTIME_BUCKETS, BUCKET_US);
+	airtime_start_us = now_us;
+	radio_rx_packets = 0;
+	radio_crc_errors = 0;
+	radio_header_errors = 0;
+	radio_false_syncs = 0;
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+void stormwater_drone_lora_stats_on_rx(int8_t rssi_dbm, int8_t snr_db) {
+	portENTER_CRITICAL(&stats_lock);
+	packet_push(true, rssi_dbm, snr_db);
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+void stormwater_drone_lora_stats_on_loss(void) {
+	portENTER_CRITICAL(&stats_lock);
+	packet_push(false, 0, 0);
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+void stormwater_drone_lora_stats_on_tx(int64_t now_us, uint32_t toa_us, bool retransmission) {
+	portENTER_CRITICAL(&stats_lock);
+	if(tx_count == LINK_STATS_WINDOW) {
+		if(tx_retry[tx_head]) {
+			tx_retries--;
+		}
+	}
+	else {
+		tx_count++;
+	}
+	tx_retry[tx_head] = retransmission;
+	if(retransmission) {
+		tx_retries++;
+	}
+	tx_head = (tx_head + 1) % LINK_STATS_WINDOW;
+
+	stormwater_drone_lora_buckets_add(&airtime_window, now_us, toa_us);
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+void stormwater_drone_lora_stats_on_rtt(uint32_t rtt_us) {
+	portENTER_CRITICAL(&stats_lock);
+	rtt_window[rtt_head] = rtt_us;
+	rtt_head = (rtt_head + 1) % LINK_STATS_WINDOW;
+	if(rtt_count < LINK_STATS_WINDOW) {
+		rtt_count++;
+	}
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+void stormwater_drone_lora_stats_on_radio(uint16_t rx_packets, uint16_t crc_errors, uint16_t header_errors,
+		uint16_t false_syncs) {
+	portENTER_CRITICAL(&stats_lock);
+	radio_rx_packets += rx_packets;
+	radio_crc_errors += crc_errors;
+	radio_header_errors += header_errors;
+	radio_false_syncs += false_syncs;
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+void stormwater_drone_lora_stats_get(stormwater_drone_lora_link_quality_t* quality, int64_t now_us) {
+	uint32_t sorted[LINK_STATS_WINDOW];
+	int64_t epoch = now_us / BUCKET_US;
+	int64_t window_us = now_us - (epoch - LINK_STATS_AIRTIME_BUCKETS + 1) * BUCKET_US;
+	uint64_t airtime_sum_us = 0;
+	uint64_t airtime_permille;
+	uint8_t count;
+
+	memset(quality, 0, sizeof(*quality));
+
+	portENTER_CRITICAL(&stats_lock);
+	quality->packets = packet_count;
+	if(packet_count > 0) {
+		quality->per_permille = (uint16_t)((packet_count - packet_received) * 1000 / packet_count);
+	}
+	if(packet_received > 0) {
+		quality->rssi_avg_dbm = (int8_t)(rssi_sum / packet_received);
+		quality->snr_avg_db = (int8_t)(snr_sum / packet_received);
+		quality->rssi_min_dbm = INT8_MAX;
+		quality->snr_min_db = INT8_MAX;
+		for(uint8_t i = 0; i < packet_count; i++) {
+			if(!packets[i].received) {
+				continue;
+			}
+			if(packets[i].rssi_dbm < quality->rssi_min_dbm) {
+				quality->rssi_min_dbm = packets[i].rssi_dbm;
+			}
+			if(packets[i].snr_db < quality->snr_min_db) {
+				quality->snr_min_db = packets[i].snr_db;
+			}
+		}
+	}
+	quality->retries = tx_retries;
+
+	airtime_sum_us = stormwater_drone_lora_buckets_sum(&airtime_window, now_us);
+	if(window_us > now_us - airtime_start_us) {
+		window_us = now_us - airtime_start_us;
+	}
+
+	quality->radio_rx_packets = radio_rx_packets;
+	quality->radio_crc_errors = radio_crc_errors;
+	quality->radio_header_errors = radio_header_errors;
+	quality->radio_false_syncs = radio_false_syncs;
+
+	count = rtt_count;
+	memcpy(sorted, rtt_window, count * sizeof(uint32_t));
+	portEXIT_CRITICAL(&stats_lock);
+
+	if(window_us > 0) {
+		airtime_permille = airtime_sum_us * 1000 / (uint64_t)window_us;
+		quality->airtime_permille = (uint16_t)(airtime_permille > 1000 ? 1000 : airtime_permille);
+	}
+
+	// insertion sort, the window is small
+	for(uint8_t i = 1; i < count; i++) {
+		uint32_t value = sorted[i];
+		uint8_t j = i;
+
+		while(j > 0 && sorted[j - 1] > value) {
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = value;
+	}
+	quality->rtts = count;
+	if(count > 0) {
+		quality->rtt_p50_us = percentile(sorted, count, 50);
+		quality->rtt_p90_us = percentile(sorted, count, 90);
+		quality->rtt_max_us = sorted[count - 1];
+	}
+}
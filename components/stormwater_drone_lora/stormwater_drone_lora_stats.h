@@ -0,0 +1,76 @@
+#ifndef STORMWATER_DRONE_LORA_STATS_H
+#define STORMWATER_DRONE_LORA_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * rolling link quality, fed by the radio task from its irq handlers
+ *
+ * the last LINK_STATS_WINDOW packets expected (received, corrupt or timed out)
+ * give PER, RSSI and SNR; the last LINK_STATS_WINDOW transmissions give retries;
+ * the last LINK_STATS_WINDOW round trips (host: tx start to the reply's rx done)
+ * give percentiles; airtime is summed in LINK_STATS_AIRTIME_BUCKETS time buckets.
+ * updates are O(1) under a spinlock, reads sort a copy of the round trips
+ */
+
+// LINK STATS SETTINGS
+#define LINK_STATS_WINDOW		32	// entries in each rolling window
+#define LINK_STATS_AIRTIME_BUCKETS	12
+#define LINK_STATS_AIRTIME_BUCKET_MS	5000	// airtime over the last minute
+#define LINK_STATS_RADIO_POLL		16	// tx dones between reads of the radio's own counters
+
+typedef struct stormwater_drone_lora_link_quality_s {
+	uint8_t packets;		// packets expected in the window
+	uint16_t per_permille;		// corrupt or timed out among them
+	int8_t rssi_avg_dbm;		// over the packets received, 0 if none
+	int8_t rssi_min_dbm;
+	int8_t snr_avg_db;
+	int8_t snr_min_db;
+	uint8_t retries;		// retransmissions among the last LINK_STATS_WINDOW sent
+	uint8_t rtts;			// round trips measured in the window, host only
+	uint32_t rtt_p50_us;
+	uint32_t rtt_p90_us;
+	uint32_t rtt_max_us;
+	uint16_t airtime_permille;	// share of the airtime window spent transmitting
+	// the radio's own counters (lr11xx_radio_get_lora_stats), summed since reset
+	uint32_t radio_rx_packets;
+	uint32_t radio_crc_errors;
+	uint32_t radio_header_errors;
+	uint32_t radio_false_syncs;
+} stormwater_drone_lora_link_quality_t;
+
+/*!
+ * @brief clear every window and counter, now_us starts the airtime window
+ */
+void stormwater_drone_lora_stats_reset(int64_t now_us);
+
+/*!
+ * @brief a packet arrived intact
+ */
+void stormwater_drone_lora_stats_on_rx(int8_t rssi_dbm, int8_t snr_db);
+
+/*!
+ * @brief a packet was expected and lost: crc, header or length error, or rx timeout
+ */
+void stormwater_drone_lora_stats_on_loss(void);
+
+/*!
+ * @brief a transmission of toa_us ended at now_us
+ */
+void stormwater_drone_lora_stats_on_tx(int64_t now_us, uint32_t toa_us, bool retransmission);
+
+void stormwater_drone_lora_stats_on_rtt(uint32_t rtt_us);
+
+/*!
+ * @brief add counts read from the radio since its last reset_stats
+ */
+void stormwater_drone_lora_stats_on_radio(uint16_t rx_packets, uint16_t crc_errors, uint16_t header_errors,
+		uint16_t false_syncs);
+
+/*!
+ * @brief summarize the windows as of now_us, safe from any task
+ */
+void stormwater_drone_lora_stats_get(stormwater_drone_lora_link_quality_t* quality, int64_t now_us);
+
+#endif
@@ -0,0 +1,93 @@
+#include "stormwater_drone_lora_tdma.h"
+
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// --- PRIVATE DEFS AND METHODS ---
+
+static uint8_t tdma_slot_count = 0;
+static uint16_t tdma_poll_mask = 0;
+static uint16_t tdma_heard_mask = 0;
+// updated by the radio task, read by the app
+static portMUX_TYPE tdma_lock = portMUX_INITIALIZER_UNLOCKED;
+static stormwater_drone_lora_tdma_stats_t tdma_stats;
+
+static uint32_t slot_start_us(uint16_t slot_ms, uint8_t slot) {
+	return TDMA_FIRST_SLOT_US + (uint32_t)slot * slot_ms * 1000;
+}
+
+// --- PUBLIC METHODS ---
+
+void stormwater_drone_lora_tdma_init(uint8_t slot_count, uint32_t uplink_toa_us) {
+	if(slot_count > TDMA_MAX_DRONES) {
+		slot_count = TDMA_MAX_DRONES;
+	}
+	tdma_slot_count = slot_count;
+	tdma_poll_mask = (uint16_t)((1UL << slot_count) - 1);
+	// drones answer from their own beacon rx done, so each slot absorbs one guard
+	portENTER_CRITICAL(&tdma_lock);
+	tdma_stats.slot_ms = (uint16_t)((uplink_toa_us + TDMA_GUARD_US + 999) / 1000);
+	portEXIT_CRITICAL(&tdma_lock);
+}
+
+void stormwater_drone_lora_tdma_begin(stormwater_frame_beacon_t* beacon, uint8_t command) {
+	tdma_heard_mask = 0;
+	beacon->command = command;
+	beacon->slot_count = tdma_slot_count;
+	beacon->slot_ms = tdma_stats.slot_ms;
+	beacon->poll_mask = tdma_poll_mask;
+}
+
+uint32_t stormwater_drone_lora_tdma_window_us(void) {
+	return slot_start_us(tdma_stats.slot_ms, tdma_slot_count) + TDMA_GUARD_US;
+}
+
+bool stormwater_drone_lora_tdma_on_uplink(uint8_t addr, uint8_t seq, int8_t rssi_dbm, int8_t snr_db) {
+	if(addr == 0 || addr > tdma_slot_count) {
+		return tdma_heard_mask == tdma_poll_mask;
+	}
+
+	stormwater_drone_lora_tdma_drone_t* drone = &tdma_stats.drones[addr - 1];
+	portENTER_CRITICAL(&tdma_lock);
+	if(!(tdma_heard_mask & (1 << (addr - 1)))) {
+		drone->received++;
+		tdma_heard_mask |= (uint16_t)(1 << (addr - 1));
+	}
+	drone->last_seq = seq;
+	drone->rssi_dbm = rssi_dbm;
+	drone->snr_db = snr_db;
+	portEXIT_CRITICAL(&tdma_lock);
+	return tdma_heard_mask == tdma_poll_mask;
+}
+
+void stormwater_drone_lora_tdma_end(void) {
+	uint16_t missed = tdma_poll_mask & ~tdma_heard_mask;
+
+	portENTER_CRITICAL(&tdma_lock);
+	for(uint8_t slot = 0; slot < tdma_slot_count; slot++) {
+		if(missed & (1 << slot)) {
+			tdma_stats.drones[slot].missed++;
+		}
+	}
+	tdma_stats.superframes++;
+	portEXIT_CRITICAL(&tdma_lock);
+}
+
+void stormwater_drone_lora_tdma_get_stats(stormwater_drone_lora_tdma_stats_t* stats) {
+	portENTER_CRITICAL(&tdma_lock);
+	memcpy(stats, &tdma_stats, sizeof(tdma_stats));
+	portEXIT_CRITICAL(&tdma_lock);
+}
+
+bool stormwater_drone_lora_tdma_slot_offset_us(const stormwater_frame_beacon_t* beacon, uint8_t addr,
+		uint32_t* offset_us) {
+	uint8_t slot = addr - 1;
+
+	if(addr == 0 || slot >= beacon->slot_count || slot >= TDMA_MAX_DRONES ||
+			!(beacon->poll_mask & (1 << slot))) {
+		return false;
+	}
+	// start half a guard in so early or late timers stay inside the slot
+	*offset_us = slot_start_us(beacon->slot_ms, slot) + TDMA_GUARD_US / 2;
+	return true;
+}
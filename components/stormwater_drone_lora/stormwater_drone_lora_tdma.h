@@ -0,0 +1,77 @@
+#ifndef STORMWATER_DRONE_LORA_TDMA_H
+#define STORMWATER_DRONE_LORA_TDMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stormwater_frame.h"
+
+// TDMA SETTINGS
+#ifndef TDMA_ENABLED
+#define TDMA_ENABLED		false
+#endif
+#define TDMA_MAX_DRONES		16	// bounded by the beacon poll mask
+#ifndef TDMA_DRONE_COUNT
+#define TDMA_DRONE_COUNT	4	// ctrlr polls addresses 1..TDMA_DRONE_COUNT
+#endif
+#define TDMA_GUARD_US		4000	// per slot: irq latency, timer jitter, tx ramp
+#define TDMA_FIRST_SLOT_US	10000	// beacon end -> slot 0, ctrlr tx->rx turnaround
+
+/*!
+ * @brief per-drone uplink counters kept by the ctrlr
+ */
+typedef struct stormwater_drone_lora_tdma_drone_s {
+	uint32_t received;
+	uint32_t missed;
+	uint8_t last_seq;
+	int8_t rssi_dbm;
+	int8_t snr_db;
+} stormwater_drone_lora_tdma_drone_t;
+
+typedef struct stormwater_drone_lora_tdma_stats_s {
+	uint32_t superframes;
+	uint16_t slot_ms;
+	stormwater_drone_lora_tdma_drone_t drones[TDMA_MAX_DRONES];	// index = address - 1
+} stormwater_drone_lora_tdma_stats_t;
+
+/*!
+ * @brief ctrlr: set the number of slots and size them for an uplink of uplink_toa_us
+ */
+void stormwater_drone_lora_tdma_init(uint8_t slot_count, uint32_t uplink_toa_us);
+
+/*!
+ * @brief ctrlr: start a superframe and fill the beacon that announces it
+ */
+void stormwater_drone_lora_tdma_begin(stormwater_frame_beacon_t* beacon, uint8_t command);
+
+/*!
+ * @brief ctrlr: time from beacon tx done to the end of the last slot
+ */
+uint32_t stormwater_drone_lora_tdma_window_us(void);
+
+/*!
+ * @brief ctrlr: record a valid uplink from addr
+ *
+ * @returns true once every polled drone has been heard this superframe
+ */
+bool stormwater_drone_lora_tdma_on_uplink(uint8_t addr, uint8_t seq, int8_t rssi_dbm, int8_t snr_db);
+
+/*!
+ * @brief ctrlr: close the superframe, counting polled drones not heard as missed
+ */
+void stormwater_drone_lora_tdma_end(void);
+
+/*!
+ * @brief ctrlr: copy out per-drone counters
+ */
+void stormwater_drone_lora_tdma_get_stats(stormwater_drone_lora_tdma_stats_t* stats);
+
+/*!
+ * @brief drone: time from beacon rx done to the start of addr's slot
+ *
+ * @returns false if addr is not polled by this beacon
+ */
+bool stormwater_drone_lora_tdma_slot_offset_us(const stormwater_frame_beacon_t* beacon, uint8_t addr,
+		uint32_t* offset_us);
+
+#endif
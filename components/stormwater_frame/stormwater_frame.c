@@ -0,0 +1,340 @@
+#include "stormwater_frame.h"
+
+#include <math.h>
+#include <string.h>
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define FRAME_HEADER_LENGTH	3
+#define FRAME_CRC_OFFSET	(STORMWATER_FRAME_LENGTH - 2)
+
+#define TEMP_SCALE		100.0f	// 0.01 degC
+#define PH_SCALE		1000.0f	// 0.001 pH
+#define PERMILLE_STEP		5	// 0.5 %
+#define RTT_STEP_MS		16
+
+static int32_t to_fixed(float value, float scale, int32_t min, int32_t max) {
+	float scaled = roundf(value * scale);
+
+	if(isnan(scaled) || scaled < (float)min) {
+		return min;
+	}
+	if(scaled > (float)max) {
+		return max;
+	}
+	return (int32_t)scaled;
+}
+
+static void put_u16(uint8_t* buf, uint16_t value) {
+	buf[0] = (uint8_t)(value);
+	buf[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t* buf) {
+	return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+// --- BATCH PACKING ---
+
+#define BATCH_WIDTHS_OFFSET	4
+#define BATCH_FIRST_OFFSET	6
+#define BATCH_BITS_OFFSET	12
+#define BATCH_FIELDS		3
+
+typedef struct bit_writer_s {
+	uint8_t* buf;
+	size_t bit;
+} bit_writer_t;
+
+typedef struct bit_reader_s {
+	const uint8_t* buf;
+	size_t bit;
+} bit_reader_t;
+
+static void bits_put(bit_writer_t* w, uint32_t value, uint8_t width) {
+	for(uint8_t i = 0; i < width; i++, w->bit++) {
+		if(value & (1UL << i)) {
+			w->buf[w->bit >> 3] |= (uint8_t)(1 << (w->bit & 7));
+		}
+	}
+}
+
+static uint32_t bits_get(bit_reader_t* r, uint8_t width) {
+	uint32_t value = 0;
+
+	for(uint8_t i = 0; i < width; i++, r->bit++) {
+		if(r->buf[r->bit >> 3] & (1 << (r->bit & 7))) {
+			value |= 1UL << i;
+		}
+	}
+	return value;
+}
+
+static uint32_t zigzag(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t bit_width(uint32_t value) {
+	uint8_t width = 0;
+
+	while(value) {
+		width++;
+		value >>= 1;
+	}
+	return width;
+}
+
+static void sample_to_fixed(const stormwater_frame_sample_t* sample, int32_t fixed[BATCH_FIELDS]) {
+	fixed[0] = (int16_t)to_fixed(sample->temp_c, TEMP_SCALE, INT16_MIN, INT16_MAX);
+	fixed[1] = to_fixed(sample->do_ugl, 1.0f, 0, UINT16_MAX);
+	fixed[2] = to_fixed(sample->pH, PH_SCALE, 0, UINT16_MAX);
+}
+
+static void sample_from_fixed(const int32_t fixed[BATCH_FIELDS], stormwater_frame_sample_t* sample) {
+	sample->temp_c = (int16_t)fixed[0] / TEMP_SCALE;
+	sample->do_ugl = (float)(uint16_t)fixed[1];
+	sample->pH = (uint16_t)fixed[2] / PH_SCALE;
+}
+
+static size_t batch_length(uint8_t count, const uint8_t widths[BATCH_FIELDS]) {
+	size_t bits = (size_t)(count - 1) * (widths[0] + widths[1] + widths[2]);
+	return BATCH_BITS_OFFSET + (bits + 7) / 8 + 2;
+}
+
+// --- PUBLIC METHODS ---
+
+uint16_t stormwater_frame_crc16(const uint8_t* buf, size_t length) {
+	uint16_t crc = 0xFFFF;
+
+	for(size_t i = 0; i < length; i++) {
+		crc ^= (uint16_t)buf[i] << 8;
+		for(uint8_t bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+size_t stormwater_frame_encode(const stormwater_frame_t* frame, uint8_t* buf, size_t buf_length) {
+	if(buf_length < STORMWATER_FRAME_LENGTH) {
+		return 0;
+	}
+	memset(buf, 0, STORMWATER_FRAME_LENGTH);
+
+	buf[0] = (uint8_t)((STORMWATER_FRAME_VERSION << 4) | (frame->type & 0x0F));
+	buf[1] = frame->addr;
+	buf[2] = frame->seq;
+
+	uint8_t* body = buf + FRAME_HEADER_LENGTH;
+	switch(frame->type) {
+		case STORMWATER_FRAME_TYPE_TELEMETRY:
+			put_u16(body, (uint16_t)(int16_t)to_fixed(frame->telemetry.temp_c, TEMP_SCALE, INT16_MIN, INT16_MAX));
+			put_u16(body + 2, (uint16_t)to_fixed(frame->telemetry.do_ugl, 1.0f, 0, UINT16_MAX));
+			put_u16(body + 4, (uint16_t)to_fixed(frame->telemetry.pH, PH_SCALE, 0, UINT16_MAX));
+			body[6] = frame->telemetry.status;
+			break;
+		case STORMWATER_FRAME_TYPE_CONTROL:
+			body[0] = frame->control.command;
+			body[1] = frame->control.adr_id;
+			body[2] = frame->control.adr_sf;
+			body[3] = (uint8_t)frame->control.adr_power_dbm;
+			body[4] = frame->control.adr_bw;
+			break;
+		case STORMWATER_FRAME_TYPE_BEACON:
+			body[0] = frame->beacon.command;
+			body[1] = frame->beacon.slot_count;
+			put_u16(body + 2, frame->beacon.slot_ms);
+			put_u16(body + 4, frame->beacon.poll_mask);
+			break;
+		case STORMWATER_FRAME_TYPE_LINK_STATS:
+			body[0] = (uint8_t)to_fixed(frame->link_stats.per_permille, 1.0f / PERMILLE_STEP, 0, UINT8_MAX);
+			body[1] = (uint8_t)frame->link_stats.rssi_dbm;
+			body[2] = (uint8_t)frame->link_stats.snr_db;
+			body[3] = (uint8_t)frame->link_stats.snr_min_db;
+			body[4] = frame->link_stats.retries;
+			body[5] = (uint8_t)to_fixed(frame->link_stats.airtime_permille, 1.0f / PERMILLE_STEP, 0, UINT8_MAX);
+			// a measured rtt never rounds down to "not measured"
+			body[6] = frame->link_stats.rtt_p90_ms == 0 ? 0 :
+					(uint8_t)to_fixed(frame->link_stats.rtt_p90_ms, 1.0f / RTT_STEP_MS, 1, UINT8_MAX);
+			break;
+		default:
+			return 0;
+	}
+
+	put_u16(buf + FRAME_CRC_OFFSET, stormwater_frame_crc16(buf, FRAME_CRC_OFFSET));
+	return STORMWATER_FRAME_LENGTH;
+}
+
+stormwater_frame_status_t stormwater_frame_decode(const uint8_t* buf, size_t buf_length, stormwater_frame_t* frame) {
+	if(buf_length < STORMWATER_FRAME_LENGTH) {
+		return STORMWATER_FRAME_ERR_LENGTH;
+	}
+	if((buf[0] >> 4) != STORMWATER_FRAME_VERSION) {
+		return STORMWATER_FRAME_ERR_VERSION;
+	}
+	if(get_u16(buf + FRAME_CRC_OFFSET) != stormwater_frame_crc16(buf, FRAME_CRC_OFFSET)) {
+		return STORMWATER_FRAME_ERR_CRC;
+	}
+
+	frame->type = (stormwater_frame_type_t)(buf[0] & 0x0F);
+	frame->addr = buf[1];
+	frame->seq = buf[2];
+
+	const uint8_t* body = buf + FRAME_HEADER_LENGTH;
+	switch(frame->type) {
+		case STORMWATER_FRAME_TYPE_TELEMETRY:
+			frame->telemetry.temp_c = (int16_t)get_u16(body) / TEMP_SCALE;
+			frame->telemetry.do_ugl = (float)get_u16(body + 2);
+			frame->telemetry.pH = get_u16(body + 4) / PH_SCALE;
+			frame->telemetry.status = body[6];
+			break;
+		case STORMWATER_FRAME_TYPE_CONTROL:
+			frame->control.command = body[0];
+			frame->control.adr_id = body[1];
+			frame->control.adr_sf = body[2];
+			frame->control.adr_power_dbm = (int8_t)body[3];
+			frame->control.adr_bw = body[4];
+			break;
+		case STORMWATER_FRAME_TYPE_BEACON:
+			frame->beacon.command = body[0];
+			frame->beacon.slot_count = body[1];
+			frame->beacon.slot_ms = get_u16(body + 2);
+			frame->beacon.poll_mask = get_u16(body + 4);
+			break;
+		case STORMWATER_FRAME_TYPE_LINK_STATS:
+			frame->link_stats.per_permille = body[0] * PERMILLE_STEP;
+			frame->link_stats.rssi_dbm = (int8_t)body[1];
+			frame->link_stats.snr_db = (int8_t)body[2];
+			frame->link_stats.snr_min_db = (int8_t)body[3];
+			frame->link_stats.retries = body[4];
+			frame->link_stats.airtime_permille = body[5] * PERMILLE_STEP;
+			frame->link_stats.rtt_p90_ms = body[6] * RTT_STEP_MS;
+			break;
+		default:
+			return STORMWATER_FRAME_ERR_TYPE;
+	}
+	return STORMWATER_FRAME_OK;
+}
+
+void stormwater_frame_batch_push(stormwater_frame_batch_t* batch, const stormwater_frame_sample_t* sample,
+		uint8_t capacity) {
+	if(capacity == 0 || capacity > STORMWATER_FRAME_BATCH_MAX_SAMPLES) {
+		capacity = STORMWATER_FRAME_BATCH_MAX_SAMPLES;
+	}
+	if(batch->count >= capacity) {
+		uint8_t drop = batch->count - capacity + 1;
+
+		memmove(batch->samples, batch->samples + drop, (size_t)(batch->count - drop) * sizeof(batch->samples[0]));
+		batch->count -= drop;
+	}
+	batch->samples[batch->count++] = *sample;
+}
+
+size_t stormwater_frame_batch_encode(const stormwater_frame_batch_t* batch, uint8_t* buf, size_t buf_length,
+		uint8_t* encoded_count) {
+	int32_t fixed[STORMWATER_FRAME_BATCH_MAX_SAMPLES][BATCH_FIELDS];
+	uint8_t widths[BATCH_FIELDS] = { 0 };
+	uint8_t count = batch->count;
+	uint8_t first;
+
+	*encoded_count = 0;
+	if(count == 0 || count > STORMWATER_FRAME_BATCH_MAX_SAMPLES || buf_length < STORMWATER_FRAME_BATCH_MIN_LENGTH) {
+		return 0;
+	}
+	for(uint8_t i = 0; i < count; i++) {
+		sample_to_fixed(&batch->samples[i], fixed[i]);
+	}
+
+	// drop the oldest samples until the rest fit
+	for(;;) {
+		first = batch->count - count;
+		memset(widths, 0, sizeof(widths));
+		for(uint8_t i = first + 1; i < batch->count; i++) {
+			for(uint8_t f = 0; f < BATCH_FIELDS; f++) {
+				uint8_t width = bit_width(zigzag(fixed[i][f] - fixed[i - 1][f]));
+				if(width > widths[f]) {
+					widths[f] = width;
+				}
+			}
+		}
+		if(batch_length(count, widths) <= buf_length) {
+			break;
+		}
+		count--;
+	}
+
+	size_t length = batch_length(count, widths);
+	memset(buf, 0, length);
+
+	buf[0] = (uint8_t)((STORMWATER_FRAME_VERSION << 4) | STORMWATER_FRAME_TYPE_BATCH);
+	buf[1] = batch->addr;
+	buf[2] = batch->seq;
+	buf[3] = count;
+	put_u16(buf + BATCH_WIDTHS_OFFSET, (uint16_t)(widths[0] | (widths[1] << 5) | (widths[2] << 10)));
+	for(uint8_t f = 0; f < BATCH_FIELDS; f++) {
+		put_u16(buf + BATCH_FIRST_OFFSET + 2 * f, (uint16_t)fixed[first][f]);
+	}
+
+	bit_writer_t w = { .buf = buf + BATCH_BITS_OFFSET, .bit = 0 };
+	for(uint8_t i = first + 1; i < batch->count; i++) {
+		for(uint8_t f = 0; f < BATCH_FIELDS; f++) {
+			bits_put(&w, zigzag(fixed[i][f] - fixed[i - 1][f]), widths[f]);
+		}
+	}
+
+	put_u16(buf + length - 2, stormwater_frame_crc16(buf, length - 2));
+	*encoded_count = count;
+	return length;
+}
+
+stormwater_frame_status_t stormwater_frame_batch_decode(const uint8_t* buf, size_t buf_length,
+		stormwater_frame_batch_t* batch) {
+	if(buf_length < STORMWATER_FRAME_BATCH_MIN_LENGTH) {
+		return STORMWATER_FRAME_ERR_LENGTH;
+	}
+	if((buf[0] >> 4) != STORMWATER_FRAME_VERSION) {
+		return STORMWATER_FRAME_ERR_VERSION;
+	}
+	if(stormwater_frame_peek_type(buf) != STORMWATER_FRAME_TYPE_BATCH) {
+		return STORMWATER_FRAME_ERR_TYPE;
+	}
+
+	uint8_t count = buf[3];
+	uint16_t packed_widths = get_u16(buf + BATCH_WIDTHS_OFFSET);
+	uint8_t widths[BATCH_FIELDS] = {
+		packed_widths & 0x1F,
+		(packed_widths >> 5) & 0x1F,
+		(packed_widths >> 10) & 0x1F,
+	};
+	if(count == 0 || count > STORMWATER_FRAME_BATCH_MAX_SAMPLES || batch_length(count, widths) > buf_length) {
+		return STORMWATER_FRAME_ERR_LENGTH;
+	}
+
+	size_t length = batch_length(count, widths);
+	if(get_u16(buf + length - 2) != stormwater_frame_crc16(buf, length - 2)) {
+		return STORMWATER_FRAME_ERR_CRC;
+	}
+
+	int32_t fixed[BATCH_FIELDS];
+	fixed[0] = (int16_t)get_u16(buf + BATCH_FIRST_OFFSET);
+	fixed[1] = get_u16(buf + BATCH_FIRST_OFFSET + 2);
+	fixed[2] = get_u16(buf + BATCH_FIRST_OFFSET + 4);
+
+	batch->addr = buf[1];
+	batch->seq = buf[2];
+	batch->count = count;
+	sample_from_fixed(fixed, &batch->samples[0]);
+
+	bit_reader_t r = { .buf = buf + BATCH_BITS_OFFSET, .bit = 0 };
+	for(uint8_t i = 1; i < count; i++) {
+		for(uint8_t f = 0; f < BATCH_FIELDS; f++) {
+			fixed[f] += unzigzag(bits_get(&r, widths[f]));
+		}
+		sample_from_fixed(fixed, &batch->samples[i]);
+	}
+	return STORMWATER_FRAME_OK;
+}
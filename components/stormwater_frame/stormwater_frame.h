@@ -0,0 +1,209 @@
+#ifndef STORMWATER_FRAME_H
+#define STORMWATER_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * frame layout (little endian), shared by drone and ctrlr:
+ *
+ *   0     version (high nibble) | type (low nibble)
+ *   1     node address
+ *   2     sequence number
+ *   3..9  type specific body
+ *   10-11 crc16 (ccitt-false) over bytes 0..9
+ *
+ * telemetry body:
+ *   3-4   temperature, int16, 0.01 degC
+ *   5-6   dissolved oxygen, uint16, ug/L
+ *   7-8   pH, uint16, 0.001 pH
+ *   9     status: bit0 pump, bit1 spool, bit2..7 flags
+ *
+ * control body:
+ *   3     command: bit0 pump, bit1 spool, bit2 fetch
+ *   4     adr request id (0 = no request)
+ *   5     adr spreading factor
+ *   6     adr tx power, int8, dBm
+ *   7     adr bandwidth, lr11xx_radio_lora_bw_t
+ *   8..9  reserved (0)
+ *
+ * beacon body (ctrlr broadcast, starts a tdma superframe):
+ *   3     command for every drone, as in control
+ *   4     slot count
+ *   5-6   slot length, uint16, ms
+ *   7-8   poll mask: bit n set = drone address n + 1 answers in slot n
+ *   9     reserved (0)
+ *
+ * link stats body (a node's view of the link, see stormwater_drone_lora_stats.h):
+ *   3     packet error rate, 0.5 % steps
+ *   4     rssi average, int8, dBm
+ *   5     snr average, int8, dB
+ *   6     snr minimum, int8, dB
+ *   7     retransmissions among the last frames sent
+ *   8     airtime, 0.5 % steps
+ *   9     round trip time p90, 16 ms steps, saturating (0 = not measured)
+ *
+ * batch frames are variable length:
+ *   3     sample count (1..STORMWATER_FRAME_BATCH_MAX_SAMPLES)
+ *   4-5   delta widths in bits: temp (bit0..4), DO (bit5..9), pH (bit10..14)
+ *   6..11 oldest sample: temp, DO, pH as in telemetry
+ *   12..  zigzag deltas of each later sample vs the one before, packed
+ *         lsb first at the widths above, padded to a byte
+ *   last 2 bytes: crc16 over everything before
+ */
+
+#define STORMWATER_FRAME_VERSION	1
+#define STORMWATER_FRAME_LENGTH		12
+
+#define STORMWATER_FRAME_BATCH_MAX_SAMPLES	16
+#define STORMWATER_FRAME_BATCH_MIN_LENGTH	14
+
+#define STORMWATER_FRAME_ADDR_BROADCAST	0xFF
+
+// status/command bits
+#define STORMWATER_FRAME_PUMP		(1 << 0)
+#define STORMWATER_FRAME_SPOOL		(1 << 1)
+#define STORMWATER_FRAME_FETCH		(1 << 2)
+
+typedef enum stormwater_frame_type_e {
+	STORMWATER_FRAME_TYPE_TELEMETRY = 0x01,
+	STORMWATER_FRAME_TYPE_CONTROL   = 0x02,
+	STORMWATER_FRAME_TYPE_BATCH     = 0x03,
+	STORMWATER_FRAME_TYPE_BEACON    = 0x04,
+	STORMWATER_FRAME_TYPE_LINK_STATS = 0x05,
+} stormwater_frame_type_t;
+
+typedef enum stormwater_frame_status_e {
+	STORMWATER_FRAME_OK = 0,
+	STORMWATER_FRAME_ERR_LENGTH,
+	STORMWATER_FRAME_ERR_VERSION,
+	STORMWATER_FRAME_ERR_TYPE,
+	STORMWATER_FRAME_ERR_CRC,
+} stormwater_frame_status_t;
+
+/*!
+ * @brief sensor readings and actuator state reported by a drone
+ */
+typedef struct stormwater_frame_telemetry_s {
+	float temp_c;
+	float do_ugl;
+	float pH;
+	uint8_t status;		// STORMWATER_FRAME_PUMP | STORMWATER_FRAME_SPOOL | flags
+} stormwater_frame_telemetry_t;
+
+/*!
+ * @brief actuator commands sent by the ctrlr
+ */
+typedef struct stormwater_frame_control_s {
+	uint8_t command;	// STORMWATER_FRAME_PUMP | STORMWATER_FRAME_SPOOL | STORMWATER_FRAME_FETCH
+	uint8_t adr_id;		// nonzero: switch to adr_sf/adr_bw/adr_power_dbm after replying
+	uint8_t adr_sf;
+	int8_t adr_power_dbm;
+	uint8_t adr_bw;
+} stormwater_frame_control_t;
+
+/*!
+ * @brief tdma superframe start broadcast by the ctrlr
+ */
+typedef struct stormwater_frame_beacon_s {
+	uint8_t command;	// as in stormwater_frame_control_t, for every drone
+	uint8_t slot_count;
+	uint16_t slot_ms;
+	uint16_t poll_mask;	// bit n: drone address n + 1 answers in slot n
+} stormwater_frame_beacon_t;
+
+/*!
+ * @brief rolling link quality reported by a node, rounded to the wire resolution
+ */
+typedef struct stormwater_frame_link_stats_s {
+	uint16_t per_permille;
+	int8_t rssi_dbm;
+	int8_t snr_db;
+	int8_t snr_min_db;
+	uint8_t retries;
+	uint16_t airtime_permille;
+	uint16_t rtt_p90_ms;
+} stormwater_frame_link_stats_t;
+
+/*!
+ * @brief one averaged sensor reading within a batch
+ */
+typedef struct stormwater_frame_sample_s {
+	float temp_c;
+	float do_ugl;
+	float pH;
+} stormwater_frame_sample_t;
+
+/*!
+ * @brief several averaged readings sent in one packet, oldest first
+ */
+typedef struct stormwater_frame_batch_s {
+	uint8_t addr;
+	uint8_t seq;
+	uint8_t count;
+	stormwater_frame_sample_t samples[STORMWATER_FRAME_BATCH_MAX_SAMPLES];
+} stormwater_frame_batch_t;
+
+typedef struct stormwater_frame_s {
+	stormwater_frame_type_t type;
+	uint8_t addr;
+	uint8_t seq;
+	union {
+		stormwater_frame_telemetry_t telemetry;
+		stormwater_frame_control_t control;
+		stormwater_frame_beacon_t beacon;
+		stormwater_frame_link_stats_t link_stats;
+	};
+} stormwater_frame_t;
+
+/*!
+ * @brief pack frame into buf; readings are rounded and saturated to their fixed-point range
+ *
+ * @returns bytes written (STORMWATER_FRAME_LENGTH), or 0 if buf is too small or type unknown
+ */
+size_t stormwater_frame_encode(const stormwater_frame_t* frame, uint8_t* buf, size_t buf_length);
+
+/*!
+ * @brief unpack and validate (length, version, type, crc) a received frame
+ */
+stormwater_frame_status_t stormwater_frame_decode(const uint8_t* buf, size_t buf_length, stormwater_frame_t* frame);
+
+/*!
+ * @brief frame type of a received buffer, without validating it
+ */
+static inline stormwater_frame_type_t stormwater_frame_peek_type(const uint8_t* buf) {
+	return (stormwater_frame_type_t)(buf[0] & 0x0F);
+}
+
+/*!
+ * @brief delta + bit-pack the newest samples of batch into buf
+ *
+ * if the whole batch does not fit in buf_length, the oldest samples are dropped
+ *
+ * @param [out] encoded_count number of (newest) samples actually packed
+ *
+ * @returns bytes written, or 0 if not even one sample fits
+ */
+size_t stormwater_frame_batch_encode(const stormwater_frame_batch_t* batch, uint8_t* buf, size_t buf_length,
+		uint8_t* encoded_count);
+
+/*!
+ * @brief unpack and validate a batch frame
+ */
+stormwater_frame_status_t stormwater_frame_batch_decode(const uint8_t* buf, size_t buf_length,
+		stormwater_frame_batch_t* batch);
+
+/*!
+ * @brief append sample as the newest of batch; once batch holds capacity samples
+ * (at most STORMWATER_FRAME_BATCH_MAX_SAMPLES) the oldest is dropped to make room
+ */
+void stormwater_frame_batch_push(stormwater_frame_batch_t* batch, const stormwater_frame_sample_t* sample,
+		uint8_t capacity);
+
+/*!
+ * @brief crc16 ccitt-false (poly 0x1021, init 0xFFFF)
+ */
+uint16_t stormwater_frame_crc16(const uint8_t* buf, size_t length);
+
+#endif
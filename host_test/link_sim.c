@@ -0,0 +1,695 @@
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_port.h"
+#include "lr11xx_channel.h"
+#include "stormwater_drone_lora.h"
+#include "stormwater_frame.h"
+
+/*
+ * runs the link code (stormwater_drone_lora) through lr11xx_sim radios on an
+ * lr11xx_channel, a ctrlr and its drones per run
+ *
+ *   link_sim spi [seconds]	SPI transactions, bytes and BUSY wait per exchange
+ *   link_sim loss [seconds]	readings, latency and throughput over 0..50 % packet loss
+ *   link_sim arq [seconds]	arq goodput with a saturated source over 0..30 % packet loss
+ *   link_sim tdma [seconds]	readings/s of a tdma cell against its number of drones
+ *
+ * every node is a fresh copy of one of the modules built by CMakeLists.txt,
+ * node_<variant>_<role>.so, so each has its own statics, tasks and radio. the
+ * ctrlr answers each reply at once (reply delay 0): it polls flat out. drones
+ * publish a new telemetry reading whenever a transmission is done, every
+ * LINK_SIM_READING_MS, or as many as the link takes (saturated), as the scenario says
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define LINK_SIM_WARMUP_US	2000000		// radio init and the first exchanges, not measured
+#define LINK_SIM_APP_PRIORITY	1
+#define LINK_SIM_SEED		1
+#define LINK_SIM_RSSI_DBM	-100
+#define LINK_SIM_SNR_DB		4		// inside the adr target margin, the rate stays put
+#define LINK_SIM_READING_MS	200		// periodic source, about half the exchange rate
+#define LINK_SIM_HISTOGRAM_LOSS	0.3f		// loss scenario: full report at this loss
+#define LINK_SIM_DRAIN_US	60000000	// arq scenario: long enough to empty window and queue at 30 % loss
+#define LINK_SIM_SATURATED	UINT32_MAX	// net_open reading_ms: keep the arq window full
+#define LINK_SIM_LATENCY_SAMPLES	65536
+#define LINK_SIM_QUEUED_LATENCY_BIN_US	1000000	// frames queue for seconds under loss
+
+typedef struct node_s node_t;
+
+struct node_s {
+	void* module;
+	char name[16];
+	uint8_t index;			// channel node and frame address, ctrlr is 0
+	bool ctrlr;
+
+	// port
+	void (*setup)(const char* name, uint32_t seed, esp_log_level_t level);
+	lr11xx_sim_t* (*radio)(void);
+	void (*start)(TaskFunction_t app, void* arg, UBaseType_t priority);
+	void (*run)(void);
+	uint64_t (*next_event_us)(void);
+	int64_t (*now_us)(void);
+	void (*delay)(TickType_t ticks);
+
+	// link
+	void (*init)(void);
+	void (*set_callbacks)(const stormwater_drone_lora_callbacks_t* callbacks);
+	void (*set_address)(uint8_t address);
+	void (*set_reply_delay)(uint32_t delay_ms);
+	bool (*send)(const uint8_t* frame, uint8_t length);
+	void (*release)(stormwater_drone_lora_rx_frame_t* frame);
+	void (*get_arq_stats)(stormwater_drone_lora_arq_stats_t* stats);
+
+	// drone app: readings published, by sequence number
+	uint32_t reading_ms;		// 0: a new reading per transmission
+	bool saturated;			// send until refused, again after each transmission
+	bool drained;			// publishes nothing more, what is queued still goes
+	uint8_t seq;
+	uint32_t published;
+	uint32_t rejected;		// send returned false: arq window and queue full
+	int64_t published_us[256];
+	stormwater_drone_lora_arq_stats_t arq_start;	// at the start of the measurement
+
+	// ctrlr app: readings heard from this drone
+	bool heard;
+	uint8_t last_seq;
+	uint32_t readings;
+	uint32_t duplicates;
+	uint8_t next_seq;		// after the newest heard
+	int32_t missing;		// skipped over and not yet heard late, whole run
+	uint32_t late;			// heard after a newer one, whole run
+};
+
+typedef struct link_sim_s {
+	lr11xx_channel_t channel;
+	node_t nodes[LR11XX_CHANNEL_MAX_NODES];
+	uint8_t node_count;
+	char module_dir[64];
+	esp_log_level_t log_level;
+	int64_t measure_start_us;	// readings published before are not counted
+
+	// frame latency, exact: the channel's histogram saturates at 32 bins
+	uint32_t latency_us[LINK_SIM_LATENCY_SAMPLES];
+	uint32_t latency_count;
+} link_sim_t;
+
+static link_sim_t net;
+
+static void fatal(const char* what, const char* detail) {
+	fprintf(stderr, "link_sim: %s: %s\n", what, detail);
+	exit(2);
+}
+
+static void* node_symbol(node_t* node, const char* name) {
+	void* symbol = dlsym(node->module, name);
+
+	if(symbol == NULL) {
+		fatal("missing symbol", name);
+	}
+	return symbol;
+}
+
+#define NODE_BIND(node, field, name)	(*(void**)&(node)->field = node_symbol(node, name))
+
+static void copy_file(const char* from, const char* to) {
+	char buffer[65536];
+	size_t length;
+	FILE* in = fopen(from, "rb");
+	FILE* out = fopen(to, "wb");
+
+	if(in == NULL || out == NULL) {
+		fatal("cannot copy", from);
+	}
+	while((length = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		fwrite(buffer, 1, length, out);
+	}
+	fclose(in);
+	fclose(out);
+}
+
+// a new copy of the module, so dlopen maps fresh statics for this node
+static node_t* node_load(const char* variant, bool ctrlr) {
+	node_t* node = &net.nodes[net.node_count];
+	char module[512];
+	char copy[512];
+
+	memset(node, 0, sizeof(*node));
+	node->index = net.node_count;
+	node->ctrlr = ctrlr;
+	snprintf(node->name, sizeof(node->name), ctrlr ? "ctrlr" : "drone%u", node->index);
+
+	snprintf(module, sizeof(module), "%s/node_%s_%s.so", LINK_SIM_MODULE_DIR, variant, ctrlr ? "ctrlr" : "drone");
+	snprintf(copy, sizeof(copy), "%s/%u.so", net.module_dir, node->index);
+	copy_file(module, copy);
+	node->module = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+	if(node->module == NULL) {
+		fatal("dlopen", dlerror());
+	}
+	unlink(copy);
+
+	NODE_BIND(node, setup, "host_port_setup");
+	NODE_BIND(node, radio, "host_port_radio");
+	NODE_BIND(node, start, "host_port_start");
+	NODE_BIND(node, run, "host_port_run");
+	NODE_BIND(node, next_event_us, "host_port_next_event_us");
+	NODE_BIND(node, now_us, "esp_timer_get_time");
+	NODE_BIND(node, delay, "vTaskDelay");
+	NODE_BIND(node, init, "stormwater_drone_lora_init");
+	NODE_BIND(node, set_callbacks, "stormwater_drone_lora_set_callbacks");
+	NODE_BIND(node, set_address, "stormwater_drone_lora_set_address");
+	NODE_BIND(node, set_reply_delay, "stormwater_drone_lora_set_reply_delay");
+	NODE_BIND(node, send, "stormwater_drone_lora_send");
+	NODE_BIND(node, release, "stormwater_drone_lora_release");
+	NODE_BIND(node, get_arq_stats, "stormwater_drone_lora_get_arq_stats");
+
+	node->setup(node->name, LINK_SIM_SEED + 7919u * node->index, net.log_level);
+	lr11xx_channel_add_node(&net.channel, node->radio());
+	net.node_count++;
+	return node;
+}
+
+static bool drone_publish(node_t* drone) {
+	uint8_t buf[STORMWATER_FRAME_LENGTH];
+	stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_TELEMETRY,
+		.addr = drone->index,
+		.seq = drone->seq,
+		.telemetry = {
+			.temp_c = 12.5f,
+			.do_ugl = 8000.0f,
+			.pH = 7.0f,
+		},
+	};
+
+	stormwater_frame_encode(&frame, buf, sizeof(buf));
+	if(drone->send(buf, sizeof(buf))) {
+		drone->published_us[drone->seq] = drone->now_us();
+		drone->seq++;
+		drone->published++;
+		return true;
+	}
+	drone->rejected++;
+	return false;
+}
+
+static void drone_on_tx_done(void* context) {
+	node_t* drone = (node_t*)context;
+
+	if(drone->drained) {
+		return;
+	}
+	if(drone->saturated) {
+		while(drone_publish(drone));
+	}
+	else if(drone->reading_ms == 0) {
+		drone_publish(drone);
+	}
+}
+
+static void drone_on_rx(stormwater_drone_lora_rx_frame_t* frame, void* context) {
+	((node_t*)context)->release(frame);
+}
+
+static void drone_app(void* arg) {
+	node_t* drone = (node_t*)arg;
+	const stormwater_drone_lora_callbacks_t callbacks = {
+		.on_rx = drone_on_rx,
+		.on_tx_done = drone_on_tx_done,
+		.context = drone,
+	};
+
+	drone->set_callbacks(&callbacks);
+	drone->set_address(drone->index);
+	drone->init();
+	while(drone_publish(drone) && drone->saturated);
+	while(drone->reading_ms != 0) {
+		drone->delay(pdMS_TO_TICKS(drone->reading_ms));
+		drone_publish(drone);
+	}
+}
+
+static void ctrlr_on_rx(stormwater_drone_lora_rx_frame_t* rx, void* context) {
+	node_t* ctrlr = (node_t*)context;
+	stormwater_frame_t frame;
+	node_t* drone;
+
+	if(stormwater_frame_decode(rx->frame, rx->frame_length, &frame) == STORMWATER_FRAME_OK &&
+			frame.type == STORMWATER_FRAME_TYPE_TELEMETRY && frame.addr > 0 && frame.addr < net.node_count) {
+		drone = &net.nodes[frame.addr];
+		if(drone->heard && frame.seq == drone->last_seq) {
+			drone->duplicates++;
+			ctrlr->release(rx);
+			return;
+		}
+		if((int8_t)(uint8_t)(frame.seq - drone->next_seq) >= 0) {
+			drone->missing += (uint8_t)(frame.seq - drone->next_seq);
+			drone->next_seq = frame.seq + 1;
+		}
+		else {
+			drone->missing--;
+			drone->late++;
+		}
+		if(drone->published_us[frame.seq] >= net.measure_start_us) {
+			uint32_t latency_us = (uint32_t)(ctrlr->now_us() - drone->published_us[frame.seq]);
+
+			drone->readings++;
+			lr11xx_channel_record_latency(&net.channel, latency_us);
+			if(net.latency_count < LINK_SIM_LATENCY_SAMPLES) {
+				net.latency_us[net.latency_count++] = latency_us;
+			}
+		}
+		drone->heard = true;
+		drone->last_seq = frame.seq;
+	}
+	ctrlr->release(rx);
+}
+
+static void ctrlr_app(void* arg) {
+	node_t* ctrlr = (node_t*)arg;
+	const stormwater_drone_lora_callbacks_t callbacks = {
+		.on_rx = ctrlr_on_rx,
+		.context = ctrlr,
+	};
+	uint8_t buf[STORMWATER_FRAME_LENGTH];
+	const stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_CONTROL,
+		.addr = STORMWATER_FRAME_ADDR_BROADCAST,
+	};
+
+	ctrlr->set_callbacks(&callbacks);
+	ctrlr->init();
+	ctrlr->set_reply_delay(0);
+	stormwater_frame_encode(&frame, buf, sizeof(buf));
+	ctrlr->send(buf, sizeof(buf));
+}
+
+/*
+ * a ctrlr of ctrlr_variant and drones of drone_variant, all linked to each other.
+ * reading_ms 0: a reading per transmission, LINK_SIM_SATURATED: as fast as the
+ * link takes them
+ */
+static void net_open_cell(const char* ctrlr_variant, const char* drone_variant, uint8_t drones, float loss,
+		uint32_t reading_ms) {
+	const lr11xx_channel_link_t link = {
+		.rssi_dbm = LINK_SIM_RSSI_DBM,
+		.snr_db = LINK_SIM_SNR_DB,
+		.loss = loss,
+	};
+
+	lr11xx_channel_init(&net.channel, LINK_SIM_SEED);
+	net.node_count = 0;
+	net.measure_start_us = 0;
+	net.latency_count = 0;
+	node_load(ctrlr_variant, true);
+	for(uint8_t i = 0; i < drones; i++) {
+		node_t* drone = node_load(drone_variant, false);
+
+		drone->saturated = reading_ms == LINK_SIM_SATURATED;
+		drone->reading_ms = drone->saturated ? 0 : reading_ms;
+	}
+	for(uint8_t a = 0; a < net.node_count; a++) {
+		for(uint8_t b = a + 1; b < net.node_count; b++) {
+			lr11xx_channel_set_link_symmetric(&net.channel, a, b, &link);
+		}
+	}
+	// drones listen before the ctrlr's first request
+	for(uint8_t i = 1; i < net.node_count; i++) {
+		net.nodes[i].start(drone_app, &net.nodes[i], LINK_SIM_APP_PRIORITY);
+		net.nodes[i].run();
+	}
+	net.nodes[0].start(ctrlr_app, &net.nodes[0], LINK_SIM_APP_PRIORITY);
+}
+
+static void net_open(const char* variant, uint8_t drones, float loss, uint32_t reading_ms) {
+	net_open_cell(variant, variant, drones, loss, reading_ms);
+}
+
+static void net_close(void) {
+	// task stacks and queues were malloc'd by the module and are left behind
+	for(uint8_t i = 0; i < net.node_count; i++) {
+		dlclose(net.nodes[i].module);
+	}
+	net.node_count = 0;
+}
+
+// every node handles what is due, then the channel moves to the next event anywhere
+static void net_run_until(uint64_t until_us) {
+	uint64_t next;
+
+	for(;;) {
+		for(uint8_t i = 0; i < net.node_count; i++) {
+			net.nodes[i].run();
+		}
+		next = lr11xx_channel_next_event_us(&net.channel);
+		for(uint8_t i = 0; i < net.node_count; i++) {
+			uint64_t node_next = net.nodes[i].next_event_us();
+			if(node_next < next) {
+				next = node_next;
+			}
+		}
+		if(next > until_us) {
+			break;
+		}
+		lr11xx_channel_advance(&net.channel, next);
+	}
+	lr11xx_channel_advance(&net.channel, until_us);
+	for(uint8_t i = 0; i < net.node_count; i++) {
+		net.nodes[i].run();
+	}
+}
+
+static void net_reset_stats(void) {
+	lr11xx_channel_t* channel = &net.channel;
+
+	for(uint8_t i = 0; i < net.node_count; i++) {
+		lr11xx_sim_reset_stats(net.nodes[i].radio());
+		net.nodes[i].published = 0;
+		net.nodes[i].rejected = 0;
+		net.nodes[i].readings = 0;
+		net.nodes[i].duplicates = 0;
+		net.nodes[i].get_arq_stats(&net.nodes[i].arq_start);
+	}
+	net.measure_start_us = (int64_t)channel->now_us;
+	net.latency_count = 0;
+	memset(channel->stats, 0, sizeof(channel->stats));
+	lr11xx_channel_histogram_init(&channel->packet_latency, channel->packet_latency.bin_width);
+	lr11xx_channel_histogram_init(&channel->frame_latency, channel->frame_latency.bin_width);
+	lr11xx_channel_histogram_init(&channel->throughput, channel->throughput.bin_width);
+}
+
+// warm up, then measure for seconds
+static void net_measure(uint32_t seconds) {
+	net_run_until(LINK_SIM_WARMUP_US);
+	net_reset_stats();
+	net_run_until(LINK_SIM_WARMUP_US + (uint64_t)seconds * 1000000);
+}
+
+static uint32_t net_readings(void) {
+	uint32_t readings = 0;
+
+	for(uint8_t i = 1; i < net.node_count; i++) {
+		readings += net.nodes[i].readings;
+	}
+	return readings;
+}
+
+static uint32_t net_published(void) {
+	uint32_t published = 0;
+
+	for(uint8_t i = 1; i < net.node_count; i++) {
+		published += net.nodes[i].published;
+	}
+	return published;
+}
+
+static uint32_t net_rejected(void) {
+	uint32_t rejected = 0;
+
+	for(uint8_t i = 1; i < net.node_count; i++) {
+		rejected += net.nodes[i].rejected;
+	}
+	return rejected;
+}
+
+// payload bytes delivered to any node, both directions
+static uint32_t net_delivered_bytes(void) {
+	uint32_t bytes = 0;
+
+	for(uint8_t i = 0; i < net.node_count; i++) {
+		bytes += net.channel.stats[i].rx_payload_bytes;
+	}
+	return bytes;
+}
+
+static int compare_u32(const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a;
+	uint32_t y = *(const uint32_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+// sorts the samples; fraction 0..1
+static double net_latency_ms(float fraction) {
+	uint32_t index;
+
+	if(net.latency_count == 0) {
+		return 0.0;
+	}
+	qsort(net.latency_us, net.latency_count, sizeof(net.latency_us[0]), compare_u32);
+	index = (uint32_t)(fraction * (net.latency_count - 1) + 0.5f);
+	return net.latency_us[index] / 1000.0;
+}
+
+/*
+ * SPI cost of the link: per exchange (one ctrlr request, one drone reply) the
+ * transactions, bytes, time on the bus and time spent waiting on BUSY at each end
+ */
+static int scenario_spi(uint32_t seconds) {
+	static const char* variants[] = { "plain", "auto", "arq" };
+	lr11xx_sim_stats_t stats;
+	uint32_t exchanges;
+	int failed = 0;
+
+	printf("spi: %u s per variant, 1 drone, reply delay 0, SF7 BW125, 12 byte frames\n\n", seconds);
+	printf("%-6s %-6s %7s %7s %10s %7s %7s %9s %10s %10s\n", "link", "node", "exch/s", "new/ex", "spi tx/ex",
+			"writes", "reads", "bytes/ex", "spi us/ex", "busy us/ex");
+	for(size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		net_open(variants[v], 1, 0.0f, 0);
+		net_measure(seconds);
+
+		lr11xx_sim_get_stats(net.nodes[0].radio(), &stats);
+		exchanges = stats.tx_packets;
+		if(exchanges == 0 || net_readings() == 0) {
+			printf("%-6s no exchanges\n", variants[v]);
+			failed = 1;
+		}
+		else {
+			for(uint8_t i = 0; i < net.node_count; i++) {
+				lr11xx_sim_get_stats(net.nodes[i].radio(), &stats);
+				printf("%-6s %-6s %7.1f %7.2f %10.1f %7.1f %7.1f %9.1f %10.1f %10.1f\n", variants[v],
+						net.nodes[i].name, (double)exchanges / seconds, (double)net_readings() / exchanges,
+						(double)stats.transactions / exchanges,
+						(double)stats.writes / exchanges, (double)stats.reads / exchanges,
+						(double)stats.spi_bytes / exchanges, (double)stats.spi_us / exchanges,
+						(double)stats.busy_wait_us / exchanges);
+			}
+		}
+		net_close();
+	}
+	return failed;
+}
+
+/*
+ * periodic readings over a lossy link (each packet lost with the given chance,
+ * both ways): how many arrive, how late, and what the channel carries. without
+ * arq a reading lives until the next one replaces it, with arq it is resent
+ * until acked
+ */
+static int scenario_loss(uint32_t seconds) {
+	static const char* variants[] = { "plain", "arq" };
+	static const float losses[] = { 0.0f, 0.1f, 0.2f, 0.3f, 0.4f, 0.5f };
+	lr11xx_sim_stats_t stats;
+	uint32_t published;
+	uint32_t readings;
+	int failed = 0;
+
+	printf("loss: %u s per point, 1 drone, a reading every %u ms, reply delay 0, SF7 BW125\n\n", seconds,
+			LINK_SIM_READING_MS);
+	printf("%-6s %5s %7s %10s %9s %9s %8s %8s %8s %7s\n", "link", "loss", "exch/s", "readings/s", "delivered",
+			"rejected/s", "p50 ms", "p90 ms", "p99 ms", "B/s");
+	for(size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		for(size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+			net_open(variants[v], 1, losses[l], LINK_SIM_READING_MS);
+			net_measure(seconds);
+
+			lr11xx_sim_get_stats(net.nodes[0].radio(), &stats);
+			published = net_published();
+			readings = net_readings();
+			printf("%-6s %4.0f%% %7.1f %10.2f %8.1f%% %10.2f %8.0f %8.0f %8.0f %7.1f\n", variants[v],
+					losses[l] * 100, (double)stats.tx_packets / seconds, (double)readings / seconds,
+					published ? 100.0 * readings / published : 0.0, (double)net_rejected() / seconds,
+					net_latency_ms(0.5f), net_latency_ms(0.9f), net_latency_ms(0.99f),
+					(double)net_delivered_bytes() / seconds);
+			// every reading gets through a clean link, and through any loss with arq
+			// but for those still in flight at the end
+			if(readings == 0 || (losses[l] == 0.0f && readings + 1 < published) ||
+					(strcmp(variants[v], "arq") == 0 && readings + 2 * ARQ_WINDOW < published)) {
+				failed = 1;
+			}
+			net_close();
+		}
+	}
+
+	for(size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		printf("\n%s at %.0f %% loss, ctrlr is node 0:\n", variants[v], LINK_SIM_HISTOGRAM_LOSS * 100);
+		net_open(variants[v], 1, LINK_SIM_HISTOGRAM_LOSS, LINK_SIM_READING_MS);
+		net.channel.frame_latency.bin_width = LINK_SIM_QUEUED_LATENCY_BIN_US;
+		net_measure(seconds);
+		lr11xx_channel_print_report(&net.channel, stdout);
+		net_close();
+	}
+	return failed;
+}
+
+/*
+ * arq goodput: the drone keeps the window full, the ctrlr must get every reading
+ * once while packets are lost both ways, first contact included. selective repeat
+ * passes frames up as they arrive, a retransmitted one after newer ones (late).
+ * after the measurement the source stops and the link drains: then none may be
+ * missing
+ */
+static int scenario_arq(uint32_t seconds) {
+	static const float losses[] = { 0.0f, 0.1f, 0.2f, 0.3f };
+	stormwater_drone_lora_arq_stats_t arq;
+	lr11xx_sim_stats_t stats;
+	uint32_t readings;
+	int failed = 0;
+
+	printf("arq: %u s per point, 1 drone, saturated, reply delay 0, SF7 BW125, %u byte readings\n\n", seconds,
+			STORMWATER_FRAME_LENGTH);
+	printf("%5s %7s %10s %11s %10s %8s %6s %6s\n", "loss", "exch/s", "readings/s", "goodput B/s", "tx/reading",
+			"retx/s", "late", "missing");
+	for(size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+		net_open("arq", 1, losses[l], LINK_SIM_SATURATED);
+		net_measure(seconds);
+
+		lr11xx_sim_get_stats(net.nodes[0].radio(), &stats);
+		net.nodes[1].get_arq_stats(&arq);
+		arq.sent -= net.nodes[1].arq_start.sent;
+		arq.retransmitted -= net.nodes[1].arq_start.retransmitted;
+		readings = net_readings();
+		net.nodes[1].drained = true;
+		net_run_until(LINK_SIM_WARMUP_US + (uint64_t)seconds * 1000000 + LINK_SIM_DRAIN_US);
+		printf("%4.0f%% %7.1f %10.2f %11.1f %10.2f %8.2f %6u %6d\n", losses[l] * 100,
+				(double)stats.tx_packets / seconds, (double)readings / seconds,
+				(double)readings * STORMWATER_FRAME_LENGTH / seconds,
+				arq.sent ? (double)(arq.sent + arq.retransmitted) / arq.sent : 0.0,
+				(double)arq.retransmitted / seconds, net.nodes[1].late, net.nodes[1].missing);
+		if(readings == 0 || net.nodes[1].duplicates != 0 || net.nodes[1].missing != 0) {
+			failed = 1;
+		}
+		net_close();
+	}
+	return failed;
+}
+
+/*
+ * tdma cell size: the ctrlr beacons back to back (reply delay 0), every drone
+ * answers in its slot with a new reading each time. readings/s for the cell and
+ * per drone, against the slot math (one superframe per beacon, slot count slots)
+ */
+static int scenario_tdma(uint32_t seconds) {
+	static const uint8_t cells[] = { 1, 2, 4, 8, 16 };
+	stormwater_drone_lora_tdma_stats_t start;
+	stormwater_drone_lora_tdma_stats_t tdma;
+	void (*get_tdma_stats)(stormwater_drone_lora_tdma_stats_t* stats);
+	char variant[16];
+	uint32_t superframes;
+	uint32_t readings;
+	uint32_t least;
+	uint32_t missed;
+	int failed = 0;
+
+	printf("tdma: %u s per cell, reply delay 0, SF7 BW125, %u byte readings in %u byte slots\n\n", seconds,
+			STORMWATER_FRAME_LENGTH, TDMA_UPLINK_LENGTH);
+	printf("%6s %7s %13s %12s %10s %15s %12s\n", "drones", "slot ms", "superframe ms", "superframe/s",
+			"readings/s", "per drone min/s", "slots missed");
+	for(size_t c = 0; c < sizeof(cells) / sizeof(cells[0]); c++) {
+		snprintf(variant, sizeof(variant), "tdma%u", cells[c]);
+		net_open_cell(variant, "tdma", cells[c], 0.0f, 0);
+		*(void**)&get_tdma_stats = node_symbol(&net.nodes[0], "stormwater_drone_lora_get_tdma_stats");
+		net_run_until(LINK_SIM_WARMUP_US);
+		get_tdma_stats(&start);
+		net_reset_stats();
+		net_run_until(LINK_SIM_WARMUP_US + (uint64_t)seconds * 1000000);
+		get_tdma_stats(&tdma);
+		superframes = tdma.superframes - start.superframes;
+		missed = 0;
+		for(uint8_t i = 0; i < cells[c]; i++) {
+			missed += tdma.drones[i].missed - start.drones[i].missed;
+		}
+
+		readings = net_readings();
+		least = UINT32_MAX;
+		for(uint8_t i = 1; i < net.node_count; i++) {
+			if(net.nodes[i].readings < least) {
+				least = net.nodes[i].readings;
+			}
+		}
+		printf("%6u %7u %13.1f %12.2f %10.2f %15.2f %12u\n", cells[c], tdma.slot_ms,
+				superframes ? (double)seconds * 1000 / superframes : 0.0, (double)superframes / seconds,
+				(double)readings / seconds, (double)least / seconds, missed);
+		// collision free: every drone heard in every superframe
+		if(least == 0 || missed != 0) {
+			failed = 1;
+		}
+		net_close();
+	}
+
+	printf("\nwithout tdma (plain ping-pong, every drone answers the broadcast request):\n");
+	printf("%6s %10s %15s %10s\n", "drones", "readings/s", "per drone min/s", "collisions");
+	for(size_t c = 0; c < sizeof(cells) / sizeof(cells[0]); c++) {
+		uint32_t collisions = 0;
+
+		net_open("plain", cells[c], 0.0f, 0);
+		net_measure(seconds);
+		least = UINT32_MAX;
+		for(uint8_t i = 1; i < net.node_count; i++) {
+			if(net.nodes[i].readings < least) {
+				least = net.nodes[i].readings;
+			}
+		}
+		for(uint8_t i = 0; i < net.node_count; i++) {
+			collisions += net.channel.stats[i].rx_collisions;
+		}
+		printf("%6u %10.2f %15.2f %10u\n", cells[c], (double)net_readings() / seconds, (double)least / seconds,
+				collisions);
+		net_close();
+	}
+	return failed;
+}
+
+static int usage(void) {
+	fprintf(stderr, "usage: link_sim spi|loss|arq|tdma [seconds]\n");
+	return 2;
+}
+
+// --- PUBLIC METHODS ---
+
+int main(int argc, char** argv) {
+	uint32_t seconds;
+	int result;
+
+	if(argc < 2) {
+		return usage();
+	}
+	seconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+	net.log_level = getenv("LINK_SIM_LOG") != NULL ? (esp_log_level_t)atoi(getenv("LINK_SIM_LOG")) : ESP_LOG_WARN;
+	snprintf(net.module_dir, sizeof(net.module_dir), "/tmp/link_sim_XXXXXX");
+	if(mkdtemp(net.module_dir) == NULL) {
+		fatal("mkdtemp", net.module_dir);
+	}
+
+	if(strcmp(argv[1], "spi") == 0) {
+		result = scenario_spi(seconds != 0 ? seconds : 60);
+	}
+	else if(strcmp(argv[1], "loss") == 0) {
+		result = scenario_loss(seconds != 0 ? seconds : 300);
+	}
+	else if(strcmp(argv[1], "arq") == 0) {
+		result = scenario_arq(seconds != 0 ? seconds : 300);
+	}
+	else if(strcmp(argv[1], "tdma") == 0) {
+		result = scenario_tdma(seconds != 0 ? seconds : 60);
+	}
+	else {
+		result = usage();
+	}
+	rmdir(net.module_dir);
+	return result;
+}
@@ -0,0 +1,663 @@
+#include "host_port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "lr1121_config.h"
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define HOST_PORT_TASKS		8
+#define HOST_PORT_QUEUES	16
+#define HOST_PORT_TIMERS	8
+#define HOST_PORT_STACK_SIZE	(256 * 1024)	// host frames are far larger than the target's
+#define HOST_PORT_NEVER		UINT64_MAX
+
+typedef enum host_wait_e {
+	HOST_WAIT_NONE,
+	HOST_WAIT_NOTIFY,
+	HOST_WAIT_QUEUE,
+	HOST_WAIT_DELAY,
+} host_wait_t;
+
+struct host_task_s {
+	ucontext_t context;
+	TaskFunction_t function;
+	void* arg;
+	const char* name;
+	UBaseType_t priority;
+	bool ready;			// running or runnable
+	bool done;
+	uint64_t ready_order;		// FIFO among equal priorities
+	host_wait_t wait;
+	QueueHandle_t wait_queue;
+	uint64_t wake_at_us;		// HOST_PORT_NEVER: no timeout
+	uint32_t notify_value;
+	bool notify_pending;
+};
+
+struct host_queue_s {
+	uint8_t* items;
+	UBaseType_t length;
+	UBaseType_t item_size;		// 0 for semaphores, count is the semaphore
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+struct host_timer_s {
+	esp_timer_cb_t callback;
+	void* arg;
+	bool active;
+	uint64_t at_us;
+	uint64_t period_us;		// 0: one shot
+};
+
+static struct host_task_s tasks[HOST_PORT_TASKS];
+static uint8_t task_count = 0;
+static struct host_queue_s queues[HOST_PORT_QUEUES];
+static uint8_t queue_count = 0;
+static struct host_timer_s timers[HOST_PORT_TIMERS];
+static uint8_t timer_count = 0;
+
+static ucontext_t scheduler_context;
+static struct host_task_s* current = NULL;	// NULL in timer, isr and harness context
+static uint64_t ready_order = 0;
+
+static const char* node_name = "node";
+static esp_log_level_t log_level = ESP_LOG_WARN;
+static uint32_t rng = 1;
+
+static uint64_t now_us(void) {
+	return lr1121.sim.now_us;
+}
+
+static void fatal(const char* what) {
+	fprintf(stderr, "%s: %s\n", node_name, what);
+	abort();
+}
+
+static void task_ready(struct host_task_s* task) {
+	if(!task->ready && !task->done) {
+		task->ready = true;
+		task->wait = HOST_WAIT_NONE;
+		task->ready_order = ready_order++;
+	}
+}
+
+static struct host_task_s* task_next(void) {
+	struct host_task_s* next = NULL;
+
+	for(uint8_t i = 0; i < task_count; i++) {
+		struct host_task_s* task = &tasks[i];
+		if(task->ready && (next == NULL || task->priority > next->priority ||
+				(task->priority == next->priority && task->ready_order < next->ready_order))) {
+			next = task;
+		}
+	}
+	return next;
+}
+
+// the running task readied a higher priority one: that one runs first, as on the target
+static void task_preempt(void) {
+	struct host_task_s* next;
+
+	if(current == NULL) {
+		return;
+	}
+	next = task_next();
+	if(next != NULL && next->priority > current->priority) {
+		swapcontext(&current->context, &scheduler_context);
+	}
+}
+
+static void task_block(host_wait_t wait, QueueHandle_t queue, uint64_t wake_at_us) {
+	if(current == NULL) {
+		fatal("blocking call outside a task");
+	}
+	current->ready = false;
+	current->wait = wait;
+	current->wait_queue = queue;
+	current->wake_at_us = wake_at_us;
+	swapcontext(&current->context, &scheduler_context);
+}
+
+static uint64_t deadline_us(TickType_t ticks) {
+	if(ticks == portMAX_DELAY) {
+		return HOST_PORT_NEVER;
+	}
+	return now_us() + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+static bool timed_out(TickType_t ticks, uint64_t deadline) {
+	return ticks == 0 || now_us() >= deadline;
+}
+
+static void task_entry(void) {
+	current->function(current->arg);
+	// FreeRTOS tasks must not return; treat it as vTaskDelete(NULL)
+	current->done = true;
+	current->ready = false;
+}
+
+static bool tasks_run(void) {
+	struct host_task_s* task;
+	bool ran = false;
+
+	while((task = task_next()) != NULL) {
+		current = task;
+		swapcontext(&scheduler_context, &task->context);
+		current = NULL;
+		ran = true;
+	}
+	return ran;
+}
+
+static bool tasks_wake(void) {
+	bool woken = false;
+
+	for(uint8_t i = 0; i < task_count; i++) {
+		struct host_task_s* task = &tasks[i];
+		if(!task->ready && !task->done && task->wake_at_us <= now_us()) {
+			task_ready(task);
+			woken = true;
+		}
+	}
+	return woken;
+}
+
+static void queue_wake(QueueHandle_t queue) {
+	for(uint8_t i = 0; i < task_count; i++) {
+		if(tasks[i].wait == HOST_WAIT_QUEUE && tasks[i].wait_queue == queue) {
+			task_ready(&tasks[i]);
+		}
+	}
+}
+
+static bool timers_fire(void) {
+	bool fired = false;
+
+	for(uint8_t i = 0; i < timer_count; i++) {
+		struct host_timer_s* timer = &timers[i];
+		if(timer->active && timer->at_us <= now_us()) {
+			if(timer->period_us != 0) {
+				timer->at_us += timer->period_us;
+			}
+			else {
+				timer->active = false;
+			}
+			timer->callback(timer->arg);
+			fired = true;
+		}
+	}
+	return fired;
+}
+
+// DIO is polled between task runs; a rising edge with the interrupt enabled calls the isr
+static bool irq_poll(void) {
+	bool level = lr11xx_sim_dio_level(&lr1121.sim);
+	bool edge = level && !lr1121.irq_level;
+
+	lr1121.irq_level = level;
+	if(edge && lr1121.irq_enabled && lr1121.isr != NULL) {
+		lr1121.isr(NULL);
+		return true;
+	}
+	return false;
+}
+
+static BaseType_t notify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+	switch(action) {
+		case eNoAction:
+			break;
+		case eSetBits:
+			task->notify_value |= value;
+			break;
+		case eIncrement:
+			task->notify_value++;
+			break;
+		case eSetValueWithOverwrite:
+			task->notify_value = value;
+			break;
+		case eSetValueWithoutOverwrite:
+			if(task->notify_pending) {
+				return pdFAIL;
+			}
+			task->notify_value = value;
+			break;
+	}
+	task->notify_pending = true;
+	if(task->wait == HOST_WAIT_NOTIFY) {
+		task_ready(task);
+	}
+	return pdPASS;
+}
+
+static QueueHandle_t queue_create(UBaseType_t length, UBaseType_t item_size, UBaseType_t count) {
+	QueueHandle_t queue;
+
+	if(queue_count == HOST_PORT_QUEUES) {
+		return NULL;
+	}
+	queue = &queues[queue_count++];
+	queue->items = calloc(length, item_size == 0 ? 1 : item_size);
+	queue->length = length;
+	queue->item_size = item_size;
+	queue->head = 0;
+	queue->count = count;
+	return queue;
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void* item, TickType_t ticks, bool remove) {
+	uint64_t deadline = deadline_us(ticks);
+
+	while(queue->count == 0) {
+		if(timed_out(ticks, deadline)) {
+			return pdFALSE;
+		}
+		task_block(HOST_WAIT_QUEUE, queue, deadline);
+	}
+	if(queue->item_size != 0) {
+		memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+	}
+	if(remove) {
+		queue->head = (queue->head + 1) % queue->length;
+		queue->count--;
+		queue_wake(queue);
+		task_preempt();
+	}
+	return pdTRUE;
+}
+
+static void queue_push(QueueHandle_t queue, const void* item) {
+	UBaseType_t tail = (queue->head + queue->count) % queue->length;
+
+	if(queue->item_size != 0) {
+		memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+	}
+	queue->count++;
+	queue_wake(queue);
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+	if(timer->active) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	timer->active = true;
+	timer->at_us = now_us() + timeout_us;
+	timer->period_us = period_us;
+	return ESP_OK;
+}
+
+// --- PUBLIC METHODS ---
+
+void host_port_setup(const char* name, uint32_t seed, esp_log_level_t level) {
+	const lr11xx_sim_config_t config = {
+		.spi_hz = LR11XX_SIM_SPI_HZ,
+	};
+
+	node_name = name;
+	rng = seed != 0 ? seed : 1;
+	log_level = level;
+	lr11xx_sim_init(&lr1121.sim, &config);
+}
+
+lr11xx_sim_t* host_port_radio(void) {
+	return &lr1121.sim;
+}
+
+void host_port_start(TaskFunction_t app, void* arg, UBaseType_t priority) {
+	xTaskCreate(app, "app", 0, arg, priority, NULL);
+}
+
+void host_port_run(void) {
+	bool progress;
+
+	do {
+		progress = timers_fire();
+		progress |= irq_poll();
+		progress |= tasks_wake();
+		progress |= tasks_run();
+	} while(progress);
+}
+
+uint64_t host_port_next_event_us(void) {
+	uint64_t next = HOST_PORT_NEVER;
+
+	for(uint8_t i = 0; i < timer_count; i++) {
+		if(timers[i].active && timers[i].at_us < next) {
+			next = timers[i].at_us;
+		}
+	}
+	for(uint8_t i = 0; i < task_count; i++) {
+		if(!tasks[i].ready && !tasks[i].done && tasks[i].wake_at_us < next) {
+			next = tasks[i].wake_at_us;
+		}
+	}
+	return next;
+}
+
+void host_port_log(esp_log_level_t level, const char* tag, const char* format, ...) {
+	va_list args;
+
+	if(level > log_level) {
+		return;
+	}
+	fprintf(stderr, "%c (%llu.%06llu) %s %s: ", "-EWIDV"[level], (unsigned long long)(now_us() / 1000000),
+			(unsigned long long)(now_us() % 1000000), node_name, tag);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+int host_port_printf(const char* format, ...) {
+	va_list args;
+	int written;
+
+	if(log_level < ESP_LOG_INFO) {
+		return 0;
+	}
+	va_start(args, format);
+	written = vfprintf(stderr, format, args);
+	va_end(args);
+	return written;
+}
+
+// freertos
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+		UBaseType_t priority, TaskHandle_t* handle) {
+	struct host_task_s* task;
+
+	(void)stack_depth;
+	if(task_count == HOST_PORT_TASKS) {
+		return pdFAIL;
+	}
+	task = &tasks[task_count++];
+	memset(task, 0, sizeof(*task));
+	task->function = function;
+	task->arg = arg;
+	task->name = name;
+	task->priority = priority;
+	task->wake_at_us = HOST_PORT_NEVER;
+
+	getcontext(&task->context);
+	task->context.uc_stack.ss_sp = malloc(HOST_PORT_STACK_SIZE);
+	task->context.uc_stack.ss_size = HOST_PORT_STACK_SIZE;
+	task->context.uc_link = &scheduler_context;
+	makecontext(&task->context, task_entry, 0);
+
+	task_ready(task);
+	if(handle != NULL) {
+		*handle = task;
+	}
+	task_preempt();
+	return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+	uint64_t deadline = deadline_us(ticks);
+
+	while(now_us() < deadline) {
+		task_block(HOST_WAIT_DELAY, NULL, deadline);
+	}
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+	return current;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+	BaseType_t result = notify(task, value, action);
+
+	task_preempt();
+	return result;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* woken) {
+	if(woken != NULL) {
+		*woken = pdFALSE;
+	}
+	return notify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks) {
+	struct host_task_s* task = current;
+	uint64_t deadline = deadline_us(ticks);
+
+	if(task == NULL) {
+		fatal("xTaskNotifyWait outside a task");
+	}
+	if(!task->notify_pending) {
+		task->notify_value &= ~clear_on_entry;
+	}
+	while(!task->notify_pending) {
+		if(timed_out(ticks, deadline)) {
+			if(value != NULL) {
+				*value = task->notify_value;
+			}
+			return pdFALSE;
+		}
+		task_block(HOST_WAIT_NOTIFY, NULL, deadline);
+	}
+	if(value != NULL) {
+		*value = task->notify_value;
+	}
+	task->notify_value &= ~clear_on_exit;
+	task->notify_pending = false;
+	return pdTRUE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+	return xTaskNotify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+	struct host_task_s* task = current;
+	uint64_t deadline = deadline_us(ticks);
+	uint32_t value;
+
+	if(task == NULL) {
+		fatal("ulTaskNotifyTake outside a task");
+	}
+	while(task->notify_value == 0) {
+		if(timed_out(ticks, deadline)) {
+			return 0;
+		}
+		task_block(HOST_WAIT_NOTIFY, NULL, deadline);
+	}
+	value = task->notify_value;
+	task->notify_value = clear_on_exit ? 0 : value - 1;
+	task->notify_pending = false;
+	return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+	return queue_create(length, item_size, 0);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+	uint64_t deadline = deadline_us(ticks);
+
+	while(queue->count == queue->length) {
+		if(timed_out(ticks, deadline)) {
+			return pdFALSE;
+		}
+		task_block(HOST_WAIT_QUEUE, queue, deadline);
+	}
+	queue_push(queue, item);
+	task_preempt();
+	return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+	// length 1 queues only, as in FreeRTOS
+	queue->head = 0;
+	queue->count = 0;
+	queue_push(queue, item);
+	task_preempt();
+	return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+	return queue_receive(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks) {
+	return queue_receive(queue, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+	return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+	return queue_create(1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+	return queue_create(1, 0, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+	return queue_receive(semaphore, NULL, ticks, true);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+	return xQueueSend(semaphore, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken) {
+	if(woken != NULL) {
+		*woken = pdFALSE;
+	}
+	if(semaphore->count == semaphore->length) {
+		return pdFALSE;
+	}
+	queue_push(semaphore, NULL);
+	return pdTRUE;
+}
+
+// esp_timer
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+	if(timer_count == HOST_PORT_TIMERS) {
+		return ESP_ERR_NO_MEM;
+	}
+	*handle = &timers[timer_count++];
+	(*handle)->callback = args->callback;
+	(*handle)->arg = args->arg;
+	(*handle)->active = false;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+	return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+	return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+	if(!timer->active) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	timer->active = false;
+	return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void) {
+	return (int64_t)now_us();
+}
+
+uint32_t esp_random(void) {
+	// xorshift32
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// gpio and spi
+
+int gpio_get_level(gpio_num_t gpio_num) {
+	return gpio_num == lr1121.irq && lr11xx_sim_dio_level(&lr1121.sim) ? 1 : 0;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+	if(gpio_num == lr1121.irq) {
+		lr1121.irq_enabled = true;
+	}
+	return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) {
+	if(gpio_num == lr1121.irq) {
+		lr1121.irq_enabled = false;
+	}
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* config, spi_dma_chan_t dma) {
+	(void)host;
+	(void)config;
+	(void)dma;
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* config,
+		spi_device_handle_t* handle) {
+	(void)host;
+	(void)config;
+	*handle = NULL;
+	return ESP_OK;
+}
+
+// board support
+
+void lora_init_io_context(const void* context, uint8_t cs, uint8_t reset, uint8_t busy, uint8_t irq) {
+	lr1121_t* radio = (lr1121_t*)context;
+
+	radio->cs = cs;
+	radio->reset = reset;
+	radio->busy = busy;
+	radio->irq = irq;
+}
+
+void lora_init_io(const void* context) {
+	(void)context;
+}
+
+void lora_init_irq(const void* context, gpio_isr_t handler) {
+	lr1121_t* radio = (lr1121_t*)context;
+
+	radio->isr = handler;
+	radio->irq_enabled = true;
+	radio->irq_level = lr11xx_sim_dio_level(&radio->sim);
+}
+
+void lora_spi_init(const void* context, spi_device_handle_t spi) {
+	(void)context;
+	(void)spi;
+}
+
+uint8_t lora_busy_get_stats(const void* context, lora_busy_stats_t* stats, uint8_t max_count) {
+	(void)context;
+	(void)stats;
+	(void)max_count;
+	return 0;
+}
+
+void lora_trace_dump(const void* context) {
+	(void)context;
+}
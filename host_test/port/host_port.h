@@ -0,0 +1,56 @@
+#ifndef HOST_PORT_H
+#define HOST_PORT_H
+
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lr11xx_sim.h"
+
+/*
+ * host port of the FreeRTOS, esp_timer, gpio and board support calls the link
+ * makes, one instance per node
+ *
+ * every node is the link code plus this port built into a shared module that the
+ * harness loads once per node (see link_sim.c), so each node has its own statics,
+ * its own radio and its own set of tasks. tasks are coroutines scheduled by
+ * priority, FIFO among equals; one runs until it blocks or readies a higher
+ * priority task. esp_timer_get_time() is the node's radio clock, which only moves
+ * with SPI traffic, BUSY waits and lr11xx_channel_advance()
+ *
+ * harness loop per node: host_port_run() after the channel advanced, then
+ * host_port_next_event_us() for the next timer or task timeout
+ */
+
+/*!
+ * @brief power on the radio, name the node for the log, seed esp_random
+ */
+void host_port_setup(const char* name, uint32_t seed, esp_log_level_t level);
+
+/*!
+ * @returns the node's radio, to connect to the channel
+ */
+lr11xx_sim_t* host_port_radio(void);
+
+/*!
+ * @brief create the app task, it runs on the next host_port_run()
+ */
+void host_port_start(TaskFunction_t app, void* arg, UBaseType_t priority);
+
+/*!
+ * @brief fire due timers and the DIO isr, run tasks until all of them block
+ */
+void host_port_run(void);
+
+/*!
+ * @returns earliest timer or task timeout, UINT64_MAX if none
+ */
+uint64_t host_port_next_event_us(void);
+
+/*!
+ * @brief printf for the Semtech examples code, logged at ESP_LOG_INFO
+ */
+int host_port_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef DRIVER_SPI_COMMON_H
+#define DRIVER_SPI_COMMON_H
+
+#include "esp_err.h"
+
+typedef enum spi_host_device_e {
+	SPI1_HOST,
+	SPI2_HOST,
+	SPI3_HOST,
+} spi_host_device_t;
+
+typedef enum spi_dma_chan_e {
+	SPI_DMA_DISABLED,
+	SPI_DMA_CH_AUTO = 3,
+} spi_dma_chan_t;
+
+typedef struct spi_bus_config_s {
+	int mosi_io_num;
+	int miso_io_num;
+	int sclk_io_num;
+	int quadwp_io_num;
+	int quadhd_io_num;
+	int max_transfer_sz;
+} spi_bus_config_t;
+
+// no bus on the host, lr11xx_sim_hal.c talks to the simulated radio directly
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* config, spi_dma_chan_t dma);
+
+#endif
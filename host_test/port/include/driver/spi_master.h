@@ -0,0 +1,20 @@
+#ifndef DRIVER_SPI_MASTER_H
+#define DRIVER_SPI_MASTER_H
+
+#include <stdint.h>
+
+#include "driver/spi_common.h"
+
+typedef struct host_spi_device_s* spi_device_handle_t;
+
+typedef struct spi_device_interface_config_s {
+	int clock_speed_hz;
+	uint8_t mode;
+	int spics_io_num;
+	int queue_size;
+} spi_device_interface_config_t;
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* config,
+		spi_device_handle_t* handle);
+
+#endif
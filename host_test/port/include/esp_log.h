@@ -0,0 +1,25 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdint.h>
+
+typedef enum esp_log_level_e {
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+// prefixed with the node name and virtual time, filtered by the host_port_setup level
+void host_port_log(esp_log_level_t level, const char* tag, const char* format, ...)
+		__attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...)	host_port_log(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	host_port_log(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	host_port_log(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)	host_port_log(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)	host_port_log(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif
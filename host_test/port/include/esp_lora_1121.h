@@ -0,0 +1,63 @@
+#ifndef WAVESHARE_LORA_SPI_H
+#define WAVESHARE_LORA_SPI_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_attr.h"
+
+#include "lr11xx_hal.h"
+#include "lr11xx_system.h"
+#include "lr11xx_radio.h"
+#include "lr11xx_regmem.h"
+
+#include "lr11xx_radio_types_str.h"
+#include "lr11xx_system_types_str.h"
+
+#include "lr1121_common.h"
+
+#include "lr11xx_sim.h"
+
+/*
+ * host stand-in for components/esp_lora_1121/include/esp_lora_1121.h: the board
+ * support the link calls, on top of lr11xx_sim. the radio context is the sim, so
+ * it comes first and lr11xx_sim_hal.c can take the context pointer as a sim
+ */
+
+#define USE_LR11XX_SPI_HW_CS
+#define LORA_SPI_BUFFER_SIZE 260
+#define LORA_BUSY_OPCODE_NONE 0xFFFF
+
+typedef struct lora_busy_stats_s {
+	uint16_t opcode;
+	uint32_t count;
+	uint32_t sleeps;
+	uint32_t total_us;
+	uint32_t max_us;
+} lora_busy_stats_t;
+
+typedef struct lr1121_s {
+	lr11xx_sim_t sim;
+	uint8_t cs;
+	uint8_t reset;
+	uint8_t busy;
+	uint8_t irq;
+	gpio_isr_t isr;
+	bool irq_enabled;
+	bool irq_level;		// dio level at the last poll, edges raise the isr
+} lr1121_t;
+
+void lora_init_io_context(const void* context, uint8_t cs, uint8_t reset, uint8_t busy, uint8_t irq);
+void lora_init_io(const void* context);
+void lora_init_irq(const void* context, gpio_isr_t handler);
+void lora_spi_init(const void* context, spi_device_handle_t spi);
+
+// BUSY waits are totalled by the sim (lr11xx_sim_stats_t), not per opcode: returns 0
+uint8_t lora_busy_get_stats(const void* context, lora_busy_stats_t* stats, uint8_t max_count);
+
+// no trace ring on the host
+void lora_trace_dump(const void* context);
+
+#endif
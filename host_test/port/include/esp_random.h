@@ -0,0 +1,9 @@
+#ifndef ESP_RANDOM_H
+#define ESP_RANDOM_H
+
+#include <stdint.h>
+
+// per node, seeded by host_port_setup so runs are reproducible
+uint32_t esp_random(void);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * host port of the FreeRTOS subset the link uses, implemented in host_port.c.
+ * tasks are coroutines on one thread, so critical sections have nothing to
+ * exclude and a task only loses the cpu at a blocking call or when a call of its
+ * own readies a higher priority task
+ */
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE			1
+#define pdFALSE			0
+#define pdPASS			pdTRUE
+#define pdFAIL			pdFALSE
+#define portMAX_DELAY		((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS	1
+#define pdMS_TO_TICKS(ms)	((TickType_t)(ms))
+
+#include "portmacro.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef FREERTOS_IDF_ADDITIONS_H
+#define FREERTOS_IDF_ADDITIONS_H
+
+#include "freertos/task.h"
+
+#endif
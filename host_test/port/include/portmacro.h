@@ -0,0 +1,16 @@
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+// see freertos/FreeRTOS.h: one host thread runs every task and isr
+typedef struct portMUX_TYPE_s {
+	int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED	{ 0 }
+#define portENTER_CRITICAL(mux)		((void)(mux))
+#define portEXIT_CRITICAL(mux)		((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)	((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)	((void)(mux))
+#define portYIELD_FROM_ISR(woken)	((void)(woken))
+
+#endif
@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include "stormwater_drone_lora_arq.h"
+#include "test_check.h"
+
+/*
+ * arq window, one end of the link: the test plays the peer by hand-building its
+ * packets. covers the window filling up, selective repeat, sequence numbers
+ * wrapping at 256 on both sides, first contact and reboots (epoch and window
+ * base) and frames held back with nowhere to deliver them
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define OUR_EPOCH	1
+#define PEER_EPOCH	2
+
+typedef struct peer_packet_s {
+	uint8_t epoch;
+	uint8_t echo;		// our epoch as the peer last heard it
+	uint8_t seq;
+	uint8_t ack;
+	uint8_t bitmap;
+	uint8_t base;
+	uint8_t length;		// frame bytes after the header, 0 for acks only
+} peer_packet_t;
+
+static uint8_t packet[ARQ_HEADER_LENGTH + ARQ_MAX_FRAME_LENGTH];
+static const uint8_t frame[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
+
+static bool receive(const peer_packet_t* peer, bool covers_last_tx, bool can_deliver) {
+	uint8_t buf[ARQ_HEADER_LENGTH + sizeof(frame)];
+	const uint8_t* received;
+	uint8_t received_length;
+
+	buf[0] = (uint8_t)(peer->epoch << 4 | peer->echo);
+	buf[1] = peer->seq;
+	buf[2] = peer->ack;
+	buf[3] = peer->bitmap;
+	buf[4] = peer->base;
+	memcpy(buf + ARQ_HEADER_LENGTH, frame, peer->length);
+
+	bool delivered = stormwater_drone_lora_arq_receive(buf, ARQ_HEADER_LENGTH + peer->length, covers_last_tx,
+			can_deliver, &received, &received_length);
+	CHECK(received == buf + ARQ_HEADER_LENGTH);
+	CHECK(received_length == peer->length);
+	return delivered;
+}
+
+// a peer frame with seq and base, acking nothing of ours
+static bool receive_frame(uint8_t seq, uint8_t base) {
+	const peer_packet_t peer = { PEER_EPOCH, 0, seq, 0, 0, base, sizeof(frame) };
+
+	return receive(&peer, false, true);
+}
+
+// an ack from the peer for everything before ack plus the bitmap
+static void receive_ack(uint8_t ack, uint8_t bitmap, bool covers_last_tx) {
+	const peer_packet_t peer = { PEER_EPOCH, OUR_EPOCH, 0, ack, bitmap, 0, 0 };
+
+	CHECK(!receive(&peer, covers_last_tx, true));
+}
+
+// seq of the next packet sent, with its header checked
+static uint8_t next_seq(void) {
+	uint8_t length = stormwater_drone_lora_arq_next(packet);
+
+	CHECK(packet[0] >> 4 == OUR_EPOCH);
+	CHECK(length >= ARQ_HEADER_LENGTH);
+	return packet[1];
+}
+
+static void test_window_full(void) {
+	stormwater_drone_lora_arq_stats_t stats;
+
+	stormwater_drone_lora_arq_reset(OUR_EPOCH);
+	CHECK(!stormwater_drone_lora_arq_push(frame, 0));
+	CHECK(!stormwater_drone_lora_arq_push(packet, ARQ_MAX_FRAME_LENGTH + 1));
+	for(uint8_t i = 0; i < ARQ_WINDOW; i++) {
+		CHECK(stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+	}
+	CHECK(!stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+
+	// sending does not free a slot, only the ack does, and only from the front
+	for(uint8_t i = 0; i < ARQ_WINDOW; i++) {
+		CHECK(next_seq() == i);
+	}
+	CHECK(!stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+	receive_ack(0, 0x01, true);
+	CHECK(!stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+	receive_ack(2, 0x00, true);
+	CHECK(stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+	CHECK(stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+	CHECK(!stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+
+	stormwater_drone_lora_arq_get_stats(&stats);
+	CHECK(stats.sent == ARQ_WINDOW);
+	CHECK(stats.acked == 2);
+}
+
+static void test_selective_repeat(void) {
+	stormwater_drone_lora_arq_stats_t stats;
+
+	stormwater_drone_lora_arq_reset(OUR_EPOCH);
+	for(uint8_t i = 0; i < 4; i++) {
+		CHECK(stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+		CHECK(next_seq() == i);
+	}
+	CHECK(packet[4] == 0);
+
+	// peer got 0 and 2: only 1 and 3 go again, oldest first, then 1 is repeated
+	receive_ack(1, 0x01, true);
+	CHECK(next_seq() == 1);
+	CHECK(packet[4] == 1);
+	CHECK(next_seq() == 3);
+	CHECK(next_seq() == 1);
+
+	// an ack sent before the peer heard our last packet says nothing about it
+	receive_ack(1, 0x01, false);
+	CHECK(next_seq() == 3);
+	CHECK(next_seq() == 1);
+
+	// peek stages the same packet without sending it
+	uint8_t staged[sizeof(packet)];
+	stormwater_drone_lora_arq_peek(staged);
+	CHECK(staged[1] == 1);
+	stormwater_drone_lora_arq_get_stats(&stats);
+	CHECK(stats.retransmitted == 5);
+
+	// all acked: the window empties and the last frame repeats as a duplicate
+	receive_ack(4, 0x00, true);
+	CHECK(stormwater_drone_lora_arq_next(packet) == ARQ_HEADER_LENGTH + sizeof(frame));
+	CHECK(packet[4] == 4);
+	stormwater_drone_lora_arq_get_stats(&stats);
+	CHECK(stats.acked == 4);
+	CHECK(stats.retransmitted == 5);
+
+	// an ack only packet carries no frame
+	CHECK(stormwater_drone_lora_arq_ack(packet) == ARQ_HEADER_LENGTH);
+}
+
+static void test_wraparound(void) {
+	stormwater_drone_lora_arq_stats_t stats;
+
+	// sender: 600 frames through a window of 8, sequence numbers mod 256
+	stormwater_drone_lora_arq_reset(OUR_EPOCH);
+	for(uint16_t i = 0; i < 600; i++) {
+		CHECK(stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+		CHECK(next_seq() == (uint8_t)i);
+		// ack every other one out of order first: the bitmap must work across the wrap
+		if(i % 2 == 1) {
+			receive_ack((uint8_t)(i - 1), 0x01, false);
+			receive_ack((uint8_t)(i + 1), 0x00, true);
+		}
+	}
+	stormwater_drone_lora_arq_get_stats(&stats);
+	CHECK(stats.sent == 600);
+	CHECK(stats.acked == 600);
+	CHECK(stats.retransmitted == 0);
+
+	// receiver: in order through the wrap, then out of order across it
+	stormwater_drone_lora_arq_reset(OUR_EPOCH);
+	CHECK(receive_frame(250, 250));
+	for(uint16_t seq = 251; seq < 260; seq++) {
+		CHECK(receive_frame((uint8_t)seq, (uint8_t)(seq - 1)));
+	}
+	CHECK(!receive_frame(255, 255));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 4);
+	CHECK(packet[3] == 0);
+
+	CHECK(receive_frame(6, 4));
+	CHECK(!receive_frame(6, 4));
+	CHECK(receive_frame(4, 4));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 5);
+	CHECK(packet[3] == 0x01);
+	CHECK(receive_frame(5, 4));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 7);
+	CHECK(packet[3] == 0);
+
+	stormwater_drone_lora_arq_get_stats(&stats);
+	CHECK(stats.delivered == 13);
+	CHECK(stats.duplicates == 2);
+}
+
+static void test_first_contact(void) {
+	stormwater_drone_lora_arq_reset(OUR_EPOCH);
+
+	// before the peer is heard our acks carry epoch 0 and the peer ignores them
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK((packet[0] & 0x0F) == 0);
+
+	// the first frame heard is 5, but the peer still holds 3 and 4: ask for them
+	CHECK(receive_frame(5, 3));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK((packet[0] & 0x0F) == PEER_EPOCH);
+	CHECK(packet[2] == 3);
+	CHECK(packet[3] == 0x02);
+	CHECK(receive_frame(3, 3));
+	CHECK(receive_frame(4, 3));
+	CHECK(!receive_frame(5, 3));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 6);
+	CHECK(packet[3] == 0);
+
+	// the base moving on means the peer holds nothing older: skip to it, then
+	// over what already arrived after it
+	CHECK(receive_frame(8, 6));
+	CHECK(receive_frame(10, 7));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 7);
+	CHECK(receive_frame(12, 8));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 9);
+	CHECK(packet[3] == 0x05);
+	CHECK(!receive_frame(8, 8));
+
+	// acks echoing another boot of ours are stale
+	CHECK(stormwater_drone_lora_arq_push(frame, sizeof(frame)));
+	CHECK(next_seq() == 0);
+	const peer_packet_t stale = { PEER_EPOCH, OUR_EPOCH + 1, 0, 1, 0, 9, 0 };
+	CHECK(!receive(&stale, true, true));
+	CHECK(next_seq() == 0);
+	stormwater_drone_lora_arq_stats_t stats;
+	stormwater_drone_lora_arq_get_stats(&stats);
+	CHECK(stats.acked == 0);
+
+	// the peer reboots: its numbers start over, 0 is new again
+	const peer_packet_t rebooted = { PEER_EPOCH + 1, 0, 0, 0, 0, 0, sizeof(frame) };
+	CHECK(receive(&rebooted, false, true));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK((packet[0] & 0x0F) == PEER_EPOCH + 1);
+	CHECK(packet[2] == 1);
+	CHECK(packet[3] == 0);
+}
+
+static void test_cannot_deliver(void) {
+	const peer_packet_t peer = { PEER_EPOCH, 0, 0, 0, 0, 0, sizeof(frame) };
+
+	stormwater_drone_lora_arq_reset(OUR_EPOCH);
+	// no room: left unacked so the peer sends it again, and it is new then
+	CHECK(!receive(&peer, false, false));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 0);
+	CHECK(receive(&peer, false, true));
+	stormwater_drone_lora_arq_ack(packet);
+	CHECK(packet[2] == 1);
+
+	// a packet too short for the header is ignored
+	const uint8_t* received;
+	uint8_t received_length;
+	CHECK(!stormwater_drone_lora_arq_receive(packet, ARQ_HEADER_LENGTH - 1, true, true, &received, &received_length));
+}
+
+// --- PUBLIC METHODS ---
+
+int main(void) {
+	test_window_full();
+	test_selective_repeat();
+	test_wraparound();
+	test_first_contact();
+	test_cannot_deliver();
+	return TEST_RESULT();
+}
@@ -0,0 +1,276 @@
+#include <math.h>
+#include <string.h>
+
+#include "lr1121_common.h"
+#include "lr1121_config.h"
+#include "lr11xx_radio.h"
+#include "stormwater_frame.h"
+#include "test_check.h"
+
+/*
+ * stormwater_frame batches: delta/bit-packed samples come back exactly at the
+ * fixed-point resolution of a telemetry frame, oversize batches drop their oldest
+ * samples, corruption is refused, and stormwater_frame_batch_push slides over a
+ * full batch. prints the compression against one telemetry frame per reading on
+ * sensor traces
+ *
+ * the tree holds no recorded sensor logs, so the traces are generated: a sensor
+ * averaged over SAMPLES_PER_AVERAGE loops drifts slowly with a little noise, a
+ * noisier sensor, a pump switching on, and a stuck sensor
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define TRACE_LENGTH		4096
+#define LORA_MAX_FRAME		64	// LORA_MAX_FRAME_LENGTH with arq off
+
+typedef struct trace_s {
+	const char* name;
+	float swing;			// 1: daily swing, 0: flat
+	float temp_noise_c;
+	float do_noise_ugl;
+	float pH_noise;
+	uint32_t pump_on_at;		// DO steps up and pH down from this sample, 0 = never
+} trace_t;
+
+static uint32_t rng = 1;
+
+static float noise(float amplitude) {
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return amplitude * ((float)(rng & 0xFFFF) / 32768.0f - 1.0f);
+}
+
+// one average per minute: a day is 1440 samples
+static void trace_sample(const trace_t* trace, uint32_t i, stormwater_frame_sample_t* sample) {
+	float day = 2.0f * (float)M_PI * (float)i / 1440.0f;
+	bool pump = trace->pump_on_at != 0 && i >= trace->pump_on_at;
+
+	sample->temp_c = 18.0f + trace->swing * 3.0f * sinf(day) + noise(trace->temp_noise_c);
+	sample->do_ugl = 8000.0f + trace->swing * 500.0f * sinf(day + 1.0f) + (pump ? 2500.0f : 0.0f) +
+			noise(trace->do_noise_ugl);
+	sample->pH = 7.2f + trace->swing * 0.05f * sinf(day + 2.0f) - (pump ? 0.3f : 0.0f) + noise(trace->pH_noise);
+}
+
+// what a telemetry frame carries for the same reading
+static stormwater_frame_sample_t quantized(const stormwater_frame_sample_t* sample) {
+	stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_TELEMETRY,
+		.telemetry = { .temp_c = sample->temp_c, .do_ugl = sample->do_ugl, .pH = sample->pH },
+	};
+	uint8_t buf[STORMWATER_FRAME_LENGTH];
+	stormwater_frame_sample_t out;
+
+	stormwater_frame_encode(&frame, buf, sizeof(buf));
+	stormwater_frame_decode(buf, sizeof(buf), &frame);
+	out.temp_c = frame.telemetry.temp_c;
+	out.do_ugl = frame.telemetry.do_ugl;
+	out.pH = frame.telemetry.pH;
+	return out;
+}
+
+static bool same_sample(const stormwater_frame_sample_t* a, const stormwater_frame_sample_t* b) {
+	return a->temp_c == b->temp_c && a->do_ugl == b->do_ugl && a->pH == b->pH;
+}
+
+// encode, decode and compare with the newest encoded_count samples, quantized
+static size_t round_trip(const stormwater_frame_batch_t* batch, size_t buf_length, uint8_t* encoded_count) {
+	uint8_t buf[256];
+	stormwater_frame_batch_t decoded;
+	size_t length = stormwater_frame_batch_encode(batch, buf, buf_length, encoded_count);
+
+	CHECK(length != 0 && length <= buf_length);
+	if(length == 0) {
+		return 0;
+	}
+	CHECK(stormwater_frame_batch_decode(buf, length, &decoded) == STORMWATER_FRAME_OK);
+	CHECK(decoded.addr == batch->addr);
+	CHECK(decoded.seq == batch->seq);
+	CHECK(decoded.count == *encoded_count);
+	for(uint8_t i = 0; i < *encoded_count && i < decoded.count; i++) {
+		stormwater_frame_sample_t expected = quantized(&batch->samples[batch->count - *encoded_count + i]);
+		CHECK(same_sample(&decoded.samples[i], &expected));
+	}
+	return length;
+}
+
+static void test_round_trip(void) {
+	static const trace_t trace = { "drift", 1.0f, 0.02f, 5.0f, 0.002f, 0 };
+	stormwater_frame_batch_t batch = { .addr = 2, .seq = 77 };
+	uint8_t encoded_count;
+
+	for(uint8_t count = 1; count <= STORMWATER_FRAME_BATCH_MAX_SAMPLES; count++) {
+		batch.count = count;
+		for(uint8_t i = 0; i < count; i++) {
+			trace_sample(&trace, i, &batch.samples[i]);
+		}
+		round_trip(&batch, 256, &encoded_count);
+		CHECK(encoded_count == count);
+	}
+
+	// full scale swings need the widest deltas, 17 bits for temperature
+	batch.count = STORMWATER_FRAME_BATCH_MAX_SAMPLES;
+	for(uint8_t i = 0; i < batch.count; i++) {
+		batch.samples[i].temp_c = i & 1 ? 327.67f : -327.68f;
+		batch.samples[i].do_ugl = i & 1 ? 65535.0f : 0.0f;
+		batch.samples[i].pH = i & 1 ? 0.0f : 65.535f;
+	}
+	round_trip(&batch, 256, &encoded_count);
+	CHECK(encoded_count == batch.count);
+
+	// only the newest samples that fit are sent
+	round_trip(&batch, LORA_MAX_FRAME, &encoded_count);
+	CHECK(encoded_count > 0 && encoded_count < batch.count);
+
+	// not even one sample fits
+	CHECK(stormwater_frame_batch_encode(&batch, (uint8_t[16]){ 0 }, STORMWATER_FRAME_BATCH_MIN_LENGTH - 1,
+			&encoded_count) == 0);
+	CHECK(encoded_count == 0);
+	batch.count = 0;
+	CHECK(stormwater_frame_batch_encode(&batch, (uint8_t[64]){ 0 }, 64, &encoded_count) == 0);
+}
+
+static void test_rejects(void) {
+	static const trace_t trace = { "drift", 1.0f, 0.02f, 5.0f, 0.002f, 0 };
+	stormwater_frame_batch_t batch = { .addr = 1, .seq = 1, .count = 8 };
+	stormwater_frame_batch_t decoded;
+	uint8_t buf[64];
+	uint8_t copy[64];
+	uint8_t encoded_count;
+	size_t length;
+
+	for(uint8_t i = 0; i < batch.count; i++) {
+		trace_sample(&trace, i, &batch.samples[i]);
+	}
+	length = stormwater_frame_batch_encode(&batch, buf, sizeof(buf), &encoded_count);
+	CHECK(length >= STORMWATER_FRAME_BATCH_MIN_LENGTH);
+	CHECK(stormwater_frame_batch_decode(buf, length - 1, &decoded) != STORMWATER_FRAME_OK);
+
+	// a flipped bit never decodes: the count or widths then claim another length, or the crc fails
+	for(size_t byte = 0; byte < length; byte++) {
+		for(uint8_t bit = 0; bit < 8; bit++) {
+			memcpy(copy, buf, length);
+			copy[byte] ^= (uint8_t)(1 << bit);
+			CHECK(stormwater_frame_batch_decode(copy, length, &decoded) != STORMWATER_FRAME_OK);
+		}
+	}
+
+	// a telemetry frame is not a batch
+	const stormwater_frame_t frame = { .type = STORMWATER_FRAME_TYPE_TELEMETRY };
+	memset(copy, 0, sizeof(copy));
+	stormwater_frame_encode(&frame, copy, sizeof(copy));
+	CHECK(stormwater_frame_batch_decode(copy, STORMWATER_FRAME_BATCH_MIN_LENGTH, &decoded) ==
+			STORMWATER_FRAME_ERR_TYPE);
+}
+
+static void test_push(void) {
+	stormwater_frame_batch_t batch = { .count = 0 };
+	stormwater_frame_sample_t sample = { 0 };
+
+	// fills up to capacity, then slides: the newest capacity samples, oldest first
+	for(uint8_t i = 0; i < 20; i++) {
+		sample.temp_c = i;
+		stormwater_frame_batch_push(&batch, &sample, 8);
+		CHECK(batch.count == (i < 8 ? i + 1 : 8));
+	}
+	for(uint8_t i = 0; i < batch.count; i++) {
+		CHECK(batch.samples[i].temp_c == 12 + i);
+	}
+
+	// a smaller capacity than the batch holds drops down to it
+	stormwater_frame_batch_push(&batch, &sample, 4);
+	CHECK(batch.count == 4);
+	CHECK(batch.samples[0].temp_c == 17 && batch.samples[3].temp_c == 19);
+
+	// capacity is bounded by the frame
+	batch.count = 0;
+	for(uint8_t i = 0; i < 40; i++) {
+		sample.temp_c = i;
+		stormwater_frame_batch_push(&batch, &sample, 200);
+	}
+	CHECK(batch.count == STORMWATER_FRAME_BATCH_MAX_SAMPLES);
+	CHECK(batch.samples[0].temp_c == 40 - STORMWATER_FRAME_BATCH_MAX_SAMPLES);
+}
+
+static uint32_t airtime_ms(uint8_t sf, uint8_t length) {
+	const lr11xx_radio_pkt_params_lora_t pkt = {
+		.preamble_len_in_symb = LORA_PREAMBLE_LENGTH,
+		.header_type = LORA_PKT_LEN_MODE,
+		.pld_len_in_bytes = length,
+		.crc = LORA_CRC,
+		.iq = LORA_IQ,
+	};
+	const lr11xx_radio_mod_params_lora_t mod = {
+		.sf = (lr11xx_radio_lora_sf_t)sf,
+		.bw = LORA_BANDWIDTH,
+		.cr = LORA_CODING_RATE,
+		.ldro = smtc_shield_lr11xx_common_compute_lora_ldro((lr11xx_radio_lora_sf_t)sf, LORA_BANDWIDTH),
+	};
+
+	return lr11xx_radio_get_lora_time_on_air_in_ms(&pkt, &mod);
+}
+
+/*
+ * whole traces in batches of batch_samples, as the drone sends them: bytes and
+ * time on air per reading against a telemetry frame each
+ */
+static void print_compression(void) {
+	static const trace_t traces[] = {
+		{ "drift",	1.0f,	0.02f,	5.0f,	0.002f,	0 },
+		{ "noisy",	1.0f,	0.2f,	50.0f,	0.02f,	0 },
+		{ "pump on",	1.0f,	0.02f,	5.0f,	0.002f,	TRACE_LENGTH / 2 + 3 },	// inside a batch
+		{ "stuck",	0.0f,	0.0f,	0.0f,	0.0f,	0 },
+	};
+	static const uint8_t batch_sizes[] = { 8, 16 };
+	stormwater_frame_batch_t batch = { .addr = 1 };
+	uint32_t readings;
+	uint32_t bytes;
+	uint32_t sf7_ms;
+	uint32_t sf10_ms;
+	uint8_t encoded_count;
+
+	printf("%u readings per trace; a telemetry frame per reading is %u B, %u ms at SF7, %u ms at SF10 (BW125 CR4/5)\n",
+			TRACE_LENGTH, STORMWATER_FRAME_LENGTH, airtime_ms(LR11XX_RADIO_LORA_SF7, STORMWATER_FRAME_LENGTH),
+			airtime_ms(LR11XX_RADIO_LORA_SF10, STORMWATER_FRAME_LENGTH));
+	printf("%-8s %5s %5s %9s %6s %10s %11s\n", "trace", "batch", "sent", "B/reading", "ratio", "SF7 ms/rdg",
+			"SF10 ms/rdg");
+	for(size_t t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+		for(size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+			rng = 1;
+			readings = bytes = sf7_ms = sf10_ms = 0;
+			batch.count = 0;
+			for(uint32_t i = 0; i < TRACE_LENGTH; i++) {
+				stormwater_frame_sample_t sample;
+
+				trace_sample(&traces[t], i, &sample);
+				stormwater_frame_batch_push(&batch, &sample, batch_sizes[b]);
+				if(batch.count == batch_sizes[b]) {
+					size_t length = round_trip(&batch, LORA_MAX_FRAME, &encoded_count);
+
+					readings += encoded_count;
+					bytes += length;
+					sf7_ms += airtime_ms(LR11XX_RADIO_LORA_SF7, length);
+					sf10_ms += airtime_ms(LR11XX_RADIO_LORA_SF10, length);
+					batch.count = 0;
+					batch.seq++;
+				}
+			}
+			printf("%-8s %5u %5u %9.2f %6.2f %10.1f %11.1f\n", traces[t].name, batch_sizes[b], readings,
+					(double)bytes / readings, (double)STORMWATER_FRAME_LENGTH * readings / bytes,
+					(double)sf7_ms / readings, (double)sf10_ms / readings);
+			// a batch too wide for the frame drops its oldest samples, rarely
+			CHECK(readings + TRACE_LENGTH / 100 >= TRACE_LENGTH);
+		}
+	}
+}
+
+// --- PUBLIC METHODS ---
+
+int main(void) {
+	test_round_trip();
+	test_rejects();
+	test_push();
+	print_compression();
+	return TEST_RESULT();
+}
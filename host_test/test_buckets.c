@@ -0,0 +1,119 @@
+#include "stormwater_drone_lora_airtime.h"
+#include "stormwater_drone_lora_buckets.h"
+#include "test_check.h"
+
+/*
+ * bucket ring shared by the airtime budget and the link stats: sums over the
+ * sliding window, buckets from an older pass of the ring dropping out, the time
+ * until enough has slid out, and the airtime budget built on it
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define SECOND_US	1000000LL
+
+static void test_sum(void) {
+	stormwater_drone_lora_bucket_t storage[4];
+	stormwater_drone_lora_buckets_t window;
+
+	// 4 buckets of 1 s: the window is the current second and the 3 before it
+	stormwater_drone_lora_buckets_init(&window, storage, 4, SECOND_US);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 0) == 0);
+
+	stormwater_drone_lora_buckets_add(&window, 0, 10);
+	stormwater_drone_lora_buckets_add(&window, SECOND_US - 1, 5);
+	stormwater_drone_lora_buckets_add(&window, 2 * SECOND_US, 20);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 2 * SECOND_US) == 35);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 4 * SECOND_US - 1) == 35);
+	// the first bucket slides out at 4 s, the third at 6 s
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 4 * SECOND_US) == 20);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 6 * SECOND_US) == 0);
+
+	// the ring comes round: slot 0 is reused for second 4, its old 15 is gone
+	stormwater_drone_lora_buckets_add(&window, 4 * SECOND_US, 1);
+	CHECK(storage[0].sum == 1);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 4 * SECOND_US) == 21);
+
+	// a long silence: every bucket is from an older pass
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 1000 * SECOND_US) == 0);
+	stormwater_drone_lora_buckets_add(&window, 1000 * SECOND_US, 7);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 1000 * SECOND_US) == 7);
+
+	stormwater_drone_lora_buckets_reset(&window);
+	CHECK(stormwater_drone_lora_buckets_sum(&window, 1000 * SECOND_US) == 0);
+}
+
+static void test_expire(void) {
+	stormwater_drone_lora_bucket_t storage[4];
+	stormwater_drone_lora_buckets_t window;
+
+	stormwater_drone_lora_buckets_init(&window, storage, 4, SECOND_US);
+	stormwater_drone_lora_buckets_add(&window, SECOND_US, 10);
+	stormwater_drone_lora_buckets_add(&window, 2 * SECOND_US, 20);
+	stormwater_drone_lora_buckets_add(&window, 3 * SECOND_US, 30);
+
+	// at 3.5 s: second 1 leaves at 5 s, second 2 at 6 s, second 3 at 7 s
+	const int64_t now = 3 * SECOND_US + SECOND_US / 2;
+	CHECK(stormwater_drone_lora_buckets_expire_us(&window, now, 0) == SECOND_US / 2);
+	CHECK(stormwater_drone_lora_buckets_expire_us(&window, now, 10) == SECOND_US + SECOND_US / 2);
+	CHECK(stormwater_drone_lora_buckets_expire_us(&window, now, 11) == 2 * SECOND_US + SECOND_US / 2);
+	CHECK(stormwater_drone_lora_buckets_expire_us(&window, now, 60) == 3 * SECOND_US + SECOND_US / 2);
+	// more than the window holds: until it is empty
+	CHECK(stormwater_drone_lora_buckets_expire_us(&window, now, 1000) == 3 * SECOND_US + SECOND_US / 2);
+
+	// early in the run the window reaches back before time 0
+	stormwater_drone_lora_buckets_reset(&window);
+	stormwater_drone_lora_buckets_add(&window, 0, 10);
+	CHECK(stormwater_drone_lora_buckets_expire_us(&window, SECOND_US / 2, 10) == 3 * SECOND_US + SECOND_US / 2);
+}
+
+// both users: one hour in 60 one minute buckets, one minute in 12 of 5 s
+static void test_configurations(void) {
+	stormwater_drone_lora_bucket_t hour[60];
+	stormwater_drone_lora_bucket_t minute[12];
+	stormwater_drone_lora_buckets_t hour_window;
+	stormwater_drone_lora_buckets_t minute_window;
+
+	stormwater_drone_lora_buckets_init(&hour_window, hour, 60, 60 * SECOND_US);
+	stormwater_drone_lora_buckets_init(&minute_window, minute, 12, 5 * SECOND_US);
+	// a 50 ms packet every 10 s for two hours
+	for(int64_t t = 0; t < 7200 * SECOND_US; t += 10 * SECOND_US) {
+		stormwater_drone_lora_buckets_add(&hour_window, t, 50000);
+		stormwater_drone_lora_buckets_add(&minute_window, t, 50000);
+	}
+	const int64_t end = 7200 * SECOND_US - 1;
+	CHECK(stormwater_drone_lora_buckets_sum(&hour_window, end) == 360 * 50000);
+	CHECK(stormwater_drone_lora_buckets_sum(&minute_window, end) == 6 * 50000);
+}
+
+static void test_airtime(void) {
+	const uint32_t budget_us = (uint32_t)((uint64_t)AIRTIME_WINDOW_MS * AIRTIME_BUDGET_PERMILLE);
+	const uint32_t bulk_us = (uint32_t)((uint64_t)AIRTIME_WINDOW_MS * AIRTIME_BULK_PERMILLE);
+	const int64_t bucket_us = (int64_t)AIRTIME_WINDOW_MS * 1000 / AIRTIME_BUCKETS;
+	stormwater_drone_lora_airtime_stats_t stats;
+
+	stormwater_drone_lora_airtime_reset();
+	CHECK(stormwater_drone_lora_airtime_wait_us(0, budget_us * 2, false) == 0);
+
+	// fill the bulk share in the first bucket: bulk waits for it to slide out, control still goes
+	stormwater_drone_lora_airtime_add(0, bulk_us);
+	CHECK(stormwater_drone_lora_airtime_wait_us(bucket_us, 1, false) == 0);
+	CHECK(stormwater_drone_lora_airtime_wait_us(bucket_us, 1, true) == (uint32_t)((AIRTIME_BUCKETS - 1) * bucket_us));
+	stormwater_drone_lora_airtime_add(bucket_us, budget_us - bulk_us);
+	CHECK(stormwater_drone_lora_airtime_wait_us(bucket_us, 1, false) == (uint32_t)((AIRTIME_BUCKETS - 1) * bucket_us));
+	CHECK(stormwater_drone_lora_airtime_wait_us(AIRTIME_BUCKETS * bucket_us, 1, true) == 0);
+
+	stormwater_drone_lora_airtime_get_stats(&stats, bucket_us);
+	CHECK(stats.used_us == budget_us);
+	CHECK(stats.budget_us == budget_us);
+}
+
+// --- PUBLIC METHODS ---
+
+int main(void) {
+	test_sum();
+	test_expire();
+	test_configurations();
+	test_airtime();
+	return TEST_RESULT();
+}
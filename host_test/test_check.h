@@ -0,0 +1,22 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+
+/*
+ * minimal checks for the host unit tests, one test program per source file:
+ * CHECK logs the failed condition and carries on, main returns TEST_RESULT()
+ */
+
+static int test_failures = 0;
+
+#define CHECK(condition)	do { \
+		if(!(condition)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			test_failures++; \
+		} \
+	} while(0)
+
+#define TEST_RESULT()	(test_failures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,226 @@
+#include <math.h>
+#include <string.h>
+
+#include "lr1121_common.h"
+#include "lr1121_config.h"
+#include "lr11xx_radio.h"
+#include "stormwater_frame.h"
+#include "test_check.h"
+
+/*
+ * stormwater_frame codec: every fixed-size frame type survives encode/decode at
+ * its wire resolution, out of range readings saturate, and corrupt or foreign
+ * buffers are refused. prints time on air per reading against the raw counter
+ * payload it replaced
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+static bool near(float a, float b, float tolerance) {
+	return fabsf(a - b) <= tolerance;
+}
+
+static stormwater_frame_t round_trip(const stormwater_frame_t* frame) {
+	uint8_t buf[STORMWATER_FRAME_LENGTH];
+	stormwater_frame_t decoded;
+
+	memset(&decoded, 0xA5, sizeof(decoded));
+	CHECK(stormwater_frame_encode(frame, buf, sizeof(buf)) == STORMWATER_FRAME_LENGTH);
+	CHECK(stormwater_frame_decode(buf, sizeof(buf), &decoded) == STORMWATER_FRAME_OK);
+	CHECK(decoded.type == frame->type);
+	CHECK(decoded.addr == frame->addr);
+	CHECK(decoded.seq == frame->seq);
+	return decoded;
+}
+
+static void test_telemetry(void) {
+	stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_TELEMETRY,
+		.addr = 3,
+		.seq = 200,
+		.telemetry = {
+			.temp_c = 12.345f,
+			.do_ugl = 8123.4f,
+			.pH = 7.0126f,
+			.status = STORMWATER_FRAME_PUMP | STORMWATER_FRAME_SPOOL | 0x80,
+		},
+	};
+	stormwater_frame_t decoded = round_trip(&frame);
+
+	// rounded to 0.01 degC, 1 ug/L, 0.001 pH
+	CHECK(near(decoded.telemetry.temp_c, 12.35f, 0.0001f));
+	CHECK(decoded.telemetry.do_ugl == 8123.0f);
+	CHECK(near(decoded.telemetry.pH, 7.013f, 0.0001f));
+	CHECK(decoded.telemetry.status == frame.telemetry.status);
+
+	frame.telemetry.temp_c = -3.2f;
+	decoded = round_trip(&frame);
+	CHECK(near(decoded.telemetry.temp_c, -3.2f, 0.0001f));
+
+	// out of range saturates instead of wrapping
+	frame.telemetry.temp_c = 400.0f;
+	frame.telemetry.do_ugl = -5.0f;
+	frame.telemetry.pH = 99.0f;
+	decoded = round_trip(&frame);
+	CHECK(near(decoded.telemetry.temp_c, 327.67f, 0.0001f));
+	CHECK(decoded.telemetry.do_ugl == 0.0f);
+	CHECK(near(decoded.telemetry.pH, 65.535f, 0.0001f));
+
+	frame.telemetry.temp_c = -400.0f;
+	frame.telemetry.do_ugl = 70000.0f;
+	frame.telemetry.pH = NAN;
+	decoded = round_trip(&frame);
+	CHECK(near(decoded.telemetry.temp_c, -327.68f, 0.0001f));
+	CHECK(decoded.telemetry.do_ugl == 65535.0f);
+	CHECK(decoded.telemetry.pH == 0.0f);
+}
+
+static void test_control(void) {
+	const stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_CONTROL,
+		.addr = STORMWATER_FRAME_ADDR_BROADCAST,
+		.seq = 0,
+		.control = {
+			.command = STORMWATER_FRAME_PUMP | STORMWATER_FRAME_FETCH,
+			.adr_id = 9,
+			.adr_sf = LR11XX_RADIO_LORA_SF10,
+			.adr_power_dbm = -9,
+			.adr_bw = LR11XX_RADIO_LORA_BW_250,
+		},
+	};
+	stormwater_frame_t decoded = round_trip(&frame);
+
+	CHECK(decoded.control.command == frame.control.command);
+	CHECK(decoded.control.adr_id == 9);
+	CHECK(decoded.control.adr_sf == LR11XX_RADIO_LORA_SF10);
+	CHECK(decoded.control.adr_power_dbm == -9);
+	CHECK(decoded.control.adr_bw == LR11XX_RADIO_LORA_BW_250);
+}
+
+static void test_beacon(void) {
+	const stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_BEACON,
+		.addr = STORMWATER_FRAME_ADDR_BROADCAST,
+		.seq = 255,
+		.beacon = {
+			.command = STORMWATER_FRAME_SPOOL,
+			.slot_count = 16,
+			.slot_ms = 1234,
+			.poll_mask = 0x8001,
+		},
+	};
+	stormwater_frame_t decoded = round_trip(&frame);
+
+	CHECK(decoded.beacon.command == STORMWATER_FRAME_SPOOL);
+	CHECK(decoded.beacon.slot_count == 16);
+	CHECK(decoded.beacon.slot_ms == 1234);
+	CHECK(decoded.beacon.poll_mask == 0x8001);
+}
+
+static void test_link_stats(void) {
+	stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_LINK_STATS,
+		.addr = 1,
+		.seq = 7,
+		.link_stats = {
+			.per_permille = 123,
+			.rssi_dbm = -117,
+			.snr_db = -12,
+			.snr_min_db = -20,
+			.retries = 3,
+			.airtime_permille = 2000,
+			.rtt_p90_ms = 5,
+		},
+	};
+	stormwater_frame_t decoded = round_trip(&frame);
+
+	// 0.5 % steps (saturating), rtt in 16 ms steps with a measured rtt at least one step
+	CHECK(decoded.link_stats.per_permille == 125);
+	CHECK(decoded.link_stats.rssi_dbm == -117);
+	CHECK(decoded.link_stats.snr_db == -12);
+	CHECK(decoded.link_stats.snr_min_db == -20);
+	CHECK(decoded.link_stats.retries == 3);
+	CHECK(decoded.link_stats.airtime_permille == 255 * 5);
+	CHECK(decoded.link_stats.rtt_p90_ms == 16);
+
+	frame.link_stats.rtt_p90_ms = 0;
+	decoded = round_trip(&frame);
+	CHECK(decoded.link_stats.rtt_p90_ms == 0);
+}
+
+static void test_rejects(void) {
+	const stormwater_frame_t frame = {
+		.type = STORMWATER_FRAME_TYPE_TELEMETRY,
+		.addr = 1,
+		.seq = 1,
+		.telemetry = { .temp_c = 20.0f, .do_ugl = 9000.0f, .pH = 7.5f },
+	};
+	uint8_t buf[STORMWATER_FRAME_LENGTH];
+	uint8_t copy[STORMWATER_FRAME_LENGTH];
+	stormwater_frame_t decoded;
+
+	CHECK(stormwater_frame_encode(&frame, buf, sizeof(buf) - 1) == 0);
+	stormwater_frame_t unknown = frame;
+	unknown.type = (stormwater_frame_type_t)0x0E;
+	CHECK(stormwater_frame_encode(&unknown, buf, sizeof(buf)) == 0);
+
+	CHECK(stormwater_frame_encode(&frame, buf, sizeof(buf)) == STORMWATER_FRAME_LENGTH);
+	CHECK(stormwater_frame_decode(buf, sizeof(buf) - 1, &decoded) == STORMWATER_FRAME_ERR_LENGTH);
+
+	// every single bit error is caught: in the version nibble by the version, anywhere else by the crc
+	for(uint8_t byte = 0; byte < STORMWATER_FRAME_LENGTH; byte++) {
+		for(uint8_t bit = 0; bit < 8; bit++) {
+			memcpy(copy, buf, sizeof(copy));
+			copy[byte] ^= (uint8_t)(1 << bit);
+			stormwater_frame_status_t status = stormwater_frame_decode(copy, sizeof(copy), &decoded);
+			CHECK(status == (byte == 0 && bit >= 4 ? STORMWATER_FRAME_ERR_VERSION : STORMWATER_FRAME_ERR_CRC));
+		}
+	}
+
+	// a well formed frame of a type this build does not know
+	memcpy(copy, buf, sizeof(copy));
+	copy[0] = (uint8_t)((STORMWATER_FRAME_VERSION << 4) | 0x0E);
+	copy[10] = (uint8_t)stormwater_frame_crc16(copy, 10);
+	copy[11] = (uint8_t)(stormwater_frame_crc16(copy, 10) >> 8);
+	CHECK(stormwater_frame_decode(copy, sizeof(copy), &decoded) == STORMWATER_FRAME_ERR_TYPE);
+
+	// crc16 ccitt-false check value
+	CHECK(stormwater_frame_crc16((const uint8_t*)"123456789", 9) == 0x29B1);
+}
+
+// time on air of one reading at the configured packet settings, per spreading factor
+static void print_airtime(void) {
+	lr11xx_radio_pkt_params_lora_t pkt = {
+		.preamble_len_in_symb = LORA_PREAMBLE_LENGTH,
+		.header_type = LORA_PKT_LEN_MODE,
+		.pld_len_in_bytes = STORMWATER_FRAME_LENGTH,
+		.crc = LORA_CRC,
+		.iq = LORA_IQ,
+	};
+	lr11xx_radio_mod_params_lora_t mod = {
+		.bw = LORA_BANDWIDTH,
+		.cr = LORA_CODING_RATE,
+	};
+
+	printf("telemetry frame: %u bytes per reading, the raw counter payload it replaced was %u\n",
+			STORMWATER_FRAME_LENGTH, PAYLOAD_LENGTH);
+	printf("resolution: temp 0.01 degC, DO 1 ug/L, pH 0.001 (uint8 truncation: 1 degC, 1 ug/L of 0..255, 1 pH)\n");
+	printf("time on air per reading, BW125 CR4/5, preamble %u:\n", LORA_PREAMBLE_LENGTH);
+	for(uint8_t sf = LR11XX_RADIO_LORA_SF7; sf <= LR11XX_RADIO_LORA_SF12; sf++) {
+		mod.sf = (lr11xx_radio_lora_sf_t)sf;
+		mod.ldro = smtc_shield_lr11xx_common_compute_lora_ldro(mod.sf, mod.bw);
+		printf("  SF%u %5u ms\n", sf, lr11xx_radio_get_lora_time_on_air_in_ms(&pkt, &mod));
+	}
+}
+
+// --- PUBLIC METHODS ---
+
+int main(void) {
+	test_telemetry();
+	test_control();
+	test_beacon();
+	test_link_stats();
+	test_rejects();
+	print_airtime();
+	return TEST_RESULT();
+}
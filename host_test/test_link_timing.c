@@ -0,0 +1,142 @@
+#include <stdio.h>
+
+#include "host_port.h"
+#include "lr1121_common.h"
+#include "lr1121_config.h"
+#include "lr11xx_radio.h"
+#include "stormwater_drone_lora.h"
+#include "test_check.h"
+
+/*
+ * cached link timing: the link on one simulated radio, reconfigured through every
+ * spreading factor, bandwidth and coding rate. after each the table it publishes
+ * has to match the driver's time on air formula for every payload length, and the
+ * rx windows and symbol time have to follow from it. last, the reply delays set at
+ * runtime have to reach the table
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define RTC_FREQ_IN_HZ		32768
+#define TEST_TIMEOUT_US		(60ULL * 1000000)
+
+static const lr11xx_radio_lora_bw_t bandwidths[] = {
+	LR11XX_RADIO_LORA_BW_125, LR11XX_RADIO_LORA_BW_250, LR11XX_RADIO_LORA_BW_500,
+};
+static const lr11xx_radio_lora_cr_t coding_rates[] = {
+	LR11XX_RADIO_LORA_CR_4_5, LR11XX_RADIO_LORA_CR_4_8,
+};
+
+static bool done = false;
+static uint32_t profiles = 0;
+static uint32_t peer_reply_delay_ms = PEER_REPLY_DELAY;
+
+static uint32_t rtc_steps(uint32_t time_us) {
+	return (uint32_t)(((uint64_t)time_us * RTC_FREQ_IN_HZ + 999999) / 1000000);
+}
+
+static void check_timing(const lora_radio_config_t* config) {
+	stormwater_drone_lora_link_timing_t timing;
+	const uint32_t margin_us = (TX_RX_TRANSITION_DELAY + peer_reply_delay_ms) * 1000;
+	const uint32_t bw_hz = lr11xx_radio_get_lora_bw_in_hz(config->bw);
+	lr11xx_radio_pkt_params_lora_t pkt = {
+		.preamble_len_in_symb = config->preamble_len,
+		.header_type = LORA_PKT_LEN_MODE,
+		.crc = LORA_CRC,
+		.iq = LORA_IQ,
+	};
+	const lr11xx_radio_mod_params_lora_t mod = {
+		.sf = config->sf,
+		.bw = config->bw,
+		.cr = config->cr,
+		.ldro = smtc_shield_lr11xx_common_compute_lora_ldro(config->sf, config->bw),
+	};
+	const uint32_t failures = test_failures;
+
+	stormwater_drone_lora_get_link_timing(&timing);
+
+	for(uint8_t length = 0; length <= LORA_MAX_PAYLOAD_LENGTH; length++) {
+		pkt.pld_len_in_bytes = length;
+		const uint64_t numerator = lr11xx_radio_get_lora_time_on_air_numerator(&pkt, &mod);
+
+		// exact: toa_us is the driver's numerator / bw rounded up, and rounds up to its ms
+		CHECK((uint64_t)timing.toa_us[length] * bw_hz >= numerator * 1000000);
+		CHECK((uint64_t)(timing.toa_us[length] - 1) * bw_hz < numerator * 1000000);
+		CHECK((timing.toa_us[length] + 999) / 1000 == lr11xx_radio_get_lora_time_on_air_in_ms(&pkt, &mod));
+		CHECK(timing.rx_window_rtc[length] ==
+				rtc_steps(timing.toa_us[length] + timing.toa_us[LORA_MAX_PAYLOAD_LENGTH] + margin_us));
+		if(length > 0) {
+			CHECK(timing.toa_us[length] >= timing.toa_us[length - 1]);
+		}
+	}
+	CHECK(timing.symbol_us == (uint32_t)(((uint64_t)1000000 << config->sf) / bw_hz));
+	CHECK(timing.cad_rx_window_rtc ==
+			rtc_steps(timing.toa_us[LORA_MAX_PAYLOAD_LENGTH] + TX_RX_TRANSITION_DELAY * 1000));
+
+	if(test_failures != failures) {
+		fprintf(stderr, "  at SF%u bw %u cr %u preamble %u\n", config->sf, config->bw, config->cr, config->preamble_len);
+	}
+	profiles++;
+}
+
+static void app_task(void* arg) {
+	lora_radio_config_t config;
+
+	stormwater_drone_lora_init();
+	stormwater_drone_lora_get_config(&config);
+	check_timing(&config);
+
+	for(uint8_t sf = LR11XX_RADIO_LORA_SF5; sf <= LR11XX_RADIO_LORA_SF12; sf++) {
+		for(uint8_t bw = 0; bw < sizeof(bandwidths) / sizeof(bandwidths[0]); bw++) {
+			for(uint8_t cr = 0; cr < sizeof(coding_rates) / sizeof(coding_rates[0]); cr++) {
+				config.sf = (lr11xx_radio_lora_sf_t)sf;
+				config.bw = bandwidths[bw];
+				config.cr = coding_rates[cr];
+				// long preambles change the header symbol count, alternate them
+				config.preamble_len = (sf + cr) % 2 == 0 ? LORA_PREAMBLE_LENGTH : 3 * LORA_PREAMBLE_LENGTH;
+				CHECK(stormwater_drone_lora_reconfigure(&config));
+				// the radio task applies it, then the table is rebuilt
+				vTaskDelay(pdMS_TO_TICKS(100));
+				check_timing(&config);
+			}
+		}
+	}
+
+	// the peer answering later widens every rx window; our own delay is armed in rtc steps
+	peer_reply_delay_ms = 2500;
+	stormwater_drone_lora_set_peer_reply_delay(peer_reply_delay_ms);
+	stormwater_drone_lora_set_reply_delay(40);
+	vTaskDelay(pdMS_TO_TICKS(100));
+	check_timing(&config);
+	stormwater_drone_lora_link_timing_t timing;
+	stormwater_drone_lora_get_link_timing(&timing);
+	CHECK(timing.reply_delay_rtc == rtc_steps(40 * 1000));
+	// returning ends the task in the host port
+	done = true;
+}
+
+// --- PUBLIC METHODS ---
+
+int main(void) {
+	lr11xx_sim_t* radio;
+
+	host_port_setup("timing", 1, ESP_LOG_WARN);
+	radio = host_port_radio();
+	host_port_start(app_task, NULL, 5);
+
+	// no channel: the radio clock moves to the next timer, task timeout or radio event
+	for(host_port_run(); !done && radio->now_us < TEST_TIMEOUT_US; host_port_run()) {
+		uint64_t next = host_port_next_event_us();
+		uint64_t radio_next = lr11xx_sim_next_event_us(radio);
+
+		next = next < radio_next ? next : radio_next;
+		if(next == UINT64_MAX) {
+			break;
+		}
+		lr11xx_sim_advance(radio, next);
+	}
+	CHECK(done);
+	printf("link timing checked against the driver for %u profiles, payload 0..%u bytes\n",
+			(unsigned)profiles, LORA_MAX_PAYLOAD_LENGTH);
+	return TEST_RESULT();
+}
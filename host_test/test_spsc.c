@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "stormwater_drone_lora_spsc.h"
+#include "test_check.h"
+
+/*
+ * spsc ring: full and empty reported, items kept in order through many passes of
+ * the ring and across the wrap of the free running 16 bit indices, peek leaving
+ * the item queued, and a producer and consumer on two threads
+ */
+
+// --- PRIVATE DEFS AND METHODS ---
+
+#define THREAD_ITEMS	200000
+
+typedef struct item_s {
+	uint32_t value;
+	uint8_t pad[61];	// the size of a queued frame, so a torn copy would show
+} item_t;
+
+static item_t thread_items[8];
+static stormwater_drone_lora_spsc_t thread_ring;
+
+static void test_full_empty(void) {
+	uint32_t items[4];
+	stormwater_drone_lora_spsc_t ring;
+	uint32_t value;
+
+	stormwater_drone_lora_spsc_init(&ring, items, sizeof(uint32_t), 4);
+	CHECK(!stormwater_drone_lora_spsc_pop(&ring, &value));
+	CHECK(!stormwater_drone_lora_spsc_peek(&ring, &value));
+	for(value = 0; value < 4; value++) {
+		CHECK(stormwater_drone_lora_spsc_push(&ring, &value));
+	}
+	CHECK(stormwater_drone_lora_spsc_count(&ring) == 4);
+	CHECK(!stormwater_drone_lora_spsc_push(&ring, &value));
+
+	// peek copies the oldest and leaves it
+	value = 99;
+	CHECK(stormwater_drone_lora_spsc_peek(&ring, &value) && value == 0);
+	CHECK(stormwater_drone_lora_spsc_peek(&ring, &value) && value == 0);
+	CHECK(stormwater_drone_lora_spsc_count(&ring) == 4);
+	CHECK(stormwater_drone_lora_spsc_pop(&ring, &value) && value == 0);
+	value = 4;
+	CHECK(stormwater_drone_lora_spsc_push(&ring, &value));
+	for(uint32_t expected = 1; expected <= 4; expected++) {
+		CHECK(stormwater_drone_lora_spsc_pop(&ring, &value) && value == expected);
+	}
+	CHECK(stormwater_drone_lora_spsc_count(&ring) == 0);
+}
+
+// past the 16 bit wrap of head and tail, at every fill level
+static void test_wraparound(void) {
+	uint32_t items[8];
+	stormwater_drone_lora_spsc_t ring;
+	uint32_t pushed = 0;
+	uint32_t popped = 0;
+	uint32_t value;
+
+	stormwater_drone_lora_spsc_init(&ring, items, sizeof(uint32_t), 8);
+	for(uint32_t round = 0; round < 65536; round++) {
+		uint8_t fill = round % 9;
+
+		while(stormwater_drone_lora_spsc_count(&ring) < fill) {
+			CHECK(stormwater_drone_lora_spsc_push(&ring, &pushed));
+			pushed++;
+		}
+		if(fill == 8) {
+			CHECK(!stormwater_drone_lora_spsc_push(&ring, &pushed));
+		}
+		while(stormwater_drone_lora_spsc_count(&ring) > round % 3) {
+			CHECK(stormwater_drone_lora_spsc_pop(&ring, &value) && value == popped);
+			popped++;
+		}
+	}
+	CHECK(pushed > 2 * 65536);
+	while(stormwater_drone_lora_spsc_pop(&ring, &value)) {
+		CHECK(value == popped);
+		popped++;
+	}
+	CHECK(popped == pushed);
+}
+
+static void* producer(void* arg) {
+	item_t item = { 0 };
+
+	for(uint32_t i = 0; i < THREAD_ITEMS; i++) {
+		item.value = i;
+		item.pad[0] = item.pad[60] = (uint8_t)i;
+		while(!stormwater_drone_lora_spsc_push(&thread_ring, &item)) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void test_threads(void) {
+	pthread_t thread;
+	item_t item;
+	uint32_t expected = 0;
+	uint32_t torn = 0;
+
+	stormwater_drone_lora_spsc_init(&thread_ring, thread_items, sizeof(item_t), 8);
+	pthread_create(&thread, NULL, producer, NULL);
+	while(expected < THREAD_ITEMS) {
+		if(!stormwater_drone_lora_spsc_pop(&thread_ring, &item)) {
+			sched_yield();
+			continue;
+		}
+		if(item.value != expected || item.pad[0] != (uint8_t)expected || item.pad[60] != (uint8_t)expected) {
+			torn++;
+		}
+		expected = item.value + 1;
+	}
+	pthread_join(thread, NULL);
+	CHECK(torn == 0);
+	CHECK(stormwater_drone_lora_spsc_count(&thread_ring) == 0);
+}
+
+// --- PUBLIC METHODS ---
+
+int main(void) {
+	test_full_empty();
+	test_wraparound();
+	test_threads();
+	return TEST_RESULT();
+}
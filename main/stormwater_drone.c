@@ -6,50 +6,149 @@
 
 // stdlib components
 #include <stdio.h>
+#include <string.h>
 
 // project components
 #include "stormwater_drone.h"
 #include "stormwater_drone_lora.h"
+#include "stormwater_frame.h"
 #include "stormwater_pump.h"
 #include "stormwater_sensors.h"
 
 // esp-idf components
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // predefined memory allocation
-uint8_t temp;
-uint8_t do_2;
-uint8_t pH;
+float temp;
+float do_2;
+float pH;
 
+static const char* TAG = "StormwaterDrone";
 
+// running sums for the current average
+static stormwater_frame_sample_t sample_sum;
+static uint8_t sample_loops = 0;
+
+static void add_data(void) {
+  sample_sum.temp_c += temp;
+  sample_sum.do_ugl += do_2;
+  sample_sum.pH += pH;
+  sample_loops++;
+}
+
+// averages not yet sent collect in the batch, the oldest dropped once it holds BATCH_SAMPLES
+static void add_data_avg(stormwater_frame_batch_t* batch) {
+  const stormwater_frame_sample_t avg = {
+    .temp_c = sample_sum.temp_c / sample_loops,
+    .do_ugl = sample_sum.do_ugl / sample_loops,
+    .pH = sample_sum.pH / sample_loops,
+  };
+
+  stormwater_frame_batch_push(batch, &avg, BATCH_SAMPLES);
+  memset(&sample_sum, 0, sizeof(sample_sum));
+  sample_loops = 0;
+}
+
+// send the collected averages as one batch and start a new one. if the link does not
+// take it the batch keeps sliding and the latest BATCH_SAMPLES go with the next average
+static void send_data_batch(stormwater_frame_batch_t* batch) {
+  uint8_t encoded_count;
+  size_t length = stormwater_frame_batch_encode(batch, stormwater_drone_lora_send_buffer(),
+      LORA_MAX_FRAME_LENGTH, &encoded_count);
+  if(length == 0) {
+    return;
+  }
+  if(!stormwater_drone_lora_submit((uint8_t) length)) {
+    ESP_LOGW(TAG, "link tx queue full, batch %u not queued", batch->seq);
+    return;
+  }
+  batch->seq++;
+  batch->count = 0;
+
+  // compare with STORMWATER_FRAME_LENGTH + PACKET_PREFIX_SIZE for single telemetry frames
+  ESP_LOGI(TAG, "batch: %u readings in %u bytes, %.1f bytes on air per reading", encoded_count,
+      (unsigned) (length + PACKET_PREFIX_SIZE), (float) (length + PACKET_PREFIX_SIZE) / encoded_count);
+}
+
+static void send_link_stats(uint8_t* seq) {
+  size_t length = stormwater_drone_lora_encode_link_stats(DRONE_ADDRESS, *seq, stormwater_drone_lora_send_buffer(),
+      LORA_MAX_FRAME_LENGTH);
+
+  if(length != 0 && stormwater_drone_lora_submit((uint8_t) length)) {
+    (*seq)++;
+  }
+}
+
+// lora work task: print received frames as they arrive
+static void on_lora_rx(stormwater_drone_lora_rx_frame_t* rx, void* context) {
+  for(uint8_t i = 0; i < rx->frame_length; i++) {
+    printf("%i ", rx->frame[i]);
+  }
+  printf("(%d dBm, %d dB)\n", rx->rssi_dbm, rx->snr_db);
+  stormwater_drone_lora_release(rx);
+}
+
+static void on_lora_error(stormwater_drone_lora_event_t event, void* context) {
+  if(event == STORMWATER_DRONE_LORA_EVENT_RX_OVERRUN) {
+    ESP_LOGW(TAG, "lora rx pool overrun");
+  }
+}
 
 static void drone_main(void * pvParameters) {
+  stormwater_frame_t frame = {
+    .type = STORMWATER_FRAME_TYPE_TELEMETRY,
+    .addr = DRONE_ADDRESS,
+  };
+  stormwater_frame_batch_t batch = {
+    .addr = DRONE_ADDRESS,
+  };
+  uint8_t link_stats_seq = 0;
+  uint16_t loops = 0;
+  const stormwater_drone_lora_callbacks_t lora_callbacks = {
+    .on_rx = on_lora_rx,
+    .on_error = on_lora_error,
+  };
+
   // sensors_init();
   // stormwater_pump_init();
+  stormwater_drone_lora_set_address(DRONE_ADDRESS);
+  stormwater_drone_lora_set_callbacks(&lora_callbacks);
   stormwater_drone_lora_init();
 
-  for(uint8_t i = 0; i < PAYLOAD_LENGTH; i++) {
-    stormwater_drone_lora_send_packet[i] = i;
-  }
-  
   for(;;) {
-    // temp = (uint8_t) get_temp();
-    // do_2 = (uint8_t) read_do(3300, temp);
-    // pH = (uint8_t) read_pH();
-
-    // memcpy (&temp, stormwater_drone_lora_send_packet, 1);
-    // memcpy (&do_2, stormwater_drone_lora_send_packet + 1, 1);
-    // memcpy (&pH, stormwater_drone_lora_send_packet + 2, 1);
-  
-    for(uint8_t i = 0; i < PAYLOAD_LENGTH; i++) {
-      stormwater_drone_lora_send_packet[i]++;
+    // temp = get_temp();
+    // do_2 = read_do(3300, (uint8_t) temp);
+    // pH = read_pH();
+
+    if(BATCH_UPLINK) {
+      add_data();
+      if(sample_loops == SAMPLES_PER_AVERAGE) {
+        add_data_avg(&batch);
+        if(batch.count == BATCH_SAMPLES) {
+          send_data_batch(&batch);
+        }
+      }
+    }
+    else {
+      frame.telemetry.temp_c = temp;
+      frame.telemetry.do_ugl = do_2;
+      frame.telemetry.pH = pH;
+      size_t length = stormwater_frame_encode(&frame, stormwater_drone_lora_send_buffer(),
+          LORA_MAX_FRAME_LENGTH);
+      if(stormwater_drone_lora_submit((uint8_t) length)) {
+        frame.seq++;
+      }
     }
-    if(stormwater_drone_lora_irq_flag) {
-			stormwater_drone_lora_irq_process();
-			for(uint8_t i = 0; i < PAYLOAD_LENGTH; i++) {
-				printf("%i ", stormwater_drone_lora_receive_packet[i]);
-			}
-			printf("\n");
-		}
+
+    if(++loops == LINK_STATS_INTERVAL) {
+      loops = 0;
+      send_link_stats(&link_stats_seq);
+    }
+
+    // radio irqs are handled by the lora task, frames arrive through on_lora_rx
+    vTaskDelay(pdMS_TO_TICKS(ITERATION_DELAY));
   }
 }
 
@@ -1,5 +1,17 @@
 #ifndef STORMWATER_DRONE_H
 #define STORMWATER_DRONE_H
 
+// node address carried in every frame this drone sends
+#define DRONE_ADDRESS		1
+
+// loops averaged into one sample (see README avgData)
+#define SAMPLES_PER_AVERAGE	5
+
+// send every BATCH_SAMPLES new averages as one batch frame instead of single telemetry frames
+#define BATCH_UPLINK		true
+#define BATCH_SAMPLES		8
+
+// loops between link stats frames, so the ctrlr sees the drone's side of the link
+#define LINK_STATS_INTERVAL	30
 
 #endif
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Per-opcode SPI profile from LR11XX trace dumps.
+
+Build with USE_LR11XX_SPI_TRACE defined in esp_lora_1121.h, call
+lora_trace_dump() (stormwater_drone_lora_trace_dump() in the app) and feed
+the monitor log in:
+
+    idf.py monitor | tee monitor.log
+    tools/lr11xx_trace.py monitor.log
+
+Lines other than LRTRACE records are ignored. Opcode names are read from the
+enums in the Semtech driver vendored under
+components/esp_lora_1121/src/lr11xx_driver.
+"""
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+DRIVER_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "components",
+                          "esp_lora_1121", "src", "lr11xx_driver")
+RECORD = re.compile(r"LRTRACE (\d+) ([WRD]) ([0-9a-fA-F]{4}) (\d+) (\d+) (\d+) (\d+) (\d+)")
+DROPPED = re.compile(r"LRTRACE dropped (\d+)")
+OPCODE = re.compile(r"^\s*LR11XX_(\w+)_OC\s*=\s*0x([0-9a-fA-F]+)", re.M)
+HISTOGRAM_BINS = 16  # log2 microseconds, last bin is open ended
+
+
+def opcode_names():
+    names = {0xFFFF: "DIRECT_READ"}
+    for path in glob.glob(os.path.join(DRIVER_DIR, "*.c")):
+        with open(path, encoding="utf-8", errors="replace") as source:
+            for name, value in OPCODE.findall(source.read()):
+                names.setdefault(int(value, 16), name)
+    return names
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def log2_bin(us):
+    return min(HISTOGRAM_BINS - 1, us.bit_length())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="monitor log, stdin if omitted")
+    parser.add_argument("--histogram", action="store_true", help="print a log2 histogram of call time per opcode")
+    args = parser.parse_args()
+
+    log = open(args.log, encoding="utf-8", errors="replace") if args.log else sys.stdin
+    per_opcode = {}
+    dropped = 0
+    errors = 0
+    first = last = None
+    for line in log:
+        match = RECORD.search(line)
+        if match is None:
+            match = DROPPED.search(line)
+            if match is not None:
+                dropped += int(match.group(1))
+            continue
+        timestamp, kind, opcode, cmd_len, data_len, busy, transfer, status = match.groups()
+        timestamp = int(timestamp)
+        first = timestamp if first is None else first
+        last = timestamp
+        if int(status) != 0:
+            errors += 1
+        entry = per_opcode.setdefault((int(opcode, 16), kind), {"busy": [], "transfer": [], "bytes": 0})
+        entry["busy"].append(int(busy))
+        entry["transfer"].append(int(transfer))
+        entry["bytes"] += int(cmd_len) + int(data_len)
+
+    if not per_opcode:
+        print("no LRTRACE records found")
+        return 1
+
+    names = opcode_names()
+    rows = sorted(per_opcode.items(), key=lambda item: -(sum(item[1]["busy"]) + sum(item[1]["transfer"])))
+    total_busy = sum(sum(entry["busy"]) for entry in per_opcode.values())
+    total_transfer = sum(sum(entry["transfer"]) for entry in per_opcode.values())
+    total_calls = sum(len(entry["busy"]) for entry in per_opcode.values())
+
+    print("%-34s %s %7s %8s %9s %7s %7s %7s %9s %7s %7s %7s" % (
+        "opcode", "k", "calls", "bytes", "busy us", "p50", "p90", "max", "xfer us", "p50", "p90", "max"))
+    for (opcode, kind), entry in rows:
+        busy = sorted(entry["busy"])
+        transfer = sorted(entry["transfer"])
+        print("%-34s %s %7d %8d %9d %7d %7d %7d %9d %7d %7d %7d" % (
+            "%04X %s" % (opcode, names.get(opcode, "?")), kind, len(busy), entry["bytes"],
+            sum(busy), percentile(busy, 0.5), percentile(busy, 0.9), busy[-1],
+            sum(transfer), percentile(transfer, 0.5), percentile(transfer, 0.9), transfer[-1]))
+
+    span = (last - first) & 0xFFFFFFFF
+    print("\n%d calls, %d us busy, %d us transfer, %d errors, %d dropped" % (
+        total_calls, total_busy, total_transfer, errors, dropped))
+    if span > 0:
+        print("%.1f%% of %d us traced spent in the HAL" % (100.0 * (total_busy + total_transfer) / span, span))
+
+    if args.histogram:
+        print("\ncall time (busy + transfer), log2 us bins: <1 <2 <4 ... >=%d" % (1 << (HISTOGRAM_BINS - 2)))
+        for (opcode, kind), entry in rows:
+            bins = [0] * HISTOGRAM_BINS
+            for busy, transfer in zip(entry["busy"], entry["transfer"]):
+                bins[log2_bin(busy + transfer)] += 1
+            print("%-34s %s %s" % ("%04X %s" % (opcode, names.get(opcode, "?")), kind,
+                                   " ".join("%5d" % count for count in bins)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())